@@ -0,0 +1,319 @@
+// Benchmarks of the native engines, built on Google Benchmark (see benchmarks/meson.build)
+// Throughput is reported via the counters below, each a rate per second (of CPU time, or of wall-clock time for threads/)
+//   matvecs: products with the operator (a matmat of k columns counts as k)
+//   GB:      bytes of the operator's storage streamed per product, plus those of the vectors the step reads
+//   probes:  quadratic forms v^T f(A) v of the trace estimators, with s/probe their inverse
+// Each run records its configuration in the context of the JSON output, such that the results of two releases may be
+// compared with the compare.py tool of Google Benchmark:
+//   meson compile -C build benchmarks && compare.py benchmarks build/benchmarks.json <baseline>.json
+#include <cstdint>    // int64_t
+#include <map>        // map
+#include <random>     // mt19937_64, uniform_real_distribution
+#include <string>     // string, to_string
+#include <thread>     // hardware_concurrency
+#include <vector>     // vector
+#include <algorithm>  // max
+
+#include <benchmark/benchmark.h>
+
+#include "lanczos.h"          // lanczos_recurrence, orth_vector, orth_block_cgs2, lanczos_quadrature
+#include "eigen_operators.h"  // DenseEigenLinearOperator, SparseEigenLinearOperator, ...
+#include "trace.h"            // slq_trace
+#include "tridiagonal.h"      // jacobi_rules_block
+#include "instrumentation.h"  // instrumented
+#include "omp_support.h"      // omp_get_max_threads
+
+using F = double;
+using benchmark::Counter;
+
+// Non-zeros per row drawn above the diagonal of the sparse test matrices, i.e. each row holds about 2 * nnz_half + 1
+constexpr int nnz_half = 4;
+
+// Symmetric, diagonally dominant test matrices with a fixed seed, such that all runs benchmark the same operators
+auto dense_matrix(const int64_t n) -> DenseMatrix< F > {
+  auto rng = std::mt19937_64(uint64_t(n));
+  auto u = std::uniform_real_distribution< F >(-1.0, 1.0);
+  auto A = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, n));
+  for (int64_t j = 0; j < n; ++j){
+    for (int64_t i = 0; i <= j; ++i){ A(i, j) = A(j, i) = u(rng); }
+    A(j, j) += F(n);
+  }
+  return A;
+}
+
+auto sparse_matrix(const int64_t n) -> Eigen::SparseMatrix< F > {
+  auto rng = std::mt19937_64(uint64_t(n));
+  auto u = std::uniform_real_distribution< F >(-1.0, 1.0);
+  auto col = std::uniform_int_distribution< int64_t >(0, n - 1);
+  auto triplets = std::vector< Eigen::Triplet< F > >();
+  triplets.reserve(n * (2 * nnz_half + 1));
+  for (int64_t i = 0; i < n; ++i){
+    triplets.emplace_back(i, i, F(2 * nnz_half + 1));
+    for (int r = 0; r < nnz_half; ++r){
+      const int64_t j = col(rng);
+      if (j == i){ continue; }
+      const F v = u(rng);
+      triplets.emplace_back(i, j, v);
+      triplets.emplace_back(j, i, v);
+    }
+  }
+  auto A = Eigen::SparseMatrix< F >(n, n);
+  A.setFromTriplets(triplets.begin(), triplets.end());
+  A.makeCompressed();
+  return A;
+}
+
+// Operators benchmarked by the Lanczos and trace benchmarks
+enum op_kind { dense_op = 0, sparse_op = 1, symmetric_op = 2, csr_op = 3 };
+
+template< op_kind K >
+auto make_operator(const int64_t n, const int num_threads = 1) {
+  if constexpr (K == dense_op){ return DenseEigenLinearOperator< F >(dense_matrix(n)); }
+  else if constexpr (K == sparse_op){ return SparseEigenLinearOperator< F, false >(sparse_matrix(n)); }
+  else if constexpr (K == symmetric_op){ return SymmetricSparseEigenLinearOperator< F >(sparse_matrix(n)); }
+  else { return CSREigenLinearOperator< F >(typename CSREigenLinearOperator< F >::CSRMatrix(sparse_matrix(n)), num_threads); }
+}
+
+// Single-threaded operator of each kind and dimension, constructed on first use
+template< op_kind K >
+auto test_operator(const int64_t n) -> const auto& {
+  using Op = decltype(make_operator< K >(0));
+  static auto cache = std::map< int64_t, Op >();
+  auto it = cache.find(n);
+  if (it == cache.end()){ it = cache.emplace(n, make_operator< K >(n)).first; }
+  return it->second;
+}
+
+// Bytes of the operator's storage read by a product, plus its input and output vectors
+template< typename Sparse >
+auto sparse_bytes(const Sparse& A) -> double {
+  using Index = typename Sparse::StorageIndex;
+  return double(A.nonZeros()) * (sizeof(F) + sizeof(Index)) + double(A.outerSize() + 1) * sizeof(Index) + 2.0 * A.rows() * sizeof(F);
+}
+
+template< op_kind K, typename Op >
+auto matvec_bytes(const Op& op) -> double {
+  if constexpr (K == dense_op){ return double(op.A.size()) * sizeof(F) + 2.0 * op.A.rows() * sizeof(F); }
+  else if constexpr (K == symmetric_op){ return sparse_bytes(op.U); }
+  else { return sparse_bytes(op.A); }
+}
+
+auto random_vector(const int64_t n, const uint64_t seed = 0) -> Vector< F > {
+  auto rng = std::mt19937_64(seed);
+  auto u = std::uniform_real_distribution< F >(-1.0, 1.0);
+  auto v = static_cast< Vector< F > >(Vector< F >(n));
+  for (auto& x : v){ x = u(rng); }
+  return v;
+}
+
+// Reports `matvecs` products streaming `bytes` per iteration as rates
+void report_throughput(benchmark::State& state, const double matvecs, const double bytes){
+  state.counters["matvecs"] = Counter(matvecs, Counter::kIsIterationInvariantRate);
+  state.counters["GB"] = Counter(bytes * 1e-9, Counter::kIsIterationInvariantRate);
+}
+
+// Lanczos recurrence of degree deg, re-orthogonalizing against orth of its ncv vectors
+// Args: (n, deg, orth, ncv, reorth); each step streams the operator and the orth + 3 vectors it reads.
+template< op_kind K >
+void BM_Lanczos(benchmark::State& state){
+  const int64_t n = state.range(0);
+  const int deg = int(state.range(1)), orth = int(state.range(2)), ncv = int(state.range(3));
+  const auto reorth = orth_method(state.range(4));
+  const auto& A = test_operator< K >(n);
+  const auto v0 = random_vector(n);
+  auto q = static_cast< Vector< F > >(Vector< F >(n));
+  auto alpha = static_cast< Vector< F > >(Vector< F >::Zero(deg + 1));
+  auto beta = static_cast< Vector< F > >(Vector< F >::Zero(deg + 1));
+  auto V = static_cast< DenseMatrix< F > >(DenseMatrix< F >::Zero(n, ncv));
+  auto rw = ReorthWorkspace< F >();
+  for (auto _ : state){
+    q = v0;
+    lanczos_recurrence< F >(A, q.data(), deg, F(0), orth, alpha.data(), beta.data(), V.data(), size_t(ncv), reorth, nullptr, &rw);
+    benchmark::DoNotOptimize(alpha.data());
+    benchmark::ClobberMemory();
+  }
+  report_throughput(state, deg, deg * (matvec_bytes< K >(A) + (orth + 3.0) * n * sizeof(F)));
+}
+
+// Grid of (n, deg, orth, ncv, reorth) satisfying the precondition orth < ncv <= deg of the recurrence
+void lanczos_grid(benchmark::internal::Benchmark* b, const std::vector< int64_t >& sizes){
+  b->ArgNames({ "n", "deg", "orth", "ncv", "reorth" });
+  for (const int64_t n : sizes){
+    for (const int64_t deg : { 20, 80 }){
+      for (const int64_t orth : { 0, 5, 19 }){
+        for (const int64_t ncv : { 20, 80 }){
+          if (!(orth < ncv && ncv <= deg)){ continue; }
+          for (const int64_t reorth : { int64_t(mgs), int64_t(cgs2) }){
+            if (orth == 0 && reorth != mgs){ continue; }
+            b->Args({ n, deg, orth, ncv, reorth });
+          }
+        }
+      }
+    }
+  }
+}
+
+BENCHMARK(BM_Lanczos< dense_op >)->Name("lanczos/dense")->Apply([](auto* b){ lanczos_grid(b, { 512, 2048 }); });
+BENCHMARK(BM_Lanczos< sparse_op >)->Name("lanczos/sparse")->Apply([](auto* b){ lanczos_grid(b, { 10000, 200000 }); });
+BENCHMARK(BM_Lanczos< symmetric_op >)->Name("lanczos/symmetric")->Apply([](auto* b){ lanczos_grid(b, { 10000, 200000 }); });
+BENCHMARK(BM_Lanczos< csr_op >)->Name("lanczos/csr")->Apply([](auto* b){ lanczos_grid(b, { 10000, 200000 }); });
+
+// Re-orthogonalization of a vector against p columns of an n x p matrix of unit-norm columns
+// Args: (n, p); GB counts a single pass over the p columns, so a second pass of cgs2 halves it.
+template< orth_method M >
+void BM_Orth(benchmark::State& state){
+  const int64_t n = state.range(0);
+  const int p = int(state.range(1));
+  auto U = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, p));
+  for (int j = 0; j < p; ++j){ U.col(j) = random_vector(n, uint64_t(j + 1)).normalized(); }
+  const auto v0 = random_vector(n);
+  auto v = static_cast< Vector< F > >(Vector< F >(n));
+  auto h = static_cast< Vector< F > >(Vector< F >(p));
+  for (auto _ : state){
+    v = v0;
+    if constexpr (M == mgs){ orth_vector< F >(v, U, p - 1, p, true); }
+    else { orth_block_cgs2< F >(v, U, p - 1, p, h.data()); }
+    benchmark::DoNotOptimize(v.data());
+    benchmark::ClobberMemory();
+  }
+  state.counters["GB"] = Counter(double(n) * p * sizeof(F) * 1e-9, Counter::kIsIterationInvariantRate);
+}
+
+BENCHMARK(BM_Orth< mgs >)->Name("orth/mgs")->ArgNames({ "n", "p" })->ArgsProduct({ { 10000, 200000 }, { 5, 20, 80 } });
+BENCHMARK(BM_Orth< cgs2 >)->Name("orth/cgs2")->ArgNames({ "n", "p" })->ArgsProduct({ { 10000, 200000 }, { 5, 20, 80 } });
+
+// Quadrature rule of a random tridiagonal matrix of size deg, via its eigendecomposition (Golub-Welsch) or the FTTR
+template< weight_method M >
+void BM_Quadrature(benchmark::State& state){
+  const int deg = int(state.range(0));
+  auto rng = std::mt19937_64(uint64_t(deg));
+  auto u = std::uniform_real_distribution< F >(0.0, 1.0);
+  auto alpha = static_cast< Vector< F > >(Vector< F >(deg));
+  auto beta = static_cast< Vector< F > >(Vector< F >(deg));
+  for (int i = 0; i < deg; ++i){ alpha[i] = 1.0 + u(rng); beta[i] = i == 0 ? 0.0 : 0.1 + 0.4 * u(rng); }
+  auto solver = AdjSolver< DenseMatrix< F > >(deg);
+  auto nodes = static_cast< Vector< F > >(Vector< F >(deg));
+  auto weights = static_cast< Vector< F > >(Vector< F >(deg));
+  auto diag = static_cast< Vector< F > >(Vector< F >(deg));
+  auto subdiag = static_cast< Vector< F > >(Vector< F >(deg));
+  for (auto _ : state){
+    lanczos_quadrature< F >(alpha.data(), beta.data(), deg, solver, nodes.data(), weights.data(), M, &diag, &subdiag);
+    benchmark::DoNotOptimize(weights.data());
+    benchmark::ClobberMemory();
+  }
+  state.counters["rules"] = Counter(1, Counter::kIsIterationInvariantRate);
+}
+
+BENCHMARK(BM_Quadrature< golub_welsch >)->Name("quadrature/golub_welsch")->ArgName("deg")->RangeMultiplier(2)->Range(16, 512);
+BENCHMARK(BM_Quadrature< fttr >)->Name("quadrature/fttr")->ArgName("deg")->RangeMultiplier(2)->Range(16, 512);
+
+// Golub-Welsch rules of a block of nv random tridiagonals of size deg, solved in SIMD lanes by jacobi_rules_block
+// Args: (deg, nv); compare rules/s against quadrature/golub_welsch.
+void BM_JacobiRules(benchmark::State& state){
+  const int deg = int(state.range(0)), nv = int(state.range(1));
+  auto rng = std::mt19937_64(uint64_t(deg));
+  auto u = std::uniform_real_distribution< F >(0.0, 1.0);
+  auto alpha = static_cast< DenseMatrix< F > >(DenseMatrix< F >(deg, nv));
+  auto beta = static_cast< DenseMatrix< F > >(DenseMatrix< F >(deg, nv));
+  for (int j = 0; j < nv; ++j){
+    for (int i = 0; i < deg; ++i){ alpha(i, j) = 1.0 + u(rng); beta(i, j) = i == 0 ? 0.0 : 0.1 + 0.4 * u(rng); }
+  }
+  auto nodes = static_cast< DenseMatrix< F > >(DenseMatrix< F >(deg, nv));
+  auto weights = static_cast< DenseMatrix< F > >(DenseMatrix< F >(deg, nv));
+  auto work = std::vector< F >(jacobi_work_size(deg));
+  for (auto _ : state){
+    jacobi_rules_block< F >(alpha.data(), beta.data(), deg, deg, nv, nodes.data(), weights.data(), deg, work.data());
+    benchmark::DoNotOptimize(weights.data());
+    benchmark::ClobberMemory();
+  }
+  state.counters["rules"] = Counter(nv, Counter::kIsIterationInvariantRate);
+}
+
+BENCHMARK(BM_JacobiRules)->Name("quadrature/jacobi_rules")->ArgNames({ "deg", "nv" })->ArgsProduct({ { 16, 32, 64, 128, 256, 512 }, { 1, 64 } });
+
+// Girard-Hutchinson estimates of tr(log(A)) of nv probes via stochastic Lanczos quadrature, on a single thread
+// Args: (n, deg, block_size); the per-probe cost is reported as s/probe.
+template< op_kind K >
+void BM_SLQ(benchmark::State& state){
+  constexpr int nv = 32;
+  const int64_t n = state.range(0);
+  const int deg = int(state.range(1)), block_size = int(state.range(2));
+  const auto& A = test_operator< K >(n);
+  const auto sf = param_spectral_func< F >("log");
+  auto estimates = std::vector< F >(nv);
+  for (auto _ : state){
+    slq_trace< F >(A, sf, nv, rademacher, 0, deg, F(0), 0, 2, 1, estimates.data(), block_size, golub_welsch, mgs, (LanczosArena< F, F >*) nullptr);
+    benchmark::DoNotOptimize(estimates.data());
+    benchmark::ClobberMemory();
+  }
+  report_throughput(state, double(nv) * deg, double(nv) * deg * (matvec_bytes< K >(A) + 3.0 * n * sizeof(F)));
+  state.counters["probes"] = Counter(nv, Counter::kIsIterationInvariantRate);
+  state.counters["s/probe"] = Counter(nv, Counter::kIsIterationInvariantRate | Counter::kInvert);
+}
+
+BENCHMARK(BM_SLQ< dense_op >)->Name("slq/dense")->ArgNames({ "n", "deg", "block_size" })->ArgsProduct({ { 512, 2048 }, { 20, 80 }, { 1, 8 } });
+BENCHMARK(BM_SLQ< sparse_op >)->Name("slq/sparse")->ArgNames({ "n", "deg", "block_size" })->ArgsProduct({ { 10000, 200000 }, { 20, 80 }, { 1, 8 } });
+BENCHMARK(BM_SLQ< symmetric_op >)->Name("slq/symmetric")->ArgNames({ "n", "deg", "block_size" })->ArgsProduct({ { 10000, 200000 }, { 20, 80 }, { 1, 8 } });
+
+// Thread scaling of the probe-parallel trace estimator, over 1, 2, 4, ... threads up to the hardware concurrency
+// Args: (threads, n); compare the wall-clock probes/s against threads = 1 for the speedup.
+template< op_kind K >
+void BM_SLQThreads(benchmark::State& state){
+  const int nt = int(state.range(0));
+  const int64_t n = state.range(1);
+  const int nv = 16 * std::max(nt, 4), deg = 20;
+  const auto& A = test_operator< K >(n);
+  const auto sf = param_spectral_func< F >("log");
+  auto estimates = std::vector< F >(nv);
+  for (auto _ : state){
+    slq_trace< F >(A, sf, nv, rademacher, 0, deg, F(0), 0, 2, nt, estimates.data(), 1, golub_welsch, mgs, (LanczosArena< F, F >*) nullptr);
+    benchmark::DoNotOptimize(estimates.data());
+    benchmark::ClobberMemory();
+  }
+  report_throughput(state, double(nv) * deg, double(nv) * deg * (matvec_bytes< K >(A) + 3.0 * n * sizeof(F)));
+  state.counters["probes"] = Counter(nv, Counter::kIsIterationInvariantRate);
+  state.counters["threads"] = nt;
+}
+
+// Thread scaling of the row-parallel products of the CSR operator
+// Args: (threads, n)
+void BM_CSRThreads(benchmark::State& state){
+  const int nt = int(state.range(0));
+  const int64_t n = state.range(1);
+  const auto A = make_operator< csr_op >(n, nt);
+  const auto x = random_vector(n);
+  auto y = static_cast< Vector< F > >(Vector< F >(n));
+  for (auto _ : state){
+    A.matvec(x.data(), y.data());
+    benchmark::DoNotOptimize(y.data());
+    benchmark::ClobberMemory();
+  }
+  report_throughput(state, 1, matvec_bytes< csr_op >(A));
+  state.counters["threads"] = nt;
+}
+
+void thread_grid(benchmark::internal::Benchmark* b, const int64_t n){
+  const int max_threads = std::max< int >(1, std::thread::hardware_concurrency());
+  b->ArgNames({ "threads", "n" })->UseRealTime();
+  for (int nt = 1; nt < max_threads; nt *= 2){ b->Args({ nt, n }); }
+  b->Args({ max_threads, n });
+}
+
+BENCHMARK(BM_SLQThreads< dense_op >)->Name("threads/slq/dense")->Apply([](auto* b){ thread_grid(b, 2048); });
+BENCHMARK(BM_SLQThreads< sparse_op >)->Name("threads/slq/sparse")->Apply([](auto* b){ thread_grid(b, 200000); });
+BENCHMARK(BM_CSRThreads)->Name("threads/csr_matvec")->Apply([](auto* b){ thread_grid(b, 1000000); });
+
+int main(int argc, char** argv){
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)){ return 1; }
+  #ifdef OMP_MULTITHREADED
+  benchmark::AddCustomContext("openmp_max_threads", std::to_string(omp_get_max_threads()));
+  #else
+  benchmark::AddCustomContext("openmp_max_threads", "disabled");
+  #endif
+  benchmark::AddCustomContext("eigen", std::to_string(EIGEN_WORLD_VERSION) + "." + std::to_string(EIGEN_MAJOR_VERSION) + "." + std::to_string(EIGEN_MINOR_VERSION));
+  benchmark::AddCustomContext("instrumented", instrumented ? "true" : "false");
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
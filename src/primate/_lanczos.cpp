@@ -10,25 +10,11 @@
 #include "lanczos.h"
 #include "eigen_operators.h"
 #include "pylinop.h"
-// #include "spectral_functions.h"
-
-// template< std::floating_point F, typename WrapperType > 
-// auto matmat(const MatrixFunction< F, WrapperType >& M, const py_array< F >& X) -> py_array< F >{
-//   if (size_t(X.ndim() == 1)){
-//     if (size_t(M.shape().second) != size_t(X.size())){ throw std::invalid_argument("Input dimension mismatch; vector inputs must match shape of the operator."); }
-//     auto Y = static_cast< DenseMatrix< F > >(DenseMatrix< F >::Zero(M.shape().second, 1));
-//     M.matmat(X.data(), Y.data(), 1);
-//     return py::cast(Y);
-//   } else if (X.ndim() == 2){
-//     if (size_t(M.shape().second) != size_t(X.shape(0))){ throw std::invalid_argument("Input dimension mismatch; vector inputs must match shape of the operator."); }
-//     const auto k = X.shape(1);
-//     auto Y = static_cast< DenseMatrix< F > >(DenseMatrix< F >::Zero(M.shape().second, k));
-//     M.matmat(X.data(), Y.data(), k);
-//     return py::cast(Y);
-//   } else {
-//     throw std::invalid_argument("Input dimension mismatch; input must be 1 or 2-dimensional.");
-//   }
-// }
+#include "spectral_functions.h"
+#include "trace.h"
+#include "diagonal.h"
+#include "composite_operators.h"
+#include "chebyshev.h"
 
 #ifdef USE_NANOBIND
 
@@ -83,32 +69,841 @@ template< typename F >
 using py_array = py::array_t< F, py::array::f_style | py::array::forcecast >;
 
 // Template function for generating module definitions for a given Operator / precision 
-template< std::floating_point F, class Matrix, LinearOperator Wrapper >
-void _lanczos_wrapper(py::module& m){
-  m.def("lanczos", []( // keep wrap pass by value!
+// Overloads cannot distinguish sparse storage orders (the sparse type caster converts either), so alternative 
+// storage formats are registered under their own suffix, e.g. 'lanczos_csr'
+// Single precision operators are also registered with double precision (alpha, beta), which selects the mixed 
+// precision recurrence; overload resolution picks it by the dtype of the supplied tridiagonal arrays.
+template< std::floating_point F, class Matrix, LinearOperator Wrapper, std::floating_point S = F >
+void _lanczos_wrapper(py::module& m, const std::string& suffix = ""){
+  m.def(("lanczos" + suffix).c_str(), []( // keep wrap pass by value!
     const Matrix& A, 
     py_array< F > v, const int lanczos_degree, const F lanczos_rtol, const int orth,
-    py_array< F >& alpha, py_array< F >& beta, py_array< F >& Q 
+    py_array< S >& alpha, py_array< S >& beta, py_array< F >& Q, const std::string& reorth
   ){ 
     const auto op = Wrapper(A);
     const size_t ncv = static_cast< size_t >(Q.shape(1));
     lanczos_recurrence(
       op, v.mutable_data(), lanczos_degree, lanczos_rtol, orth, 
-      alpha.mutable_data(), beta.mutable_data(), Q.mutable_data(), ncv
+      alpha.mutable_data(), beta.mutable_data(), Q.mutable_data(), ncv, parse_orth_method(reorth)
     );
-  });
+  }, py::arg("A"), py::arg("v"), py::arg("deg"), py::arg("rtol"), py::arg("orth"), 
+     py::arg("alpha"), py::arg("beta"), py::arg("Q"), py::arg("reorth") = "mgs");
+  m.def(("lanczos_batch" + suffix).c_str(), []( 
+    const Matrix& A, 
+    py_array< F > V, const int lanczos_degree, const F lanczos_rtol, const int orth,
+    py_array< S >& alpha, py_array< S >& beta, py_array< F >& Q, const std::string& reorth
+  ){ 
+    const auto op = Wrapper(A);
+    const int k = static_cast< int >(V.shape(1));
+    const size_t ncv = static_cast< size_t >(Q.shape(1) / k);
+    lanczos_recurrence_batch(
+      op, V.mutable_data(), k, lanczos_degree, lanczos_rtol, orth, 
+      alpha.mutable_data(), beta.mutable_data(), Q.mutable_data(), ncv, parse_orth_method(reorth)
+    );
+  }, py::arg("A"), py::arg("V"), py::arg("deg"), py::arg("rtol"), py::arg("orth"), 
+     py::arg("alpha"), py::arg("beta"), py::arg("Q"), py::arg("reorth") = "mgs");
+  if constexpr (std::is_same_v< F, float > && std::is_same_v< S, F >){
+    _lanczos_wrapper< F, Matrix, Wrapper, double >(m, suffix);
+  }
 } 
 
+// Template function for generating persistent, zero-copy operator handles for a given precision
+// Each handle views the memory of the arrays it was constructed from (and keeps them alive), such that passing it to 
+// the functions above in place of a NumPy / SciPy matrix avoids converting it to a fresh Eigen matrix on every call. 
+// Arguments are never converted, as conversion would create temporaries which the handle would then dangle on.
+template< std::floating_point F >
+void _operator_wrapper(py::module& m){
+  using Dense = DenseEigenMapOperator< F >;
+  using Sparse = SparseEigenMapOperator< F >;
+  const auto dtype = [](){ return py::dtype(py::format_descriptor< F >::format()); };
+  py::class_< Dense >(m, (std::string("DenseOperator_") + TypeString< F >::value).c_str())
+    .def(py::init([](const py::array_t< F, py::array::f_style >& A){
+      if (A.ndim() != 2){ throw std::invalid_argument("Dense operators must be 2-dimensional."); }
+      return new Dense(A.data(), A.shape(0), A.shape(1), A.shape(0));
+    }), py::arg("A").noconvert(), py::keep_alive< 1, 2 >())
+    .def_property_readonly("shape", &Dense::shape)
+    .def_property_readonly("dtype", [dtype](const Dense& op){ return dtype(); });
+  py::class_< Sparse >(m, (std::string("SparseOperator_") + TypeString< F >::value).c_str())
+    .def(py::init([](const std::pair< size_t, size_t > shape, const py::array_t< int, py::array::c_style >& indptr, 
+      const py::array_t< int, py::array::c_style >& indices, const py::array_t< F, py::array::c_style >& data){
+      if (size_t(indptr.size()) != shape.second + 1 || indices.size() != data.size()){ 
+        throw std::invalid_argument("Sparse operators require CSC arrays with len(indptr) == shape[1] + 1 and len(indices) == len(data)."); 
+      }
+      return new Sparse(shape.first, shape.second, size_t(data.size()), indptr.data(), indices.data(), data.data());
+    }), py::arg("shape"), py::arg("indptr").noconvert(), py::arg("indices").noconvert(), py::arg("data").noconvert(), 
+      py::keep_alive< 1, 3 >(), py::keep_alive< 1, 4 >(), py::keep_alive< 1, 5 >())
+    .def_property_readonly("shape", &Sparse::shape)
+    .def_property_readonly("dtype", [dtype](const Sparse& op){ return dtype(); });
+
+  // The CSR and symmetric handles convert (and copy) their matrix once on construction, and share it with every copy of
+  // the operator made by the native routines. As they hold no views, their arguments may be converted.
+  using CSR = CSREigenLinearOperator< F >;
+  using Sym = SymmetricSparseEigenLinearOperator< F >;
+  py::class_< CSR >(m, (std::string("CSROperator_") + TypeString< F >::value).c_str())
+    .def(py::init([](Eigen::SparseMatrix< F, Eigen::RowMajor > A){ return new CSR(std::move(A)); }), py::arg("A"))
+    .def_property_readonly("shape", &CSR::shape)
+    .def_property_readonly("dtype", [dtype](const CSR& op){ return dtype(); });
+  py::class_< Sym >(m, (std::string("SymmetricOperator_") + TypeString< F >::value).c_str())
+    .def(py::init< const Eigen::SparseMatrix< F >& >(), py::arg("A"))
+    .def_property_readonly("shape", &Sym::shape)
+    .def_property_readonly("dtype", [dtype](const Sym& op){ return dtype(); });
+
+  // Unlike the handles, the affine operator A + tB owns (CSC) copies of its matrices; its parameter t defaults to 0
+  using Affine = SparseEigenAffineOperator< F >;
+  py::class_< Affine >(m, (std::string("AffineOperator_") + TypeString< F >::value).c_str())
+    .def(py::init< const Eigen::SparseMatrix< F >&, const Eigen::SparseMatrix< F >& >(), py::arg("A"), py::arg("B"))
+    .def_property("parameter", [](const Affine& op){ return op._param; }, [](const Affine& op, const F t){ op.set_parameter(t); })
+    .def("matvec", [](const Affine& op, const py_array< F >& x) -> py_array< F > {
+      if (size_t(x.size()) != op.shape().second){ throw std::invalid_argument("Input dimension mismatch."); }
+      auto y = py_array< F >(static_cast< py::ssize_t >(op.shape().first));
+      op.matvec(x.data(), y.mutable_data());
+      return y;
+    })
+    .def_property_readonly("shape", &Affine::shape)
+    .def_property_readonly("dtype", [dtype](const Affine& op){ return dtype(); });
+
+  // The Toeplitz operator owns the spectrum of its circulant embedding, so its arguments may be converted
+  using Toeplitz = ToeplitzLinearOperator< F >;
+  py::class_< Toeplitz >(m, (std::string("ToeplitzOperator_") + TypeString< F >::value).c_str())
+    .def(py::init([](const py_array< F >& c, const std::optional< py_array< F > >& r){
+      if (c.size() == 0 || (r.has_value() && r->size() != c.size())){ 
+        throw std::invalid_argument("Toeplitz operators require a non-empty first column c and a first row r of the same length."); 
+      }
+      return new Toeplitz(c.data(), r.has_value() ? r->data() : c.data(), size_t(c.size()));
+    }), py::arg("c"), py::arg("r") = py::none())
+    .def("matvec", [](const Toeplitz& op, const py_array< F >& x) -> py_array< F > {
+      if (size_t(x.size()) != op.shape().second){ throw std::invalid_argument("Input dimension mismatch."); }
+      auto y = py_array< F >(static_cast< py::ssize_t >(op.shape().first));
+      op.matvec(x.data(), y.mutable_data());
+      return y;
+    })
+    .def("matmat", [](const Toeplitz& op, const py_array< F >& X) -> py_array< F > {
+      const size_t n = op.shape().first;
+      if (X.ndim() != 2 || size_t(X.shape(0)) != n){ throw std::invalid_argument("Input dimension mismatch."); }
+      const size_t k = size_t(X.shape(1));
+      auto Y = py_array< F >({ static_cast< py::ssize_t >(n), static_cast< py::ssize_t >(k) });
+      {
+        py::gil_scoped_release release;
+        op.matmat(X.data(), Y.mutable_data(), k);
+      }
+      return Y;
+    })
+    .def_property_readonly("embedding", &Toeplitz::embedding)
+    .def_property_readonly("shape", &Toeplitz::shape)
+    .def_property_readonly("dtype", [dtype](const Toeplitz& op){ return dtype(); });
+
+  // Lazy compositions of the native operators, whose (type-erased) nodes keep their operands alive
+  // Leaves are the handles above, whose matrices are viewed (or, for CSR and symmetric handles, shared) rather than copied
+  using Composite = AnyLinearOperator< F >;
+  // Every leaf accumulates y += alpha * Ax in place, such that sums and shifts of them need no temporaries
+  static_assert(LinearAdditiveOperator< Dense > && LinearAdditiveOperator< Sparse > && LinearAdditiveOperator< Toeplitz >);
+  static_assert(LinearAdditiveOperator< CSREigenLinearOperator< F > > && AdjointAdditiveOperator< CSREigenLinearOperator< F > >);
+  static_assert(AdjointAdditiveOperator< Dense > && AdjointAdditiveOperator< Sparse >);
+  static_assert(LinearAdditiveOperator< Sym > && AdjointAdditiveOperator< Sym >);
+  py::class_< Composite >(m, (std::string("CompositeOperator_") + TypeString< F >::value).c_str())
+    .def(py::init([](const Dense& A){ return new Composite(A); }), py::arg("A"), py::keep_alive< 1, 2 >())
+    .def(py::init([](const Sparse& A){ return new Composite(A); }), py::arg("A"), py::keep_alive< 1, 2 >())
+    .def(py::init([](const Toeplitz& A){ return new Composite(A); }), py::arg("A"), py::keep_alive< 1, 2 >())
+    .def(py::init([](const CSR& A){ return new Composite(A); }), py::arg("A"))
+    .def(py::init([](const Sym& A){ return new Composite(A); }), py::arg("A"))
+    .def(py::init([](const Eigen::SparseMatrix< F, Eigen::RowMajor >& A){ 
+      return new Composite(CSREigenLinearOperator< F >(A)); 
+    }), py::arg("A"))
+    .def("scaled", [](const Composite& op, const F alpha){ return Composite(ScaledOp(op, alpha)); }, py::arg("alpha"), py::keep_alive< 0, 1 >())
+    .def("shifted", [](const Composite& op, const F sigma){ return Composite(ShiftOp(op, sigma)); }, py::arg("sigma"), py::keep_alive< 0, 1 >())
+    .def("add", [](const Composite& op, const Composite& other){ return Composite(SumOp(op, other)); }, py::arg("other"), 
+      py::keep_alive< 0, 1 >(), py::keep_alive< 0, 2 >())
+    .def("compose", [](const Composite& op, const Composite& other){ return Composite(ProductOp(op, other)); }, py::arg("other"), 
+      py::keep_alive< 0, 1 >(), py::keep_alive< 0, 2 >())
+    .def("gram", [](const Composite& op){ 
+      if (!op.adjoint()){ throw std::invalid_argument("Gram operators require an operator with adjoint products."); }
+      return Composite(GramOp(op)); 
+    }, py::keep_alive< 0, 1 >())
+    .def("matvec", [](const Composite& op, const py_array< F >& x) -> py_array< F > {
+      if (size_t(x.size()) != op.shape().second){ throw std::invalid_argument("Input dimension mismatch."); }
+      auto y = py_array< F >(static_cast< py::ssize_t >(op.shape().first));
+      {
+        py::gil_scoped_release release;
+        op.matvec(x.data(), y.mutable_data());
+      }
+      return y;
+    })
+    .def("matmat", [](const Composite& op, const py_array< F >& X) -> py_array< F > {
+      const auto [m, n] = op.shape();
+      if (X.ndim() != 2 || size_t(X.shape(0)) != n){ throw std::invalid_argument("Input dimension mismatch."); }
+      const size_t k = size_t(X.shape(1));
+      auto Y = py_array< F >({ static_cast< py::ssize_t >(m), static_cast< py::ssize_t >(k) });
+      {
+        py::gil_scoped_release release;
+        op.matmat(X.data(), Y.mutable_data(), k);
+      }
+      return Y;
+    })
+    .def_property_readonly("adjoint", &Composite::adjoint)
+    .def_property_readonly("shape", &Composite::shape)
+    .def_property_readonly("dtype", [dtype](const Composite& op){ return dtype(); });
+}
+
+// Python callbacks need the GIL, so only natively-implemented operators may be shared across threads
+template< LinearOperator Wrapper >
+constexpr bool is_native_operator = !std::is_same_v< Wrapper, PyLinearOperator< typename Wrapper::value_type > >;
+
+// Evaluates the native Hutch++ estimator on an operator (or matrix function), returning its (sketch, residual) samples
+// Python callbacks need the GIL, so only native operators release it and use more than one thread
+template< std::floating_point F, LinearOperator Op, bool native >
+auto _hutchpp(const Op& op, const int nb, const int nv, const std::string& pdf, const int64_t seed, const int num_threads) -> py::tuple {
+  const auto dist = parse_distribution(pdf);
+  auto sketch_ests = py_array< F >(static_cast< py::ssize_t >(nb));
+  auto defl_ests = py_array< F >(static_cast< py::ssize_t >(nv));
+  if constexpr (native){
+    py::gil_scoped_release release;
+    hutchpp< F >(op, nb, nv, dist, seed, num_threads, sketch_ests.mutable_data(), defl_ests.mutable_data());
+  } else {
+    hutchpp< F >(op, nb, nv, dist, seed, 1, sketch_ests.mutable_data(), defl_ests.mutable_data());
+  }
+  return py::make_tuple(sketch_ests, defl_ests);
+}
+
+// Evaluates the native XTrace estimator on an operator (or matrix function), returning its m leave-one-out estimates
+template< std::floating_point F, LinearOperator Op, bool native >
+auto _xtrace(const Op& op, const int m, const std::string& pdf, const int64_t seed, const int num_threads) -> py_array< F > {
+  const auto dist = parse_distribution(pdf);
+  auto estimates = py_array< F >(static_cast< py::ssize_t >(m));
+  if constexpr (native){
+    py::gil_scoped_release release;
+    xtrace< F >(op, m, dist, seed, num_threads, estimates.mutable_data());
+  } else {
+    xtrace< F >(op, m, dist, seed, 1, estimates.mutable_data());
+  }
+  return estimates;
+}
+
+// Streams nv native Girard-Hutchinson diagonal samples into the (count, mean, m2, denom) state held by the caller
+template< std::floating_point F, LinearOperator Op, bool native >
+auto _diag(const Op& op, const int nv, const std::string& pdf, const int64_t seed, const int num_threads, 
+  py_array< F >& mean, py_array< F >& m2, py_array< F >& denom, int64_t count
+) -> int64_t {
+  const size_t n = op.shape().first;
+  if (size_t(mean.size()) != n || size_t(m2.size()) != n || size_t(denom.size()) != n){ 
+    throw std::invalid_argument("The accumulated state must match the dimension of the operator."); 
+  }
+  const auto dist = parse_distribution(pdf);
+  auto acc = DiagonalAccumulator< F >{ count, mean.mutable_data(), m2.mutable_data(), denom.mutable_data(), n };
+  if constexpr (native){
+    py::gil_scoped_release release;
+    diag_estimate< F >(op, nv, dist, seed, num_threads, acc);
+  } else {
+    diag_estimate< F >(op, nv, dist, seed, 1, acc);
+  }
+  return count;
+}
+
+// Evaluates the native XDiag estimator on an operator (or matrix function), returning its estimate of the diagonal
+template< std::floating_point F, LinearOperator Op, bool native >
+auto _xdiag(const Op& op, const int m, const std::string& pdf, const int64_t seed, const int num_threads) -> py_array< F > {
+  const auto dist = parse_distribution(pdf);
+  auto d = py_array< F >(static_cast< py::ssize_t >(op.shape().first));
+  if constexpr (native){
+    py::gil_scoped_release release;
+    xdiag< F >(op, m, dist, seed, num_threads, d.mutable_data());
+  } else {
+    xdiag< F >(op, m, dist, seed, 1, d.mutable_data());
+  }
+  return d;
+}
+
+// Template function for generating the per-thread workspace pools re-used across calls to trace_quad
+// The mixed precision pools, whose tridiagonals are stored in double precision, carry a '_float64' suffix
+template< std::floating_point F, std::floating_point S = F >
+void _arena_wrapper(py::module& m){
+  using Arena = LanczosArena< F, S >;
+  auto name = std::string("LanczosArena_") + TypeString< F >::value;
+  if constexpr (!std::is_same_v< F, S >){ name += std::string("_") + TypeString< S >::value; }
+  py::class_< Arena >(m, name.c_str())
+    .def(py::init<>())
+    .def("__len__", [](const Arena& arena){ return arena.workspaces.size(); })
+    .def("clear", [](Arena& arena){ arena.workspaces.clear(); });
+}
+
+// Template function for generating the in-place generator of counter-based probes (see generate_probes)
+// The columns of `out` are filled with the probes offset, offset + 1, ... of the stream, independently of num_threads
+template< std::floating_point F >
+void _random_wrapper(py::module& m){
+  m.def("isotropic", [](py_array< F >& out, const std::string& pdf, const uint64_t seed, const uint32_t stream, const uint64_t offset, const int num_threads){
+    if (out.ndim() < 1 || out.ndim() > 2){ throw std::invalid_argument("Output must be a vector or a (column-major) matrix."); }
+    const auto dist = parse_distribution(pdf);
+    const size_t n = out.shape(0);
+    const int k = out.ndim() == 2 ? static_cast< int >(out.shape(1)) : 1;
+    F* X = out.mutable_data();
+    py::gil_scoped_release release;
+    generate_probes< F >(dist, n, k, seed, stream, offset, X, num_threads);
+  }, py::arg("out").noconvert(), py::arg("pdf"), py::arg("seed"), py::arg("stream") = 0, py::arg("offset") = 0, py::arg("num_threads") = 0);
+}
+
+// Template function for generating the batched Golub-Welsch solver of Jacobi matrices (see jacobi_rules)
+// Column j of the (k x nv) arrays alpha and beta holds the diagonal and subdiagonal (from beta[1, j]) of matrix j, and 
+// column j of the returned nodes and weights its quadrature rule.
+template< std::floating_point F >
+void _jacobi_wrapper(py::module& m){
+  m.def("jacobi_rules", [](const py_array< F >& alpha, const py_array< F >& beta, const int num_threads){
+    if (alpha.ndim() != 2 || beta.ndim() != 2 || alpha.shape(0) != beta.shape(0) || alpha.shape(1) != beta.shape(1)){ 
+      throw std::invalid_argument("alpha and beta must be (k x nv) matrices of the same shape.");
+    }
+    const int k = static_cast< int >(alpha.shape(0));
+    const int nv = static_cast< int >(alpha.shape(1));
+    auto nodes = py_array< F >({ alpha.shape(0), alpha.shape(1) });
+    auto weights = py_array< F >({ alpha.shape(0), alpha.shape(1) });
+    const F* a = alpha.data();
+    const F* b = beta.data();
+    F* x = nodes.mutable_data();
+    F* w = weights.mutable_data();
+    {
+      py::gil_scoped_release release;
+      jacobi_rules< F >(a, b, size_t(k), k, nv, x, w, num_threads);
+    }
+    return py::make_tuple(nodes, weights);
+  }, py::arg("alpha"), py::arg("beta"), py::arg("num_threads") = 0);
+}
+
+// Generates the estimator and stopping criteria of the convergence-checked quadrature engine (see slq_trace_converge)
+// Both are double precision for all operator types; the estimator records the state carried across calls
+void _estimator_wrapper(py::module& m){
+  py::class_< MeanEstimator >(m, "MeanEstimator")
+    .def(py::init<>())
+    .def_readonly("n", &MeanEstimator::n)
+    .def_readonly("mean", &MeanEstimator::mean)
+    .def_readonly("delta", &MeanEstimator::delta)
+    .def_property_readonly("variance", &MeanEstimator::variance)
+    .def("__len__", [](const MeanEstimator& est){ return est.n; });
+  py::class_< StoppingCriterion >(m, "StoppingCriterion")
+    .def(py::init([](const std::string& kind, const int64_t count, const double atol, const double rtol, const double z, const std::vector< double >& t_scores){
+      auto cc = StoppingCriterion{ parse_criterion(kind), count, atol, rtol, z };
+      if (cc.kind == confidence_criterion && t_scores.size() < cc.t_scores.size()){
+        throw std::invalid_argument("The confidence criterion requires the first 30 t-scores.");
+      }
+      std::copy_n(t_scores.begin(), std::min(t_scores.size(), cc.t_scores.size()), cc.t_scores.begin());
+      return cc;
+    }), py::arg("kind"), py::arg("count") = 0, py::arg("atol") = 0.0, py::arg("rtol") = 0.0, py::arg("z") = 0.0, 
+      py::arg("t_scores") = std::vector< double >())
+    .def("__call__", &StoppingCriterion::operator());
+}
+
+// Exposes the phase counters of the native engines (see instrumentation.h), summed over all threads
+// phase_stats() maps each phase to its (count, seconds), and "threads" to the number of threads that recorded any.
+void _instrumentation_wrapper(py::module& m){
+  m.attr("instrumented") = instrumented;
+  m.def("phase_stats", [](){
+    const auto totals = phase_totals();
+    auto stats = py::dict();
+    for (int p = 0; p < n_phases; ++p){
+      stats[phase_names[p]] = py::make_tuple(totals.count[p], 1e-9 * double(totals.ns[p]));
+    }
+    stats["threads"] = totals.threads;
+    return stats;
+  });
+}
+
+// Template function for generating the native stochastic Lanczos quadrature routines for a given Operator / precision 
+// As with _lanczos_wrapper, double precision estimates select the mixed precision variant for single precision operators
+// The optional arena holds the per-thread workspaces, such that repeated calls of the same sizes needn't allocate them
+template< std::floating_point F, class Matrix, LinearOperator Wrapper, std::floating_point S = F >
+void _trace_wrapper(py::module& m, const std::string& suffix = ""){
+  m.def(("trace_quad" + suffix).c_str(), []( 
+    const Matrix& A, const std::string& fun, const SpectralParams< S >& fun_params, 
+    const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv, 
+    const std::string& pdf, const int64_t seed, const int num_threads, const int block_size, const std::string& quad,
+    const std::string& reorth_name, py_array< S >& estimates, LanczosArena< F, S >* arena, const uint64_t offset
+  ){
+    const auto op = Wrapper(A);
+    const auto sf = param_spectral_func< S >(fun, fun_params);
+    const auto dist = parse_distribution(pdf);
+    const auto method = parse_weight_method(quad);
+    const auto reorth = parse_orth_method(reorth_name);
+    const int nv = static_cast< int >(estimates.size());
+    if constexpr (is_native_operator< Wrapper >){
+      py::gil_scoped_release release;
+      slq_trace< F, Wrapper, S >(op, sf, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, estimates.mutable_data(), block_size, method, reorth, arena, nullptr, offset);
+    } else {
+      slq_trace< F, Wrapper, S >(op, sf, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, 1, estimates.mutable_data(), block_size, method, reorth, arena, nullptr, offset);
+    }
+  }, py::arg("A"), py::arg("fun"), py::arg("fun_params"), py::arg("deg"), py::arg("rtol"), py::arg("orth"), py::arg("ncv"), 
+    py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), py::arg("block_size"), py::arg("quad"), py::arg("reorth"), 
+    py::arg("estimates"), py::arg("arena") = py::none(), py::arg("offset") = 0);
+  m.def(("trace_deflated" + suffix).c_str(), []( 
+    const Matrix& A, const std::string& fun, const SpectralParams< S >& fun_params, const py_array< F >& Q,
+    const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv, 
+    const std::string& pdf, const int64_t seed, const int num_threads, const int block_size, const std::string& quad,
+    const std::string& reorth_name, py_array< S >& defl_ests, py_array< S >& estimates, LanczosArena< F, S >* arena, const uint64_t offset
+  ){
+    const auto op = Wrapper(A);
+    const auto sf = param_spectral_func< S >(fun, fun_params);
+    const auto dist = parse_distribution(pdf);
+    const auto method = parse_weight_method(quad);
+    const auto reorth = parse_orth_method(reorth_name);
+    if (Q.ndim() != 2 || size_t(Q.shape(0)) != op.shape().first){ throw std::invalid_argument("The deflation basis must be an (n x k) array."); }
+    const int k = static_cast< int >(Q.shape(1));
+    if (defl_ests.size() != k){ throw std::invalid_argument("The deflated estimates must be of length k."); }
+    const int nv = static_cast< int >(estimates.size());
+    if constexpr (is_native_operator< Wrapper >){
+      py::gil_scoped_release release;
+      slq_trace_deflated< F, Wrapper, S >(op, sf, Q.data(), k, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, defl_ests.mutable_data(), estimates.mutable_data(), block_size, method, reorth, arena, offset);
+    } else {
+      slq_trace_deflated< F, Wrapper, S >(op, sf, Q.data(), k, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, 1, defl_ests.mutable_data(), estimates.mutable_data(), block_size, method, reorth, arena, offset);
+    }
+  }, py::arg("A"), py::arg("fun"), py::arg("fun_params"), py::arg("Q"), py::arg("deg"), py::arg("rtol"), py::arg("orth"), py::arg("ncv"), 
+    py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), py::arg("block_size"), py::arg("quad"), py::arg("reorth"), 
+    py::arg("defl_ests"), py::arg("estimates"), py::arg("arena") = py::none(), py::arg("offset") = 0);
+  m.def(("trace_adaptive" + suffix).c_str(), []( 
+    const Matrix& A, const std::string& fun, const SpectralParams< S >& fun_params, 
+    const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv, 
+    const std::string& pdf, const int64_t seed, const int num_threads, 
+    const int deg_start, const int deg_step, const S atol, const S rtol, const std::string& quad,
+    const std::string& reorth_name, py_array< S >& estimates, py_array< int >& degrees, LanczosArena< F, S >* arena, 
+    const uint64_t offset
+  ){
+    const auto op = Wrapper(A);
+    const auto sf = param_spectral_func< S >(fun, fun_params);
+    const auto dist = parse_distribution(pdf);
+    const auto method = parse_weight_method(quad);
+    const auto reorth = parse_orth_method(reorth_name);
+    if (degrees.size() != estimates.size()){ throw std::invalid_argument("Degrees must be of the same length as the estimates."); }
+    const int nv = static_cast< int >(estimates.size());
+    if constexpr (is_native_operator< Wrapper >){
+      py::gil_scoped_release release;
+      slq_trace_adaptive< F, Wrapper, S >(op, sf, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, deg_start, deg_step, atol, rtol, num_threads, estimates.mutable_data(), degrees.mutable_data(), method, reorth, arena, offset);
+    } else {
+      slq_trace_adaptive< F, Wrapper, S >(op, sf, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, deg_start, deg_step, atol, rtol, 1, estimates.mutable_data(), degrees.mutable_data(), method, reorth, arena, offset);
+    }
+  }, py::arg("A"), py::arg("fun"), py::arg("fun_params"), py::arg("deg"), py::arg("rtol"), py::arg("orth"), py::arg("ncv"), 
+    py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), py::arg("deg_start"), py::arg("deg_step"), py::arg("atol"), py::arg("adapt_rtol"), 
+    py::arg("quad"), py::arg("reorth"), py::arg("estimates"), py::arg("degrees"), py::arg("arena") = py::none(), py::arg("offset") = 0);
+  m.def(("trace_converge" + suffix).c_str(), []( 
+    const Matrix& A, const std::string& fun, const SpectralParams< S >& fun_params, 
+    const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv, 
+    const std::string& pdf, const int64_t seed, const int num_threads, const int block_size, const std::string& quad,
+    const std::string& reorth_name, const std::vector< StoppingCriterion >& criteria, const int check_every, 
+    MeanEstimator& est, py_array< S >& estimates, LanczosArena< F, S >* arena
+  ) -> int {
+    const auto op = Wrapper(A);
+    const auto sf = param_spectral_func< S >(fun, fun_params);
+    const auto dist = parse_distribution(pdf);
+    const auto method = parse_weight_method(quad);
+    const auto reorth = parse_orth_method(reorth_name);
+    const int nv = static_cast< int >(estimates.size());
+    if constexpr (is_native_operator< Wrapper >){
+      py::gil_scoped_release release;
+      return slq_trace_converge< F, Wrapper, S >(op, sf, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, criteria, check_every, estimates.mutable_data(), est, block_size, method, reorth, arena);
+    } else {
+      return slq_trace_converge< F, Wrapper, S >(op, sf, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, 1, criteria, check_every, estimates.mutable_data(), est, block_size, method, reorth, arena);
+    }
+  }, py::arg("A"), py::arg("fun"), py::arg("fun_params"), py::arg("deg"), py::arg("rtol"), py::arg("orth"), py::arg("ncv"), 
+    py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), py::arg("block_size"), py::arg("quad"), py::arg("reorth"), 
+    py::arg("criteria"), py::arg("check_every"), py::arg("estimator"), py::arg("estimates"), py::arg("arena") = py::none());
+  m.def(("trace_quad_multi" + suffix).c_str(), []( 
+    const Matrix& A, const std::vector< std::string >& funs, const std::vector< SpectralParams< S > >& funs_params, 
+    const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv, 
+    const std::string& pdf, const int64_t seed, const int num_threads, const int block_size, const std::string& quad,
+    const std::string& reorth_name, py_array< S >& estimates, LanczosArena< F, S >* arena
+  ){
+    const auto op = Wrapper(A);
+    if (funs.size() != funs_params.size()){ throw std::invalid_argument("Each function requires its own parameters."); }
+    auto sfs = std::vector< SpectralFunction< S > >();
+    for (size_t j = 0; j < funs.size(); ++j){ sfs.push_back(param_spectral_func< S >(funs[j], funs_params[j])); }
+    const auto dist = parse_distribution(pdf);
+    const auto method = parse_weight_method(quad);
+    const auto reorth = parse_orth_method(reorth_name);
+    if (estimates.ndim() != 2 || size_t(estimates.shape(1)) != sfs.size()){ throw std::invalid_argument("Estimates must be an (nv x len(funs)) array."); }
+    const int nv = static_cast< int >(estimates.shape(0));
+    if constexpr (is_native_operator< Wrapper >){
+      py::gil_scoped_release release;
+      slq_trace_multi< F, Wrapper, S >(op, sfs, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, estimates.mutable_data(), block_size, method, reorth, arena);
+    } else {
+      slq_trace_multi< F, Wrapper, S >(op, sfs, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, 1, estimates.mutable_data(), block_size, method, reorth, arena);
+    }
+  }, py::arg("A"), py::arg("funs"), py::arg("funs_params"), py::arg("deg"), py::arg("rtol"), py::arg("orth"), py::arg("ncv"), 
+    py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), py::arg("block_size"), py::arg("quad"), py::arg("reorth"), 
+    py::arg("estimates"), py::arg("arena") = py::none());
+  m.def(("trace_rules" + suffix).c_str(), []( 
+    const Matrix& A, const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv, 
+    const std::string& pdf, const int64_t seed, const int num_threads, const int block_size, const std::string& quad,
+    const std::string& reorth_name, py_array< S >& nodes, py_array< S >& weights, LanczosArena< F, S >* arena
+  ){
+    const auto op = Wrapper(A);
+    const auto dist = parse_distribution(pdf);
+    const auto method = parse_weight_method(quad);
+    const auto reorth = parse_orth_method(reorth_name);
+    const int deg = param_deg(lanczos_degree, op.shape());
+    if (nodes.ndim() != 2 || nodes.shape(0) != deg || weights.ndim() != 2 || weights.shape(0) != deg || weights.shape(1) != nodes.shape(1)){ 
+      throw std::invalid_argument("Nodes and weights must be (deg x nv) arrays."); 
+    }
+    const int nv = static_cast< int >(nodes.shape(1));
+    if constexpr (is_native_operator< Wrapper >){
+      py::gil_scoped_release release;
+      slq_rules< F, Wrapper, S >(op, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, nodes.mutable_data(), weights.mutable_data(), block_size, method, reorth, arena);
+    } else {
+      slq_rules< F, Wrapper, S >(op, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, 1, nodes.mutable_data(), weights.mutable_data(), block_size, method, reorth, arena);
+    }
+  }, py::arg("A"), py::arg("deg"), py::arg("rtol"), py::arg("orth"), py::arg("ncv"), 
+    py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), py::arg("block_size"), py::arg("quad"), py::arg("reorth"), 
+    py::arg("nodes"), py::arg("weights"), py::arg("arena") = py::none());
+  m.def(("spectral_density" + suffix).c_str(), []( 
+    const Matrix& A, const py_array< S >& grid, const std::string& kernel_name, const S bandwidth, const int nv,
+    const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv, 
+    const std::string& pdf, const int64_t seed, const int num_threads, const int block_size, const std::string& quad,
+    const std::string& reorth_name, py_array< S >& density, LanczosArena< F, S >* arena
+  ){
+    const auto op = Wrapper(A);
+    const auto kernel = parse_density_kernel(kernel_name);
+    const auto dist = parse_distribution(pdf);
+    const auto method = parse_weight_method(quad);
+    const auto reorth = parse_orth_method(reorth_name);
+    const int ng = static_cast< int >(grid.size());
+    if (density.size() != grid.size()){ throw std::invalid_argument("The density must be of the same size as the grid."); }
+    if constexpr (is_native_operator< Wrapper >){
+      py::gil_scoped_release release;
+      slq_density< F, Wrapper, S >(op, grid.data(), ng, kernel, bandwidth, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, density.mutable_data(), block_size, method, reorth, arena);
+    } else {
+      slq_density< F, Wrapper, S >(op, grid.data(), ng, kernel, bandwidth, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, 1, density.mutable_data(), block_size, method, reorth, arena);
+    }
+  }, py::arg("A"), py::arg("grid"), py::arg("kernel"), py::arg("bandwidth"), py::arg("nv"), py::arg("deg"), py::arg("rtol"), 
+    py::arg("orth"), py::arg("ncv"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), py::arg("block_size"), 
+    py::arg("quad"), py::arg("reorth"), py::arg("density"), py::arg("arena") = py::none());
+  m.def(("trace_path" + suffix).c_str(), []( 
+    const Matrix& A, const std::string& fun, const SpectralParams< S >& fun_params, const py_array< F >& ts,
+    const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv, 
+    const std::string& pdf, const int64_t seed, const int num_threads, const int block_size, const std::string& quad,
+    const std::string& reorth_name, py_array< S >& estimates, LanczosArena< F, S >* arena
+  ){
+    const auto op = Wrapper(A);
+    const auto sf = param_spectral_func< S >(fun, fun_params);
+    const auto dist = parse_distribution(pdf);
+    const auto method = parse_weight_method(quad);
+    const auto reorth = parse_orth_method(reorth_name);
+    const int m = static_cast< int >(ts.size());
+    if (estimates.ndim() != 2 || estimates.shape(1) != m){ throw std::invalid_argument("Estimates must be an (nv x len(ts)) array."); }
+    const int nv = static_cast< int >(estimates.shape(0));
+    if constexpr (is_native_operator< Wrapper >){
+      py::gil_scoped_release release;
+      slq_trace_path< F, Wrapper, S >(op, sf, m, ts.data(), nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, estimates.mutable_data(), block_size, method, reorth, arena);
+    } else {
+      slq_trace_path< F, Wrapper, S >(op, sf, m, ts.data(), nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, 1, estimates.mutable_data(), block_size, method, reorth, arena);
+    }
+  }, py::arg("A"), py::arg("fun"), py::arg("fun_params"), py::arg("ts"), py::arg("deg"), py::arg("rtol"), py::arg("orth"), py::arg("ncv"), 
+    py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), py::arg("block_size"), py::arg("quad"), py::arg("reorth"), 
+    py::arg("estimates"), py::arg("arena") = py::none());
+  if constexpr (std::is_same_v< S, F >){
+    m.def(("hutchpp" + suffix).c_str(), [](const Matrix& A, const int nb, const int nv, const std::string& pdf, const int64_t seed, const int num_threads){
+      return _hutchpp< F, Wrapper, is_native_operator< Wrapper > >(Wrapper(A), nb, nv, pdf, seed, num_threads);
+    }, py::arg("A"), py::arg("nb"), py::arg("nv"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"));
+    m.def(("xtrace" + suffix).c_str(), [](const Matrix& A, const int k, const std::string& pdf, const int64_t seed, const int num_threads){
+      return _xtrace< F, Wrapper, is_native_operator< Wrapper > >(Wrapper(A), k, pdf, seed, num_threads);
+    }, py::arg("A"), py::arg("m"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"));
+    m.def(("diag" + suffix).c_str(), [](const Matrix& A, const int nv, const std::string& pdf, const int64_t seed, const int num_threads, 
+      py_array< F >& mean, py_array< F >& m2, py_array< F >& denom, const int64_t count){
+      return _diag< F, Wrapper, is_native_operator< Wrapper > >(Wrapper(A), nv, pdf, seed, num_threads, mean, m2, denom, count);
+    }, py::arg("A"), py::arg("nv"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), 
+      py::arg("mean").noconvert(), py::arg("m2").noconvert(), py::arg("denom").noconvert(), py::arg("count"));
+    m.def(("xdiag" + suffix).c_str(), [](const Matrix& A, const int k, const std::string& pdf, const int64_t seed, const int num_threads){
+      return _xdiag< F, Wrapper, is_native_operator< Wrapper > >(Wrapper(A), k, pdf, seed, num_threads);
+    }, py::arg("A"), py::arg("m"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"));
+  }
+  if constexpr (std::is_same_v< F, float > && std::is_same_v< S, F >){
+    _trace_wrapper< F, Matrix, Wrapper, double >(m, suffix);
+  }
+}
+
+// Template function for generating a MatrixFunction class for a given Operator / precision 
+// All workspace is owned by the bound instance, so repeated matvec / quad calls do not allocate beyond their outputs
+template< std::floating_point F, class Matrix, LinearOperator Wrapper >
+void _matrix_function_wrapper(py::module& m, const std::string& kind){
+  using MF = MatrixFunction< F, Wrapper >;
+  const auto name = std::string("MatrixFunction_") + kind + "_" + TypeString< F >::value;
+  py::class_< MF >(m, name.c_str())
+    .def(py::init([](const Matrix& A, const std::string& fun, const SpectralParams< F >& fun_params, const int deg, const F rtol, const int orth, const int ncv){
+      return new MF(Wrapper(A), param_spectral_func< F >(fun, fun_params), deg, rtol, orth, ncv);
+    }), py::keep_alive< 1, 2 >())
+    .def(py::init([](const Matrix& A, const py::function& fun, const int deg, const F rtol, const int orth, const int ncv){
+      return new MF(Wrapper(A), py_spectral_func< F >(fun), deg, rtol, orth, ncv);
+    }), py::keep_alive< 1, 2 >())
+    .def_readonly("deg", &MF::deg)
+    .def_readonly("ncv", &MF::ncv)
+    .def_readwrite("rtol", &MF::rtol)
+    .def_readwrite("orth", &MF::orth)
+    .def_property("quad", 
+      [](const MF& M){ return std::string(M.method == fttr ? "fttr" : "golub_welsch"); }, 
+      [](MF& M, const std::string& quad){ M.method = parse_weight_method(quad); }
+    )
+    .def_property("reorth", 
+      [](const MF& M){ return std::string(M.reorth == cgs2 ? "cgs2" : (M.reorth == partial ? "partial" : "mgs")); }, 
+      [](MF& M, const std::string& reorth){ M.reorth = parse_orth_method(reorth); }
+    )
+    .def_readwrite("two_pass", &MF::two_pass)
+    .def("set_basis", [](MF& M, py::array_t< F, py::array::f_style >& Q){
+      if (Q.ndim() != 2 || size_t(Q.shape(0)) != M.shape().first || Q.shape(1) != M.deg || !Q.writeable()){ 
+        throw std::invalid_argument("The basis must be a writeable, Fortran-contiguous (n x deg) array."); 
+      }
+      M.basis = Q.mutable_data();
+    }, py::arg("Q").noconvert(), py::keep_alive< 1, 2 >())
+    .def_property_readonly("shape", &MF::shape)
+    .def_property_readonly("dtype", [](const MF& M){ return py::dtype(py::format_descriptor< F >::format()); })
+    .def("set_function", [](MF& M, const std::string& fun, const SpectralParams< F >& fun_params){
+      M.f = param_spectral_func< F >(fun, fun_params);
+    })
+    .def("set_function", [](MF& M, const py::function& fun){
+      M.f = py_spectral_func< F >(fun);
+    })
+    .def("matvec", [](const MF& M, const py_array< F >& x) -> py_array< F > {
+      if (size_t(x.size()) != M.shape().second){ throw std::invalid_argument("Input dimension mismatch; vector inputs must match shape of the operator."); }
+      auto y = py_array< F >(static_cast< py::ssize_t >(M.shape().first));
+      M.matvec(x.data(), y.mutable_data());
+      return y;
+    })
+    .def("matvec", [](const MF& M, const py_array< F >& x, py_array< F >& y){
+      if (size_t(x.size()) != M.shape().second || size_t(y.size()) != M.shape().first){ 
+        throw std::invalid_argument("Input dimension mismatch; vector inputs must match shape of the operator."); 
+      }
+      M.matvec(x.data(), y.mutable_data());
+    })
+    .def("matmat", [](const MF& M, const py_array< F >& X) -> py_array< F > {
+      if (X.ndim() != 2 || size_t(X.shape(0)) != M.shape().second){ throw std::invalid_argument("Input dimension mismatch; input must be 2-dimensional and match the shape of the operator."); }
+      const auto k = X.shape(1);
+      auto Y = py_array< F >({ static_cast< py::ssize_t >(M.shape().first), k });
+      M.matmat(X.data(), Y.mutable_data(), size_t(k));
+      return Y;
+    })
+    .def("hutchpp", [](const MF& M, const int nb, const int nv, const std::string& pdf, const int64_t seed, const int num_threads){
+      return _hutchpp< F, MF, is_native_operator< Wrapper > >(M, nb, nv, pdf, seed, num_threads);
+    }, py::arg("nb"), py::arg("nv"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"))
+    .def("xtrace", [](const MF& M, const int m, const std::string& pdf, const int64_t seed, const int num_threads){
+      return _xtrace< F, MF, is_native_operator< Wrapper > >(M, m, pdf, seed, num_threads);
+    }, py::arg("m"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"))
+    .def("diag", [](const MF& M, const int nv, const std::string& pdf, const int64_t seed, const int num_threads, 
+      py_array< F >& mean, py_array< F >& m2, py_array< F >& denom, const int64_t count){
+      return _diag< F, MF, is_native_operator< Wrapper > >(M, nv, pdf, seed, num_threads, mean, m2, denom, count);
+    }, py::arg("nv"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), 
+      py::arg("mean").noconvert(), py::arg("m2").noconvert(), py::arg("denom").noconvert(), py::arg("count"))
+    .def("xdiag", [](const MF& M, const int m, const std::string& pdf, const int64_t seed, const int num_threads){
+      return _xdiag< F, MF, is_native_operator< Wrapper > >(M, m, pdf, seed, num_threads);
+    }, py::arg("m"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"))
+    .def("quad", [](const MF& M, const py_array< F >& X) -> py_array< F > {
+      if (X.ndim() < 1 || X.ndim() > 2 || size_t(X.shape(0)) != M.shape().second){ 
+        throw std::invalid_argument("Input dimension mismatch; input must be 1 or 2-dimensional and match the shape of the operator."); 
+      }
+      const auto n = X.shape(0);
+      const auto k = X.ndim() == 1 ? py::ssize_t(1) : X.shape(1);
+      auto y = py_array< F >(k);
+      auto y_ptr = y.mutable_data();
+      for (py::ssize_t j = 0; j < k; ++j){
+        y_ptr[j] = M.quad(X.data() + j * n);
+      }
+      return y;
+    });
+}
+
+// Template function for generating a ChebyshevFunction class for a given Operator / precision 
+// The function is only evaluated on construction, so callables are supported without calling back into Python afterwards
+template< std::floating_point F, class Matrix, LinearOperator Wrapper >
+void _chebyshev_wrapper(py::module& m, const std::string& kind){
+  using CF = ChebyshevFunction< F, Wrapper >;
+  constexpr bool native = is_native_operator< Wrapper >;
+  const auto name = std::string("ChebyshevFunction_") + kind + "_" + TypeString< F >::value;
+  py::class_< CF >(m, name.c_str())
+    .def(py::init([](const Matrix& A, const std::string& fun, const SpectralParams< F >& fun_params, const int deg, const F lo, const F hi, const std::string& damping){
+      return new CF(Wrapper(A), param_spectral_func< F >(fun, fun_params), deg, lo, hi, parse_chebyshev_damping(damping));
+    }), py::arg("A"), py::arg("fun"), py::arg("fun_params"), py::arg("deg"), py::arg("lo"), py::arg("hi"), py::arg("damping"), py::keep_alive< 1, 2 >())
+    .def(py::init([](const Matrix& A, const py::function& fun, const int deg, const F lo, const F hi, const std::string& damping){
+      return new CF(Wrapper(A), py_spectral_func< F >(fun), deg, lo, hi, parse_chebyshev_damping(damping));
+    }), py::arg("A"), py::arg("fun"), py::arg("deg"), py::arg("lo"), py::arg("hi"), py::arg("damping"), py::keep_alive< 1, 2 >())
+    .def_readonly("deg", &CF::deg)
+    .def_readonly("lo", &CF::lo)
+    .def_readonly("hi", &CF::hi)
+    .def_property_readonly("coeffs", [](const CF& M){ return py_array< F >(M.coeffs.size(), M.coeffs.data()); })
+    .def_property_readonly("shape", &CF::shape)
+    .def_property_readonly("dtype", [](const CF& M){ return py::dtype(py::format_descriptor< F >::format()); })
+    .def("matvec", [](const CF& M, const py_array< F >& x) -> py_array< F > {
+      if (size_t(x.size()) != M.shape().second){ throw std::invalid_argument("Input dimension mismatch; vector inputs must match shape of the operator."); }
+      auto y = py_array< F >(static_cast< py::ssize_t >(M.shape().first));
+      M.matvec(x.data(), y.mutable_data());
+      return y;
+    })
+    .def("matmat", [](const CF& M, const py_array< F >& X) -> py_array< F > {
+      if (X.ndim() != 2 || size_t(X.shape(0)) != M.shape().second){ throw std::invalid_argument("Input dimension mismatch; input must be 2-dimensional and match the shape of the operator."); }
+      const auto k = X.shape(1);
+      auto Y = py_array< F >({ static_cast< py::ssize_t >(M.shape().first), k });
+      M.matmat(X.data(), Y.mutable_data(), size_t(k));
+      return Y;
+    })
+    .def("quad", [](const CF& M, const py_array< F >& X) -> py_array< F > {
+      if (X.ndim() < 1 || X.ndim() > 2 || size_t(X.shape(0)) != M.shape().second){ 
+        throw std::invalid_argument("Input dimension mismatch; input must be 1 or 2-dimensional and match the shape of the operator."); 
+      }
+      const auto k = X.ndim() == 1 ? py::ssize_t(1) : X.shape(1);
+      auto y = py_array< F >(k);
+      M.quad_block(X.data(), size_t(k), y.mutable_data());
+      return y;
+    })
+    .def("trace", [](const CF& M, const std::string& pdf, const int64_t seed, const int num_threads, const int block_size, py_array< F >& estimates, const uint64_t offset){
+      const auto dist = parse_distribution(pdf);
+      const int nv = static_cast< int >(estimates.size());
+      if constexpr (native){
+        py::gil_scoped_release release;
+        chebyshev_trace< F, Wrapper >(M, nv, dist, seed, num_threads, block_size, estimates.mutable_data(), offset);
+      } else {
+        chebyshev_trace< F, Wrapper >(M, nv, dist, seed, 1, block_size, estimates.mutable_data(), offset);
+      }
+    }, py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), py::arg("block_size"), py::arg("estimates").noconvert(), py::arg("offset") = 0)
+    .def("hutchpp", [](const CF& M, const int nb, const int nv, const std::string& pdf, const int64_t seed, const int num_threads){
+      return _hutchpp< F, CF, native >(M, nb, nv, pdf, seed, num_threads);
+    }, py::arg("nb"), py::arg("nv"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"))
+    .def("xtrace", [](const CF& M, const int m, const std::string& pdf, const int64_t seed, const int num_threads){
+      return _xtrace< F, CF, native >(M, m, pdf, seed, num_threads);
+    }, py::arg("m"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"))
+    .def("diag", [](const CF& M, const int nv, const std::string& pdf, const int64_t seed, const int num_threads, 
+      py_array< F >& mean, py_array< F >& m2, py_array< F >& denom, const int64_t count){
+      return _diag< F, CF, native >(M, nv, pdf, seed, num_threads, mean, m2, denom, count);
+    }, py::arg("nv"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"), 
+      py::arg("mean").noconvert(), py::arg("m2").noconvert(), py::arg("denom").noconvert(), py::arg("count"))
+    .def("xdiag", [](const CF& M, const int m, const std::string& pdf, const int64_t seed, const int num_threads){
+      return _xdiag< F, CF, native >(M, m, pdf, seed, num_threads);
+    }, py::arg("m"), py::arg("pdf"), py::arg("seed"), py::arg("num_threads"));
+}
+
 PYBIND11_MODULE(_lanczos, m) {
 
+  _operator_wrapper< float >(m);
+  _operator_wrapper< double >(m);
+
   _lanczos_wrapper< float, DenseMatrix< float >, DenseEigenLinearOperator< float > >(m);
   _lanczos_wrapper< double, DenseMatrix< double >, DenseEigenLinearOperator< double > >(m);
 
   _lanczos_wrapper< float, Eigen::SparseMatrix< float >, SparseEigenLinearOperator< float, false > >(m);
   _lanczos_wrapper< double, Eigen::SparseMatrix< double >, SparseEigenLinearOperator< double, false > >(m);
+
+  // NOTE: handles must be registered before py::object, which would otherwise accept them as generic linear operators
+  _lanczos_wrapper< float, DenseEigenMapOperator< float >, DenseEigenMapOperator< float > >(m);
+  _lanczos_wrapper< double, DenseEigenMapOperator< double >, DenseEigenMapOperator< double > >(m);
+
+  _lanczos_wrapper< float, SparseEigenMapOperator< float >, SparseEigenMapOperator< float > >(m);
+  _lanczos_wrapper< double, SparseEigenMapOperator< double >, SparseEigenMapOperator< double > >(m);
+
+  // CSR and symmetric handles are tried before SciPy matrices of the same suffix, which would be converted on every call
+  _lanczos_wrapper< float, CSREigenLinearOperator< float >, CSREigenLinearOperator< float > >(m, "_csr");
+  _lanczos_wrapper< double, CSREigenLinearOperator< double >, CSREigenLinearOperator< double > >(m, "_csr");
+
+  _lanczos_wrapper< float, SymmetricSparseEigenLinearOperator< float >, SymmetricSparseEigenLinearOperator< float > >(m, "_sym");
+  _lanczos_wrapper< double, SymmetricSparseEigenLinearOperator< double >, SymmetricSparseEigenLinearOperator< double > >(m, "_sym");
+
+  _lanczos_wrapper< float, Eigen::SparseMatrix< float, Eigen::RowMajor >, CSREigenLinearOperator< float > >(m, "_csr");
+  _lanczos_wrapper< double, Eigen::SparseMatrix< double, Eigen::RowMajor >, CSREigenLinearOperator< double > >(m, "_csr");
+
+  _lanczos_wrapper< float, Eigen::SparseMatrix< float >, SymmetricSparseEigenLinearOperator< float > >(m, "_sym");
+  _lanczos_wrapper< double, Eigen::SparseMatrix< double >, SymmetricSparseEigenLinearOperator< double > >(m, "_sym");
   
+  _lanczos_wrapper< float, SparseEigenAffineOperator< float >, SparseEigenAffineOperator< float > >(m, "_affine");
+  _lanczos_wrapper< double, SparseEigenAffineOperator< double >, SparseEigenAffineOperator< double > >(m, "_affine");
+
+  _lanczos_wrapper< float, ToeplitzLinearOperator< float >, ToeplitzLinearOperator< float > >(m, "_toeplitz");
+  _lanczos_wrapper< double, ToeplitzLinearOperator< double >, ToeplitzLinearOperator< double > >(m, "_toeplitz");
+
+  _lanczos_wrapper< float, AnyLinearOperator< float >, AnyLinearOperator< float > >(m, "_composite");
+  _lanczos_wrapper< double, AnyLinearOperator< double >, AnyLinearOperator< double > >(m, "_composite");
+
   _lanczos_wrapper< float, py::object, PyLinearOperator< float > >(m);
   _lanczos_wrapper< double, py::object, PyLinearOperator< double > >(m);
+
+  _estimator_wrapper(m);
+  _instrumentation_wrapper(m);
+
+  _random_wrapper< float >(m);
+  _random_wrapper< double >(m);
+
+  _jacobi_wrapper< float >(m);
+  _jacobi_wrapper< double >(m);
+
+  _arena_wrapper< float >(m);
+  _arena_wrapper< double >(m);
+  _arena_wrapper< float, double >(m);
+
+  _trace_wrapper< float, DenseMatrix< float >, DenseEigenLinearOperator< float > >(m);
+  _trace_wrapper< double, DenseMatrix< double >, DenseEigenLinearOperator< double > >(m);
+
+  _trace_wrapper< float, Eigen::SparseMatrix< float >, SparseEigenLinearOperator< float, false > >(m);
+  _trace_wrapper< double, Eigen::SparseMatrix< double >, SparseEigenLinearOperator< double, false > >(m);
+
+  _trace_wrapper< float, DenseEigenMapOperator< float >, DenseEigenMapOperator< float > >(m);
+  _trace_wrapper< double, DenseEigenMapOperator< double >, DenseEigenMapOperator< double > >(m);
+
+  _trace_wrapper< float, SparseEigenMapOperator< float >, SparseEigenMapOperator< float > >(m);
+  _trace_wrapper< double, SparseEigenMapOperator< double >, SparseEigenMapOperator< double > >(m);
+
+  // CSR and symmetric handles are tried before SciPy matrices of the same suffix, which would be converted on every call
+  _trace_wrapper< float, CSREigenLinearOperator< float >, CSREigenLinearOperator< float > >(m, "_csr");
+  _trace_wrapper< double, CSREigenLinearOperator< double >, CSREigenLinearOperator< double > >(m, "_csr");
+
+  _trace_wrapper< float, SymmetricSparseEigenLinearOperator< float >, SymmetricSparseEigenLinearOperator< float > >(m, "_sym");
+  _trace_wrapper< double, SymmetricSparseEigenLinearOperator< double >, SymmetricSparseEigenLinearOperator< double > >(m, "_sym");
+
+  _trace_wrapper< float, Eigen::SparseMatrix< float, Eigen::RowMajor >, CSREigenLinearOperator< float > >(m, "_csr");
+  _trace_wrapper< double, Eigen::SparseMatrix< double, Eigen::RowMajor >, CSREigenLinearOperator< double > >(m, "_csr");
+
+  _trace_wrapper< float, Eigen::SparseMatrix< float >, SymmetricSparseEigenLinearOperator< float > >(m, "_sym");
+  _trace_wrapper< double, Eigen::SparseMatrix< double >, SymmetricSparseEigenLinearOperator< double > >(m, "_sym");
+
+  _trace_wrapper< float, SparseEigenAffineOperator< float >, SparseEigenAffineOperator< float > >(m, "_affine");
+  _trace_wrapper< double, SparseEigenAffineOperator< double >, SparseEigenAffineOperator< double > >(m, "_affine");
+
+  _trace_wrapper< float, ToeplitzLinearOperator< float >, ToeplitzLinearOperator< float > >(m, "_toeplitz");
+  _trace_wrapper< double, ToeplitzLinearOperator< double >, ToeplitzLinearOperator< double > >(m, "_toeplitz");
+
+  _trace_wrapper< float, AnyLinearOperator< float >, AnyLinearOperator< float > >(m, "_composite");
+  _trace_wrapper< double, AnyLinearOperator< double >, AnyLinearOperator< double > >(m, "_composite");
+
+  _trace_wrapper< float, py::object, PyLinearOperator< float > >(m);
+  _trace_wrapper< double, py::object, PyLinearOperator< double > >(m);
+
+  // Matrix functions view dense and sparse matrices through operator handles, and share the matrices of CSR and symmetric ones
+  _matrix_function_wrapper< float, DenseEigenMapOperator< float >, DenseEigenMapOperator< float > >(m, "dense");
+  _matrix_function_wrapper< double, DenseEigenMapOperator< double >, DenseEigenMapOperator< double > >(m, "dense");
+
+  _matrix_function_wrapper< float, SparseEigenMapOperator< float >, SparseEigenMapOperator< float > >(m, "sparse");
+  _matrix_function_wrapper< double, SparseEigenMapOperator< double >, SparseEigenMapOperator< double > >(m, "sparse");
+
+  _matrix_function_wrapper< float, CSREigenLinearOperator< float >, CSREigenLinearOperator< float > >(m, "csr");
+  _matrix_function_wrapper< double, CSREigenLinearOperator< double >, CSREigenLinearOperator< double > >(m, "csr");
+
+  _matrix_function_wrapper< float, SymmetricSparseEigenLinearOperator< float >, SymmetricSparseEigenLinearOperator< float > >(m, "sym");
+  _matrix_function_wrapper< double, SymmetricSparseEigenLinearOperator< double >, SymmetricSparseEigenLinearOperator< double > >(m, "sym");
+
+  _matrix_function_wrapper< float, ToeplitzLinearOperator< float >, ToeplitzLinearOperator< float > >(m, "toeplitz");
+  _matrix_function_wrapper< double, ToeplitzLinearOperator< double >, ToeplitzLinearOperator< double > >(m, "toeplitz");
+
+  _matrix_function_wrapper< float, AnyLinearOperator< float >, AnyLinearOperator< float > >(m, "composite");
+  _matrix_function_wrapper< double, AnyLinearOperator< double >, AnyLinearOperator< double > >(m, "composite");
+
+  _matrix_function_wrapper< float, py::object, PyLinearOperator< float > >(m, "linop");
+  _matrix_function_wrapper< double, py::object, PyLinearOperator< double > >(m, "linop");
+
+  // Chebyshev expansions are registered for the same operators as the matrix functions
+  _chebyshev_wrapper< float, DenseEigenMapOperator< float >, DenseEigenMapOperator< float > >(m, "dense");
+  _chebyshev_wrapper< double, DenseEigenMapOperator< double >, DenseEigenMapOperator< double > >(m, "dense");
+
+  _chebyshev_wrapper< float, SparseEigenMapOperator< float >, SparseEigenMapOperator< float > >(m, "sparse");
+  _chebyshev_wrapper< double, SparseEigenMapOperator< double >, SparseEigenMapOperator< double > >(m, "sparse");
+
+  _chebyshev_wrapper< float, CSREigenLinearOperator< float >, CSREigenLinearOperator< float > >(m, "csr");
+  _chebyshev_wrapper< double, CSREigenLinearOperator< double >, CSREigenLinearOperator< double > >(m, "csr");
+
+  _chebyshev_wrapper< float, SymmetricSparseEigenLinearOperator< float >, SymmetricSparseEigenLinearOperator< float > >(m, "sym");
+  _chebyshev_wrapper< double, SymmetricSparseEigenLinearOperator< double >, SymmetricSparseEigenLinearOperator< double > >(m, "sym");
+
+  _chebyshev_wrapper< float, ToeplitzLinearOperator< float >, ToeplitzLinearOperator< float > >(m, "toeplitz");
+  _chebyshev_wrapper< double, ToeplitzLinearOperator< double >, ToeplitzLinearOperator< double > >(m, "toeplitz");
+
+  _chebyshev_wrapper< float, AnyLinearOperator< float >, AnyLinearOperator< float > >(m, "composite");
+  _chebyshev_wrapper< double, AnyLinearOperator< double >, AnyLinearOperator< double > >(m, "composite");
+
+  _chebyshev_wrapper< float, py::object, PyLinearOperator< float > >(m, "linop");
+  _chebyshev_wrapper< double, py::object, PyLinearOperator< double > >(m, "linop");
 };
 
 #endif
\ No newline at end of file
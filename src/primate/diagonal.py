@@ -5,7 +5,8 @@ import scipy as sp
 
 from .random import isotropic
 from .estimators import ConvergenceCriterion, convergence_criterion, MeanEstimator, EstimatorResult
-from .operators import is_valid_operator
+from .lanczos import _phase_stats
+from .operators import _native_estimator, is_valid_operator
 
 
 def diag(
@@ -37,6 +38,15 @@ def diag(
 		full: Whether to return additional information about the computation.
 		callback: Callable to execute between each iteration.
 
+	:::{.callout-note}
+	If `A` is a dense or sparse matrix or a `MatrixFunction` whose function was specified by name, and `pdf` is a string,
+	batches of `batch` probes (keyword argument, defaults to 32) are evaluated natively over `num_threads` threads (keyword
+	argument, defaults to all available). Each thread streams its samples into a private Welford accumulator, which are
+	merged once per batch; the elementwise sample variance is then returned in `info["variance"]` if `full = True`. The
+	sample count of the estimator counts probes rather than batches, and the last batch is cut to the probes remaining
+	under a `count` criterion, so `converge="count"` evaluates the same number of probes natively as in Python.
+	:::
+
 	Returns:
 		Estimate the diagonal of $A$. If `full = True`, additional information about the computation is also returned.
 
@@ -55,10 +65,13 @@ def diag(
 	"""
 	f_dtype = is_valid_operator(A)
 	N: int = A.shape[0]
+	phases = _phase_stats()
 
 	## Parameterize the random vector generation
 	rng = np.random.default_rng(seed)
-	pdf = isotropic(pdf=pdf, seed=rng)
+	num_threads, batch = kwargs.pop("num_threads", 0), kwargs.pop("batch", 32)
+	native = _native_estimator(A, "diag", f_dtype) if isinstance(pdf, str) else None
+	pdf = isotropic(pdf=pdf, seed=rng) if native is None else pdf
 	estimator = MeanEstimator(dim=N, covariance=False, record=record)
 	converge = convergence_criterion(converge, **kwargs)
 
@@ -66,6 +79,26 @@ def diag(
 	if np.prod(A.shape) == 0:
 		return 0.0 if not full else (0.0, EstimatorResult())
 
+	## Native estimators accumulate the batches of samples in-place, without forming any temporaries of their own
+	if native is not None:
+		mean, m2, denom = np.zeros(N, dtype=f_dtype), np.zeros(N, dtype=f_dtype), np.zeros(N, dtype=f_dtype)
+		count, result = 0, EstimatorResult(estimator, converge)
+		limits = [p["count"] for p in (converge._native_params() or []) if p["kind"] == "count"]
+		while not converge(estimator):
+			nb = int(batch) if len(limits) == 0 else max(1, min(int(batch), min(limits) - count))
+			count = native(nb, pdf, int(rng.integers(2**31)), int(num_threads), mean, m2, denom, count)
+			estimator.update(np.atleast_2d(count * mean / denom))
+			estimator.n_samples += nb - 1  # the update above stands for all nb probes of the batch
+			if callback is not None:
+				callback(result)
+		if not full:
+			return estimator.estimate
+		result.estimate = estimator.estimate
+		result.nit = count
+		result.info["variance"] = m2 / max(count - 1, 1)
+		result.stats = _phase_stats(phases)
+		return (estimator.estimate, result)
+
 	## Commence the Monte-Carlo iterations
 	if full or callback is not None:
 		numer, denom = np.zeros(N, dtype=f_dtype), np.zeros(N, dtype=f_dtype)
@@ -80,6 +113,7 @@ def diag(
 			if callback is not None:
 				callback(result)
 		result.estimate = estimator.estimate
+		result.stats = _phase_stats(phases)
 		return (estimator.estimate, result)
 	else:
 		numer, denom = np.zeros(N, dtype=f_dtype), np.zeros(N, dtype=f_dtype)
@@ -97,14 +131,24 @@ def diag(
 
 
 def xdiag(
-	A: np.ndarray, m: Optional[int] = None, pdf: str = "sphere", seed: Union[int, np.random.Generator, None] = None
+	A: np.ndarray,
+	m: Optional[int] = None,
+	pdf: str = "sphere",
+	seed: Union[int, np.random.Generator, None] = None,
+	num_threads: int = 0,
 ):
 	"""Estimates the diagonal of `A` using `m / 2` matrix-vector multiplications.
 
 	Based originally on Program SM4.3, a MATLAB 2022b implementation for XDiag, by Ethan Epperly.
+
+	If `A` is a dense or sparse matrix or a `MatrixFunction` whose function was specified by name, the sketch and all
+	subsequent products are computed natively (see `trace.hutchpp`), using `num_threads` threads.
 	"""
 	m = 2 * A.shape[0] if m is None else min(m + (m % 2), 2 * A.shape[0])
 	n, m = A.shape[0], m // 2
+	native = _native_estimator(A, "xdiag", is_valid_operator(A))
+	if native is not None:
+		return native(m, pdf, int(np.random.default_rng(seed=seed).integers(2**31)), int(num_threads))
 
 	## Configure
 	diag_prod = lambda A, B: np.einsum("ij,ji->i", A.T, B)[:, np.newaxis]  # about 120-140% faster than np.diag(A.T @ B)
@@ -61,7 +61,9 @@ class ConvergenceCriterion:
 		self._operation = operation
 
 	def __or__(self, other: "ConvergenceCriterion"):
-		return ConvergenceCriterion(lambda est: or_(self(est), other(est)))
+		cc = ConvergenceCriterion(lambda est: or_(self(est), other(est)))
+		cc._disjuncts = (self, other)
+		return cc
 
 	def __and__(self, other: "ConvergenceCriterion"):
 		return ConvergenceCriterion(lambda est: and_(self(est), other(est)))
@@ -75,6 +77,17 @@ class ConvergenceCriterion:
 	def message(self, est: Estimator) -> str:
 		return "Composite convergence criterion"
 
+	def _native_params(self) -> Optional[list]:
+		"""Parameters of the native criteria equivalent to this criterion, any of which must be met, or None if there are none.
+
+		Criteria with native equivalents can be tested by the native engines themselves, without returning to Python.
+		Disjunctions (`cc1 | cc2`) of such criteria are supported; conjunctions and negations are not.
+		"""
+		if not hasattr(self, "_disjuncts"):
+			return None
+		params = [cc._native_params() for cc in self._disjuncts]
+		return None if any(p is None for p in params) else sum(params, [])
+
 
 @dataclass
 class EstimatorResult:
@@ -86,6 +99,7 @@ class EstimatorResult:
 	message: str = ""
 	nit: int = 0
 	info: dict = field(default_factory=dict)
+	stats: dict = field(default_factory=dict)  # counts and times of the native phases; see `lanczos._phase_stats`
 
 	def __iter__(self) -> Iterable:
 		return iter((self.estimator, self.criterion, self.estimate, self.message, self.nit, self.info))
@@ -140,6 +154,17 @@ class MeanEstimator(Estimator):
 		if self.values is not None:
 			self.values.extend(x)
 
+	def merge(self, n: int, mean: Union[float, np.ndarray], m2: Union[float, np.ndarray]) -> None:
+		"""Merges the sufficient statistics of `n` samples (their mean and sum of squared deviations `m2`) into the estimate.
+
+		Equivalent to calling `update` with the samples themselves, up to rounding, but requires `covariance=True`.
+		"""
+		assert hasattr(self, "_cov"), "Merging sufficient statistics requires the covariance to be tracked."
+		old_mu = self._cov.mu.copy()
+		self._cov.merge(int(n), mean, m2)
+		self.delta = self._cov.mu - old_mu
+		self.n_samples += int(n)
+
 	@property
 	def estimate(self) -> Union[float, np.ndarray]:
 		return self.mean
@@ -217,6 +242,9 @@ class CountCriterion(ConvergenceCriterion):
 		msg = f"Est: {arr_summary(np.array(est.estimate))} (#S:{ len(est) })"
 		return msg
 
+	def _native_params(self) -> Optional[list]:
+		return [dict(kind="count", count=int(self.count))]
+
 
 class ToleranceCriterion(ConvergenceCriterion):
 	def __init__(
@@ -242,6 +270,10 @@ class ToleranceCriterion(ConvergenceCriterion):
 			msg += f"\nnorm(it - est, {self.ord}) = {error:.3f}, norm(est, {self.ord}) = {norm:.3f}"
 		return msg
 
+	def _native_params(self) -> Optional[list]:
+		## NOTE: the native engines estimate scalars, for which every norm is the absolute value
+		return [dict(kind="tolerance", atol=float(self.atol), rtol=float(self.rtol))]
+
 
 class ConfidenceCriterion(ConvergenceCriterion):
 	"""Parameterizes an expected value estimator that checks convergence of a sample mean within a confidence interval using the CLT."""
@@ -298,6 +330,10 @@ class ConfidenceCriterion(ConvergenceCriterion):
 		msg += f" +/- {moe:.3f} ({self.confidence*100:.0f}% CI, #S:{ len(est) })"  # | {(cv*100):.0f}% CV
 		return msg
 
+	def _native_params(self) -> Optional[list]:
+		t_scores = [float(t) for t in self.t_scores]
+		return [dict(kind="confidence", atol=float(self.atol), rtol=float(self.rtol), z=float(self.z), t_scores=t_scores)]
+
 
 class KneeCriterion(ConvergenceCriterion):
 	def __init__(self, S: float = 1.0) -> None:
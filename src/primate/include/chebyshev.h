@@ -0,0 +1,222 @@
+#ifndef _CHEBYSHEV_H
+#define _CHEBYSHEV_H
+
+#include <concepts>   // std::floating_point
+#include <cstdint>    // int64_t, uint32_t
+#include <cmath>      // cos, sin, acos
+#include <numbers>    // pi
+#include <vector>     // vector
+#include <string>     // string
+#include <stdexcept>  // invalid_argument
+#include <exception>  // exception_ptr
+#include <atomic>     // atomic_bool
+#include <algorithm>  // min, max
+#include <memory>     // shared_ptr
+
+#include "lanczos.h"              // DenseMatrix, Vector, SpectralFunction
+#include "random_generator.h"     // Distribution, generate_probe
+#include "trace.h"                // generate_probes, thread_copy, param_seed
+#include "omp_support.h"          // conditionally enables openmp pragmas
+
+// Damping of the Chebyshev coefficients; Jackson's kernel suppresses the Gibbs oscillations of non-smooth functions
+enum chebyshev_damping { no_damping = 0, jackson_damping = 1 };
+
+inline auto parse_chebyshev_damping(const std::string& damping) -> chebyshev_damping {
+  if (damping == "none"){ return no_damping; }
+  if (damping == "jackson"){ return jackson_damping; }
+  throw std::invalid_argument("Invalid damping '" + damping + "' supplied; must be one of 'none' or 'jackson'.");
+}
+
+// Coefficients c_0, ..., c_deg of the degree-deg Chebyshev interpolant of f on the interval [lo, hi]
+// f is evaluated once, at the deg + 1 Chebyshev nodes of the first kind, and the coefficients follow from their discrete
+// cosine transform (accumulated in double precision). The interpolant is sum_k c_k T_k((2x - (hi + lo)) / (hi - lo)).
+template< std::floating_point F >
+void chebyshev_coefficients(
+  const SpectralFunction< F >& f,     // spectral function to interpolate
+  const int deg,                      // degree of the interpolant
+  const F lo, const F hi,             // interval containing the spectrum
+  const chebyshev_damping damping,    // damping of the coefficients
+  F* coeffs                           // output coefficients (deg + 1)
+){
+  if (deg < 0){ throw std::invalid_argument("The degree of the expansion must be non-negative."); }
+  if (!(hi > lo)){ throw std::invalid_argument("The spectral bounds must satisfy lo < hi."); }
+  const int N = deg + 1;
+  constexpr double pi = std::numbers::pi;
+  auto fx = std::vector< F >(N);
+  for (int j = 0; j < N; ++j){
+    const double x = std::cos(pi * (j + 0.5) / N);
+    fx[j] = static_cast< F >(0.5 * (double(hi) - double(lo)) * x + 0.5 * (double(hi) + double(lo)));
+  }
+  f(fx.data(), fx.size());
+  for (int k = 0; k < N; ++k){
+    double c = 0.0;
+    for (int j = 0; j < N; ++j){ c += double(fx[j]) * std::cos(pi * k * (j + 0.5) / N); }
+    c *= (k == 0 ? 1.0 : 2.0) / N;
+    if (damping == jackson_damping){
+      const double a = pi / (N + 1);
+      c *= ((N - k + 1) * std::cos(k * a) + std::sin(k * a) / std::tan(a)) / (N + 1);
+    }
+    coeffs[k] = static_cast< F >(c);
+  }
+}
+
+// Approximates f(A) by its Chebyshev expansion p(A) = sum_k c_k T_k(B), B = (2A - (hi + lo) I) / (hi - lo), on an interval
+// [lo, hi] containing the spectrum of A; an alternative to the Lanczos method of MatrixFunction for smooth f.
+// The coefficients are fit once on construction, after which f is never evaluated again (in particular, Python callbacks
+// are only called by the constructor). Products p(A)v run the three-term recurrence w_{k+1} = 2 B w_k - w_{k-1} over
+// three vectors: there is no basis to store, no reorthogonalization, and no inner product upon which the next step
+// depends, so each step is a single matvec (or matmat, for blocks) that may be pipelined freely. Quadratic forms use
+// the doubling identities T_{2k} = 2 T_k^2 - 1 and T_{2k+1} = 2 T_{k+1} T_k - T_1, taking ceil(deg / 2) matvecs.
+template< std::floating_point F, LinearOperator Matrix >
+struct ChebyshevFunction {
+  using value_type = F;
+  using VectorF = Eigen::Matrix< F, Dynamic, 1 >;
+
+  std::shared_ptr< const Matrix > op_ptr; // the operator, shared by all copies (see thread_copy)
+  const Matrix& op;
+  const int deg;
+  const F lo, hi;
+  VectorF coeffs;
+
+  ChebyshevFunction(Matrix A, const SpectralFunction< F >& f, const int _deg, const F _lo, const F _hi, const chebyshev_damping damping = no_damping)
+  : op_ptr(std::make_shared< const Matrix >(std::move(A))), op(*op_ptr), deg(_deg), lo(_lo), hi(_hi) {
+    if (op.shape().first != op.shape().second){ throw std::invalid_argument("Chebyshev expansions require a square operator."); }
+    coeffs = static_cast< VectorF >(VectorF::Zero(deg + 1));
+    chebyshev_coefficients< F >(f, deg, lo, hi, damping, coeffs.data());
+  }
+
+  // y = p(A) v
+  void matvec(const F* v, F* y) const {
+    matmat(v, y, 1);
+  }
+
+  // Y = p(A) X for the k columns of X, applying A blockwise via matmat if it supports it
+  void matmat(const F* X, F* Y, const size_t k) const {
+    const size_t nk = op.shape().first * k;
+    auto YM = Eigen::Map< VectorF >(Y, nk);
+    recurrence(X, k, [&](const int i, const F* W, const F*){
+      if (i == 0){ YM = coeffs[0] * Eigen::Map< const VectorF >(W, nk); }
+      else { YM += coeffs[i] * Eigen::Map< const VectorF >(W, nk); }
+    });
+  }
+
+  // v^T p(A) v
+  auto quad(const F* v) const -> F {
+    F form;
+    quad_block(v, 1, &form);
+    return form;
+  }
+
+  // forms[j] = x_j^T p(A) x_j for the k columns x_j of X
+  // The moments mu_i = x^T T_i(B) x are recovered from the products of pairs of vectors of the recurrence, which are
+  // accumulated as the recurrence runs, but never read by it.
+  void quad_block(const F* X, const size_t k, F* forms) const {
+    const size_t n = op.shape().first;
+    const int m = (deg + 1) / 2; // T_0, ..., T_m suffice for the moments 0, ..., 2m >= deg
+    mu.resize(deg + 1, k);
+    mu.setZero();
+    recurrence(X, k, [&](const int i, const F* W, const F* W_prev){
+      const auto Wi = Eigen::Map< const DenseMatrix< F > >(W, n, k);
+      if (i == 0){
+        mu.row(0) = Wi.colwise().squaredNorm();
+      } else {
+        const auto Wp = Eigen::Map< const DenseMatrix< F > >(W_prev, n, k);
+        if (i == 1){ mu.row(1) = Wi.cwiseProduct(Wp).colwise().sum(); }
+        if (2 * i <= deg){ mu.row(2 * i) = F(2) * Wi.colwise().squaredNorm() - mu.row(0); }
+        if (2 * i - 1 <= deg && i > 1){ mu.row(2 * i - 1) = F(2) * Wi.cwiseProduct(Wp).colwise().sum() - mu.row(1); }
+      }
+    }, m);
+    Eigen::Map< VectorF >(forms, k) = (coeffs.transpose() * mu).transpose();
+  }
+
+  auto shape() const noexcept -> std::pair< size_t, size_t > {
+    return op.shape();
+  }
+
+  private:
+  // Workspace of the recurrence for the current block size; w0, w1, w2 cycle through the roles of w_{i-1}, w_i, w_{i+1}
+  mutable DenseMatrix< F > w0, w1, w2;
+  mutable DenseMatrix< F > mu;      // moments of quad_block
+
+  // Runs the recurrence on the k columns of X for i = 0, ..., i_max (default: deg), calling visit(i, w_i, w_{i-1})
+  template< typename Visitor >
+  void recurrence(const F* X, const size_t k, Visitor&& visit, int i_max = -1) const {
+    const size_t n = op.shape().first;
+    i_max = i_max < 0 ? deg : i_max;
+    if (size_t(w0.cols()) != k || size_t(w0.rows()) != n){ w0.resize(n, k); w1.resize(n, k); w2.resize(n, k); }
+    const F s = F(2) / (hi - lo), t = (hi + lo) / (hi - lo);
+    F* prev = w0.data(); F* cur = w1.data(); F* next = w2.data();
+    const size_t nk = n * k;
+    std::copy_n(X, nk, cur);
+    visit(0, cur, nullptr);
+    for (int i = 1; i <= i_max; ++i){
+      // next = (i == 1 ? 1 : 2) * B cur - (i == 1 ? 0 : prev), with B cur = s * A cur - t * cur
+      apply(cur, next, k);
+      const F a = i == 1 ? F(1) : F(2);
+      if (i == 1){
+        #pragma omp simd
+        for (size_t p = 0; p < nk; ++p){ next[p] = a * (s * next[p] - t * cur[p]); }
+      } else {
+        #pragma omp simd
+        for (size_t p = 0; p < nk; ++p){ next[p] = a * (s * next[p] - t * cur[p]) - prev[p]; }
+      }
+      F* tmp = prev; prev = cur; cur = next; next = tmp;
+      visit(i, cur, prev);
+    }
+  }
+
+  void apply(const F* X, F* Y, const size_t k) const {
+    PRIMATE_PHASE(matvec_phase, uint64_t(k));
+    const size_t n = op.shape().first;
+    if constexpr (SupportsMatrixMult< Matrix >){
+      if (k > 1){ op.matmat(X, Y, k); return; }
+    }
+    for (size_t j = 0; j < k; ++j){ op.matvec(X + j * n, Y + j * n); }
+  }
+};
+
+// Girard-Hutchinson estimates x_i^T p(A) x_i of nv isotropic probes, for the Chebyshev expansion p of a function f
+// Probes are scheduled dynamically among threads as in slq, each thread expanding blocks of block_size probes at a time
+// on its own copy of the expansion; probe i is the i-th probe of the generator keyed by `seed`, so the estimates do
+// not depend on the number of threads, and on the block size only through the rounding of the operator's matmat.
+// As in slq, probe i is sampled as probe `offset + i` of the generator.
+template< std::floating_point F, LinearOperator Matrix >
+void chebyshev_trace(
+  const ChebyshevFunction< F, Matrix >& M,  // Chebyshev expansion of f(A)
+  const int nv,                             // Number of probe vectors to sample
+  const Distribution dist,                  // Isotropic distribution to sample probes from
+  const int64_t seed,                       // Seed for the random number generators; negative values draw from std::random_device
+  const int num_threads,                    // Number of threads to use; non-positive values use all available
+  const int block_size,                     // Number of probes expanded together per thread
+  F* estimates,                             // Output estimates (nv)
+  const uint64_t offset = 0                 // Index of the first probe in the stream of the generator
+){
+  const size_t n = M.shape().first;
+  const int nb = std::max(1, block_size);
+  const int n_blocks = (nv + nb - 1) / nb;
+  const int nt = std::max(1, std::min(param_threads(num_threads), n_blocks));
+  const uint64_t base_seed = uint64_t(param_seed(seed));
+  std::exception_ptr error = nullptr;
+  std::atomic_bool failed = false;
+
+  #pragma omp parallel num_threads(nt)
+  {
+    const auto M_local = thread_copy(M);
+    auto X = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, nb));
+    #pragma omp for schedule(dynamic)
+    for (int b = 0; b < n_blocks; ++b){
+      if (failed){ continue; }
+      try {
+        const int i0 = b * nb, k = std::min(nb, nv - i0);
+        for (int j = 0; j < k; ++j){ generate_probe< F >(dist, n, base_seed, 0, offset + uint64_t(i0 + j), X.col(j).data()); }
+        M_local.quad_block(X.data(), size_t(k), estimates + i0);
+      } catch (...) {
+        #pragma omp critical
+        { if (!failed){ error = std::current_exception(); failed = true; } }
+      }
+    }
+  }
+  if (error){ std::rethrow_exception(error); }
+}
+
+#endif
@@ -0,0 +1,360 @@
+#ifndef _COMPOSITE_OPERATORS_H
+#define _COMPOSITE_OPERATORS_H
+
+#include <concepts>   // std::floating_point
+#include <memory>     // shared_ptr, make_shared
+#include <utility>    // move, pair
+#include <stdexcept>  // invalid_argument
+#include <vector>     // vector
+#include <Eigen/Core> // Matrix, Map
+
+#include "linear_operator.h" // LinearOperator, LinearAdditiveOperator, AdjointOperator, SupportsMatrixMult
+
+// Lazy compositions of linear operators, i.e. expression templates over the concepts of linear_operator.h
+// Each composite holds its operands by value and applies them on demand, such that e.g. (A + sI) / c is never formed.
+// Every composite is itself a LinearAdditiveOperator: y += alpha * Op x is forwarded to the matvec_add of its operands
+// where available (as for every operator of eigen_operators.h), such that sums, scalings and shifts of additive operators
+// need no temporaries. Products and Gram operators need one intermediate vector (or block) per product, which is taken
+// from per-thread scratch buffers (see Scratch), such that they are thread-safe yet only allocate on their first use.
+namespace composite {
+
+template< std::floating_point F >
+using VectorMap = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >;
+
+template< std::floating_point F >
+using ConstVectorMap = Eigen::Map< const Eigen::Matrix< F, Eigen::Dynamic, 1 > >;
+
+template< std::floating_point F >
+using MatrixMap = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, Eigen::Dynamic > >;
+
+template< std::floating_point F >
+using ConstMatrixMap = Eigen::Map< const Eigen::Matrix< F, Eigen::Dynamic, Eigen::Dynamic > >;
+
+// Scratch buffer of at least `size` entries for the intermediate vectors of a product, owned by the calling thread
+// The buffers of each thread are kept across calls, as the Toeplitz workspaces are. Products may nest, e.g. in A (B C) 
+// of type-erased operands, so each product in flight on a thread takes the buffer one level below that of its caller.
+template< std::floating_point F >
+class Scratch {
+  public:
+  explicit Scratch(const size_t size) : level(depth()++) {
+    auto& levels = buffers();
+    if (levels.size() <= level){ levels.resize(level + 1); } // moving the buffers keeps their memory
+    if (levels[level].size() < size){ levels[level].resize(size); }
+    ptr = levels[level].data();
+  }
+  ~Scratch(){ --depth(); }
+  Scratch(const Scratch&) = delete;
+  Scratch& operator=(const Scratch&) = delete;
+
+  auto data() const noexcept -> F* { return ptr; }
+
+  private:
+  size_t level;
+  F* ptr;
+
+  static auto depth() -> size_t& { thread_local size_t d = 0; return d; }
+  static auto buffers() -> std::vector< std::vector< F > >& { thread_local std::vector< std::vector< F > > b; return b; }
+};
+
+// y = y + alpha * A x, through A's matvec_add if it has one
+template< LinearOperator Op, std::floating_point F = typename Op::value_type >
+void matvec_add(const Op& A, const F* x, const F alpha, F* y){
+  if constexpr (LinearAdditiveOperator< Op >){
+    A.matvec_add(x, alpha, y);
+  } else {
+    const size_t m = A.shape().first;
+    const auto Ax = Scratch< F >(m);
+    A.matvec(x, Ax.data());
+    VectorMap< F >(y, m) += alpha * VectorMap< F >(Ax.data(), m);
+  }
+}
+
+// y = y + alpha * A^T x, through A's rmatvec_add if it has one
+template< AdjointOperator Op, std::floating_point F = typename Op::value_type >
+void rmatvec_add(const Op& A, const F* x, const F alpha, F* y){
+  if constexpr (AdjointAdditiveOperator< Op >){
+    A.rmatvec_add(x, alpha, y);
+  } else {
+    const size_t n = A.shape().second;
+    const auto ATx = Scratch< F >(n);
+    A.rmatvec(x, ATx.data());
+    VectorMap< F >(y, n) += alpha * VectorMap< F >(ATx.data(), n);
+  }
+}
+
+// Y = A X for the k columns of X, through A's matmat if it has one
+template< LinearOperator Op, std::floating_point F = typename Op::value_type >
+void matmat(const Op& A, const F* X, F* Y, const size_t k){
+  if constexpr (SupportsMatrixMult< Op >){
+    A.matmat(X, Y, k);
+  } else {
+    const auto [m, n] = A.shape();
+    for (size_t j = 0; j < k; ++j){ A.matvec(X + j * n, Y + j * m); }
+  }
+}
+
+} // namespace composite
+
+// The operator alpha * A
+template< LinearOperator Op >
+struct ScaledOp {
+  using value_type = typename Op::value_type;
+  using F = value_type;
+  const Op op;
+  const F alpha;
+
+  ScaledOp(Op _op, const F _alpha) : op(std::move(_op)), alpha(_alpha) {}
+
+  void matvec(const F* x, F* y) const {
+    op.matvec(x, y);
+    composite::VectorMap< F >(y, shape().first) *= alpha;
+  }
+
+  void matvec_add(const F* x, const F beta, F* y) const {
+    composite::matvec_add(op, x, alpha * beta, y);
+  }
+
+  void rmatvec(const F* x, F* y) const requires AdjointOperator< Op > {
+    op.rmatvec(x, y);
+    composite::VectorMap< F >(y, shape().second) *= alpha;
+  }
+
+  void matmat(const F* X, F* Y, const size_t k) const {
+    composite::matmat(op, X, Y, k);
+    composite::MatrixMap< F >(Y, shape().first, k) *= alpha;
+  }
+
+  auto shape() const -> std::pair< size_t, size_t > { return op.shape(); }
+};
+
+// The operator A + sigma * I of a square operator A
+template< LinearOperator Op >
+struct ShiftOp {
+  using value_type = typename Op::value_type;
+  using F = value_type;
+  const Op op;
+  const F sigma;
+
+  ShiftOp(Op _op, const F _sigma) : op(std::move(_op)), sigma(_sigma) {
+    if (op.shape().first != op.shape().second){ throw std::invalid_argument("Only square operators may be shifted."); }
+  }
+
+  void matvec(const F* x, F* y) const {
+    const size_t n = shape().first;
+    op.matvec(x, y);
+    composite::VectorMap< F >(y, n) += sigma * composite::ConstVectorMap< F >(x, n);
+  }
+
+  void matvec_add(const F* x, const F beta, F* y) const {
+    const size_t n = shape().first;
+    composite::matvec_add(op, x, beta, y);
+    composite::VectorMap< F >(y, n) += (beta * sigma) * composite::ConstVectorMap< F >(x, n);
+  }
+
+  void rmatvec(const F* x, F* y) const requires AdjointOperator< Op > {
+    const size_t n = shape().first;
+    op.rmatvec(x, y);
+    composite::VectorMap< F >(y, n) += sigma * composite::ConstVectorMap< F >(x, n);
+  }
+
+  void matmat(const F* X, F* Y, const size_t k) const {
+    const size_t n = shape().first;
+    composite::matmat(op, X, Y, k);
+    composite::MatrixMap< F >(Y, n, k) += sigma * composite::ConstMatrixMap< F >(X, n, k);
+  }
+
+  auto shape() const -> std::pair< size_t, size_t > { return op.shape(); }
+};
+
+// The operator A + B of two operators of the same shape
+template< LinearOperator OpA, LinearOperator OpB >
+requires std::same_as< typename OpA::value_type, typename OpB::value_type >
+struct SumOp {
+  using value_type = typename OpA::value_type;
+  using F = value_type;
+  const OpA a;
+  const OpB b;
+
+  SumOp(OpA _a, OpB _b) : a(std::move(_a)), b(std::move(_b)) {
+    if (a.shape() != b.shape()){ throw std::invalid_argument("Only operators of the same shape may be added."); }
+  }
+
+  void matvec(const F* x, F* y) const {
+    a.matvec(x, y);
+    composite::matvec_add(b, x, F(1), y);
+  }
+
+  void matvec_add(const F* x, const F beta, F* y) const {
+    composite::matvec_add(a, x, beta, y);
+    composite::matvec_add(b, x, beta, y);
+  }
+
+  void rmatvec(const F* x, F* y) const requires (AdjointOperator< OpA > && AdjointOperator< OpB >) {
+    a.rmatvec(x, y);
+    composite::rmatvec_add(b, x, F(1), y);
+  }
+
+  // The first operand is applied to the whole block, and the second accumulated into it column by column
+  void matmat(const F* X, F* Y, const size_t k) const {
+    const auto [m, n] = shape();
+    composite::matmat(a, X, Y, k);
+    for (size_t j = 0; j < k; ++j){ composite::matvec_add(b, X + j * n, F(1), Y + j * m); }
+  }
+
+  auto shape() const -> std::pair< size_t, size_t > { return a.shape(); }
+};
+
+// The operator A B of two operators whose inner dimensions agree
+template< LinearOperator OpA, LinearOperator OpB >
+requires std::same_as< typename OpA::value_type, typename OpB::value_type >
+struct ProductOp {
+  using value_type = typename OpA::value_type;
+  using F = value_type;
+  const OpA a;
+  const OpB b;
+
+  ProductOp(OpA _a, OpB _b) : a(std::move(_a)), b(std::move(_b)) {
+    if (a.shape().second != b.shape().first){ throw std::invalid_argument("Inner dimensions of the product must agree."); }
+  }
+
+  void matvec(const F* x, F* y) const {
+    const auto Bx = composite::Scratch< F >(b.shape().first);
+    b.matvec(x, Bx.data());
+    a.matvec(Bx.data(), y);
+  }
+
+  void matvec_add(const F* x, const F beta, F* y) const {
+    const auto Bx = composite::Scratch< F >(b.shape().first);
+    b.matvec(x, Bx.data());
+    composite::matvec_add(a, Bx.data(), beta, y);
+  }
+
+  // (A B)^T x = B^T (A^T x)
+  void rmatvec(const F* x, F* y) const requires (AdjointOperator< OpA > && AdjointOperator< OpB >) {
+    const auto ATx = composite::Scratch< F >(a.shape().second);
+    a.rmatvec(x, ATx.data());
+    b.rmatvec(ATx.data(), y);
+  }
+
+  void matmat(const F* X, F* Y, const size_t k) const {
+    const auto BX = composite::Scratch< F >(b.shape().first * k);
+    composite::matmat(b, X, BX.data(), k);
+    composite::matmat(a, BX.data(), Y, k);
+  }
+
+  auto shape() const -> std::pair< size_t, size_t > { return std::make_pair(a.shape().first, b.shape().second); }
+};
+
+// The (symmetric positive semi-definite) Gram operator A^T A of an operator A with adjoint products
+// Generalizes SparseEigenLinearOperator< F, true > to any operator; its adjoint action is its action.
+template< AdjointOperator Op >
+struct GramOp {
+  using value_type = typename Op::value_type;
+  using F = value_type;
+  const Op op;
+
+  GramOp(Op _op) : op(std::move(_op)) {}
+
+  void matvec(const F* x, F* y) const {
+    const auto Ax = composite::Scratch< F >(op.shape().first);
+    op.matvec(x, Ax.data());
+    op.rmatvec(Ax.data(), y);
+  }
+
+  void matvec_add(const F* x, const F beta, F* y) const {
+    const auto Ax = composite::Scratch< F >(op.shape().first);
+    op.matvec(x, Ax.data());
+    composite::rmatvec_add(op, Ax.data(), beta, y);
+  }
+
+  void rmatvec(const F* x, F* y) const { matvec(x, y); }
+
+  // A X is computed as one block product; the operators have no block adjoint products, so A^T is applied per column
+  void matmat(const F* X, F* Y, const size_t k) const {
+    const auto [m, n] = op.shape();
+    const auto AX = composite::Scratch< F >(m * k);
+    composite::matmat(op, X, AX.data(), k);
+    for (size_t j = 0; j < k; ++j){ op.rmatvec(AX.data() + j * m, Y + j * n); }
+  }
+
+  auto shape() const -> std::pair< size_t, size_t > {
+    return std::make_pair(op.shape().second, op.shape().second);
+  }
+};
+
+// Type-erased operator, for composing operators whose types are only known at runtime (e.g. from Python)
+// The composites above are instantiated once over AnyLinearOperator, which holds its operator behind a shared pointer,
+// such that copies are cheap and the composition tree - whose nodes are themselves type-erased - may be of any shape.
+// Adjoint products are only available if every operator in the tree supports them; see adjoint().
+template< std::floating_point F >
+struct AnyLinearOperator {
+  using value_type = F;
+
+  template< LinearOperator Op >
+  requires (std::same_as< typename Op::value_type, F > && !std::same_as< Op, AnyLinearOperator >)
+  explicit AnyLinearOperator(Op op) : impl(std::make_shared< Model< Op > >(std::move(op))) {}
+
+  void matvec(const F* x, F* y) const { impl->matvec(x, y); }
+  void matvec_add(const F* x, const F alpha, F* y) const { impl->matvec_add(x, alpha, y); }
+  void rmatvec(const F* x, F* y) const { impl->rmatvec(x, y); }
+  void rmatvec_add(const F* x, const F alpha, F* y) const { impl->rmatvec_add(x, alpha, y); }
+  void matmat(const F* X, F* Y, const size_t k) const { impl->matmat(X, Y, k); }
+  auto shape() const -> std::pair< size_t, size_t > { return impl->shape(); }
+  auto adjoint() const -> bool { return impl->adjoint(); }
+
+  private:
+  struct Concept {
+    virtual ~Concept() = default;
+    virtual void matvec(const F* x, F* y) const = 0;
+    virtual void matvec_add(const F* x, const F alpha, F* y) const = 0;
+    virtual void rmatvec(const F* x, F* y) const = 0;
+    virtual void rmatvec_add(const F* x, const F alpha, F* y) const = 0;
+    virtual void matmat(const F* X, F* Y, const size_t k) const = 0;
+    virtual auto shape() const -> std::pair< size_t, size_t > = 0;
+    virtual auto adjoint() const -> bool = 0;
+  };
+
+  template< LinearOperator Op >
+  struct Model final : Concept {
+    const Op op;
+    explicit Model(Op _op) : op(std::move(_op)) {}
+
+    void matvec(const F* x, F* y) const override { op.matvec(x, y); }
+    void matvec_add(const F* x, const F alpha, F* y) const override { composite::matvec_add(op, x, alpha, y); }
+    void matmat(const F* X, F* Y, const size_t k) const override { composite::matmat(op, X, Y, k); }
+    auto shape() const -> std::pair< size_t, size_t > override { return op.shape(); }
+
+    void rmatvec(const F* x, F* y) const override {
+      if constexpr (AdjointOperator< Op >){ op.rmatvec(x, y); } else { unsupported(); }
+    }
+
+    void rmatvec_add(const F* x, const F alpha, F* y) const override {
+      if constexpr (AdjointOperator< Op >){ composite::rmatvec_add(op, x, alpha, y); } else { unsupported(); }
+    }
+
+    auto adjoint() const -> bool override {
+      if constexpr (std::same_as< Op, AnyLinearOperator >){
+        return op.adjoint();
+      } else if constexpr (requires { op.op; }){
+        return adjoint_of(op.op);
+      } else if constexpr (requires { op.a; op.b; }){
+        return adjoint_of(op.a) && adjoint_of(op.b);
+      } else {
+        return AdjointOperator< Op >;
+      }
+    }
+
+    template< typename T >
+    static auto adjoint_of(const T& A) -> bool {
+      if constexpr (std::same_as< T, AnyLinearOperator >){ return A.adjoint(); } else { return AdjointOperator< T >; }
+    }
+
+    [[noreturn]] static void unsupported(){
+      throw std::invalid_argument("Operator does not support adjoint products.");
+    }
+  };
+
+  std::shared_ptr< const Concept > impl;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef _DIAGONAL_H
+#define _DIAGONAL_H
+
+#include <concepts>   // std::floating_point
+#include <cstdint>    // int64_t, uint32_t
+#include <vector>     // vector
+#include <exception>  // exception_ptr
+#include <atomic>     // atomic_bool
+#include <algorithm>  // min, max
+
+#include "lanczos.h"              // DenseMatrix, Array
+#include "random_generator.h"     // Distribution, generate_probe
+#include "trace.h"                // apply_columns, sketch_basis, generate_sketch, thread_copy, param_seed
+#include "omp_support.h"          // conditionally enables openmp pragmas
+
+// Streaming (Welford) accumulator of the elementwise mean and sum of squared deviations of n-dimensional samples,
+// alongside the elementwise sum of an auxiliary quantity (the squared probes, see diag_estimate).
+// The state is held by reference, such that it may live in caller-owned memory (e.g. NumPy arrays).
+template< std::floating_point F >
+struct DiagonalAccumulator {
+  int64_t& count;   // number of samples
+  F* mean;          // elementwise mean of the samples
+  F* m2;            // elementwise sum of squared deviations from the mean
+  F* denom;         // elementwise sum of the auxiliary quantity
+  const size_t n;
+
+  // Adds the sample x = u * v, elementwise, and accumulates v * v into the auxiliary sum
+  void update(const F* u, const F* v){
+    ++count;
+    const F c = F(count);
+    #pragma omp simd
+    for (size_t i = 0; i < n; ++i){
+      const F x = u[i] * v[i];
+      const F delta = x - mean[i];
+      mean[i] += delta / c;
+      m2[i] += delta * (x - mean[i]);
+      denom[i] += v[i] * v[i];
+    }
+  }
+
+  // Merges another accumulator into this one (Chan et al.'s pairwise update)
+  void merge(const DiagonalAccumulator& other){
+    if (other.count == 0){ return; }
+    const F na = F(count), nb = F(other.count), nab = na + nb;
+    #pragma omp simd
+    for (size_t i = 0; i < n; ++i){
+      const F delta = other.mean[i] - mean[i];
+      mean[i] += delta * (nb / nab);
+      m2[i] += other.m2[i] + delta * delta * (na * nb / nab);
+      denom[i] += other.denom[i];
+    }
+    count += other.count;
+  }
+};
+
+// Girard-Hutchinson estimates of diag(A) from nv isotropic probes v, streamed into the accumulator `acc`
+// Each probe contributes the sample u * v with u = A v (or f(A)v via the Lanczos method, for matrix functions), such that
+// the estimates count * mean / denom match those of `diagonal.diag`, while m2 / (count - 1) is the elementwise variance.
+// Probes are statically divided among threads, which each accumulate their partial sums into private storage that is
+// merged in thread order once all threads join. Probe i is the i-th probe of the counter-based generator keyed by `seed`
+// (stream 0, as in slq), such that the samples do not depend on the number of threads; only the rounding of the merge does.
+// Matrix functions are applied by thread-local copies; see apply_columns.
+template< std::floating_point F, LinearOperator Matrix >
+void diag_estimate(
+  const Matrix& A,                // Symmetric linear operator (or matrix function)
+  const int nv,                   // Number of probe vectors to sample
+  const Distribution dist,        // Isotropic distribution to sample probes from
+  const int64_t seed,             // Seed for the random number generators; negative values draw from std::random_device
+  const int num_threads,          // Number of threads to use; non-positive values use all available
+  DiagonalAccumulator< F >& acc   // Accumulator to merge the samples into
+){
+  const size_t n = A.shape().first;
+  const int nt = std::max(1, std::min(param_threads(num_threads), nv));
+  const uint64_t base_seed = uint64_t(param_seed(seed));
+  auto counts = std::vector< int64_t >(nt, 0);
+  auto partials = static_cast< DenseMatrix< F > >(DenseMatrix< F >::Zero(n, 3 * nt));
+  std::exception_ptr error = nullptr;
+  std::atomic_bool failed = false;
+
+  #pragma omp parallel num_threads(nt)
+  {
+    const auto tid = static_cast< uint32_t >(omp_get_thread_num());
+    auto v = static_cast< Vector< F > >(Vector< F >::Zero(n));
+    auto u = static_cast< Vector< F > >(Vector< F >::Zero(n));
+    auto partial = DiagonalAccumulator< F >{
+      counts[tid], partials.col(3 * tid).data(), partials.col(3 * tid + 1).data(), partials.col(3 * tid + 2).data(), n
+    };
+    const auto run = [&](const auto& op){
+      #pragma omp for schedule(static)
+      for (int i = 0; i < nv; ++i){
+        if (failed){ continue; }
+        try {
+          generate_probe< F >(dist, n, base_seed, 0, uint64_t(i), v.data());
+          if constexpr (QuadOperator< Matrix, F >){
+            op.matvec(v.data(), u.data()); // the products of matrix functions are timed by their own recurrence
+          } else {
+            PRIMATE_PHASE(matvec_phase);
+            op.matvec(v.data(), u.data());
+          }
+          partial.update(u.data(), v.data());
+        } catch (...) {
+          #pragma omp critical
+          { if (!failed){ error = std::current_exception(); failed = true; } }
+        }
+      }
+    };
+    if constexpr (QuadOperator< Matrix, F >){
+      if (nt > 1){ run(thread_copy(A)); } else { run(A); }
+    } else {
+      run(A);
+    }
+  }
+  if (error){ std::rethrow_exception(error); }
+  for (int t = 0; t < nt; ++t){
+    acc.merge(DiagonalAccumulator< F >{ counts[t], partials.col(3 * t).data(), partials.col(3 * t + 1).data(), partials.col(3 * t + 2).data(), n });
+  }
+}
+
+// Row-wise dot products diag(X Y^T) of two n x m matrices
+template< std::floating_point F >
+auto row_prod(const DenseMatrix< F >& X, const DenseMatrix< F >& Y) -> Array< F > {
+  return X.cwiseProduct(Y).rowwise().sum().array();
+}
+
+// XDiag estimate of diag(A) (Epperly, Tropp & Webber, 2024), based on Program SM4.3 of the same
+// Forms the basis Q R = A N of m isotropic sketch vectors N and writes the exchangeable estimate of diag(A) into `d`.
+template< std::floating_point F, LinearOperator Matrix >
+void xdiag(
+  const Matrix& A,                // Symmetric linear operator (or matrix function)
+  const int m,                    // Number of sketch vectors, at most the dimension of A
+  const Distribution dist,        // Isotropic distribution to sample the sketch from
+  const int64_t seed,             // Seed for the random number generators; negative values draw from std::random_device
+  const int num_threads,          // Number of threads to use; non-positive values use all available
+  F* d                            // Output estimate of the diagonal (n)
+){
+  const size_t n = A.shape().first;
+  if (m < 1 || size_t(m) > n){ throw std::invalid_argument("The number of sketch vectors must be between 1 and the dimension of the operator."); }
+  auto N = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, m));
+  auto Y = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, m));
+  generate_sketch< F >(dist, n, m, param_seed(seed), N.data());
+  apply_columns< F >(A, N.data(), Y.data(), m, num_threads);
+  auto R = DenseMatrix< F >();
+  const auto Q = sketch_basis< F >(Y, &R);
+  const Array< F > dNY = row_prod< F >(N, Y);
+  Y.resize(0, 0);
+
+  // Matrix quantities; S normalizes the columns of R^{-T} (see xtrace)
+  auto Z = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, m));
+  apply_columns< F >(A, Q.data(), Z.data(), m, num_threads);
+  const DenseMatrix< F > T = Z.transpose() * N;
+  const DenseMatrix< F > I = DenseMatrix< F >::Identity(m, m);
+  DenseMatrix< F > S = R.template triangularView< Eigen::Upper >().solve(I).transpose();
+  S.array().rowwise() /= S.colwise().norm().array();
+  const DenseMatrix< F > QS = Q * S;
+
+  // Vector quantities
+  const Array< F > dQZ = row_prod< F >(Q, Z);
+  const Array< F > dQSSZ = row_prod< F >(QS, Z * S);
+  const Array< F > dNTQ = row_prod< F >(N, Q * T);
+  const Array< F > dNQSST = row_prod< F >(N, QS * diag_prod< F >(S, T).matrix().asDiagonal());
+  Eigen::Map< Array< F > >(d, n) = dQZ + (-dQSSZ + dNY - dNTQ + dNQSST) / F(m);
+}
+
+#endif
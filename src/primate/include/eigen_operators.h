@@ -4,12 +4,18 @@
 // #include <pybind11/pybind11.h>
 // #include <pybind11/eigen.h>
 
+#include <concepts>   // std::floating_point
 #include <Eigen/SparseCore> // SparseMatrix, Matrix
-#include <chrono>
+#include <vector>     // vector
+#include <algorithm>  // lower_bound
+#include <utility>    // move
+#include <complex>    // complex
+#include <memory>     // shared_ptr
 
-using us = std::chrono::microseconds;
-using dur_seconds = std::chrono::duration< double >;
-using hr_clock = std::chrono::high_resolution_clock;
+#include <unsupported/Eigen/FFT> // FFT
+
+#include "omp_support.h" // conditionally enables openmp pragmas
+#include "lanczos.h"     // DenseMatrix, Vector
 
 // ## TODO: use CRTP to craft a set of template classes
 
@@ -18,31 +24,36 @@ template< std::floating_point F >
 struct DenseEigenLinearOperator {
   using value_type = F;
   const DenseMatrix< F > A;  
-  mutable size_t matvec_time; 
-  DenseEigenLinearOperator(const DenseMatrix< F > _mat) : A(_mat), matvec_time(0.0){}
+  DenseEigenLinearOperator(DenseMatrix< F > _mat) : A(std::move(_mat)){}
 
   void matvec(const F* inp, F* out) const noexcept {
-    auto ts = hr_clock::now();
     auto input = Eigen::Map< const Vector< F > >(inp, A.cols(), 1); // this should be a no-op
     auto output = Eigen::Map< Vector< F > >(out, A.rows(), 1); // this should be a no-op
-    output = A * input; 
-    matvec_time += duration_cast< us >(dur_seconds(hr_clock::now() - ts)).count();
+    output.noalias() = A * input; 
   }
 
   void rmatvec(const F* inp, F* out) const noexcept {
-    auto ts = hr_clock::now();
     auto input = Eigen::Map< const Vector< F > >(inp, A.rows(), 1); // this should be a no-op
     auto output = Eigen::Map< Vector< F > >(out, A.cols(), 1); // this should be a no-op
-    output = A.adjoint() * input; 
-    matvec_time += duration_cast< us >(dur_seconds(hr_clock::now() - ts)).count();
+    output.noalias() = A.adjoint() * input; 
+  }
+
+  void matvec_add(const F* inp, const F alpha, F* out) const noexcept {
+    auto input = Eigen::Map< const Vector< F > >(inp, A.cols(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.rows(), 1); // this should be a no-op
+    output.noalias() += alpha * (A * input); 
+  }
+
+  void rmatvec_add(const F* inp, const F alpha, F* out) const noexcept {
+    auto input = Eigen::Map< const Vector< F > >(inp, A.rows(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.cols(), 1); // this should be a no-op
+    output.noalias() += alpha * (A.adjoint() * input); 
   }
 
   void matmat(const F* X, F* Y, const size_t k) const noexcept {
-    auto ts = hr_clock::now();
     Eigen::Map< const DenseMatrix< F > > XM(X, A.cols(), k);
     Eigen::Map< DenseMatrix< F > > YM(Y, A.rows(), k);
-    YM = A * XM;
-    matvec_time += duration_cast< us >(dur_seconds(hr_clock::now() - ts)).count();
+    YM.noalias() = A * XM;
   }
 
   auto shape() const noexcept -> std::pair< size_t, size_t > {
@@ -54,30 +65,121 @@ struct DenseEigenLinearOperator {
   // }
 };
 
-// TODO: store only lower/upper part for symmetric? http://www.eigen.tuxfamily.org/dox/group__TutorialSparse.html
+// Zero-copy view of a dense, column-major matrix whose memory is owned elsewhere (e.g. by NumPy)
+// Copying the operator only copies the view, so it is cheap to construct for every call. The memory must outlive it.
+template< std::floating_point F >
+struct DenseEigenMapOperator {
+  using value_type = F;
+  using MapType = Eigen::Map< const DenseMatrix< F >, Eigen::Unaligned, Eigen::OuterStride<> >;
+  const MapType A;  
+
+  DenseEigenMapOperator(const F* data, const size_t rows, const size_t cols, const size_t outer_stride) 
+  : A(data, rows, cols, Eigen::OuterStride<>(outer_stride)) {}
+
+  void matvec(const F* inp, F* out) const noexcept {
+    auto input = Eigen::Map< const Vector< F > >(inp, A.cols(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.rows(), 1); // this should be a no-op
+    output.noalias() = A * input; 
+  }
+
+  void rmatvec(const F* inp, F* out) const noexcept {
+    auto input = Eigen::Map< const Vector< F > >(inp, A.rows(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.cols(), 1); // this should be a no-op
+    output.noalias() = A.adjoint() * input; 
+  }
+
+  void matvec_add(const F* inp, const F alpha, F* out) const noexcept {
+    auto input = Eigen::Map< const Vector< F > >(inp, A.cols(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.rows(), 1); // this should be a no-op
+    output.noalias() += alpha * (A * input); 
+  }
+
+  void rmatvec_add(const F* inp, const F alpha, F* out) const noexcept {
+    auto input = Eigen::Map< const Vector< F > >(inp, A.rows(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.cols(), 1); // this should be a no-op
+    output.noalias() += alpha * (A.adjoint() * input); 
+  }
+
+  void matmat(const F* X, F* Y, const size_t k) const noexcept {
+    Eigen::Map< const DenseMatrix< F > > XM(X, A.cols(), k);
+    Eigen::Map< DenseMatrix< F > > YM(Y, A.rows(), k);
+    YM.noalias() = A * XM;
+  }
+
+  auto shape() const noexcept -> std::pair< size_t, size_t > {
+    return std::make_pair((size_t) A.rows(), (size_t) A.cols());
+  }
+};
+
+// Zero-copy view of a compressed sparse column (CSC) matrix whose index / value arrays are owned elsewhere (e.g. by SciPy)
+// As with DenseEigenMapOperator, copies are cheap and the arrays must outlive the operator. Note the CSR arrays of a 
+// matrix are the CSC arrays of its transpose, so for symmetric matrices either format may be viewed.
+template< std::floating_point F >
+struct SparseEigenMapOperator {
+  using value_type = F;
+  using MapType = Eigen::Map< const Eigen::SparseMatrix< F, Eigen::ColMajor, int > >;
+  const MapType A;  
+
+  SparseEigenMapOperator(
+    const size_t rows, const size_t cols, const size_t nnz, 
+    const int* outer, const int* inner, const F* values
+  ) : A(rows, cols, nnz, outer, inner, values) {}
+
+  void matvec(const F* inp, F* out) const noexcept {
+    auto input = Eigen::Map< const Vector< F > >(inp, A.cols(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.rows(), 1); // this should be a no-op
+    output.noalias() = A * input; 
+  }
+
+  void rmatvec(const F* inp, F* out) const noexcept {
+    auto input = Eigen::Map< const Vector< F > >(inp, A.rows(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.cols(), 1); // this should be a no-op
+    output.noalias() = A.adjoint() * input; 
+  }
+
+  void matvec_add(const F* inp, const F alpha, F* out) const noexcept {
+    auto input = Eigen::Map< const Vector< F > >(inp, A.cols(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.rows(), 1); // this should be a no-op
+    output.noalias() += alpha * (A * input); 
+  }
+
+  void rmatvec_add(const F* inp, const F alpha, F* out) const noexcept {
+    auto input = Eigen::Map< const Vector< F > >(inp, A.rows(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.cols(), 1); // this should be a no-op
+    output.noalias() += alpha * (A.adjoint() * input); 
+  }
+
+  void matmat(const F* X, F* Y, const size_t k) const noexcept {
+    Eigen::Map< const DenseMatrix< F > > XM(X, A.cols(), k);
+    Eigen::Map< DenseMatrix< F > > YM(Y, A.rows(), k);
+    YM.noalias() = A * XM;
+  }
+
+  auto shape() const noexcept -> std::pair< size_t, size_t > {
+    return std::make_pair((size_t) A.rows(), (size_t) A.cols());
+  }
+};
+
+// See SymmetricSparseEigenLinearOperator for an operator storing only one triangle
 template< std::floating_point F, bool gram >
 struct SparseEigenLinearOperator {
   using value_type = F;
   const Eigen::SparseMatrix< F > A;  
-  mutable size_t matvec_time; 
 
-  SparseEigenLinearOperator(const Eigen::SparseMatrix< F > _mat) : A(_mat), matvec_time(0.0){}
+  SparseEigenLinearOperator(Eigen::SparseMatrix< F > _mat) : A(std::move(_mat)){}
 
   void matvec(const F* inp, F* out) const noexcept {
-    auto ts = hr_clock::now();
     auto input = Eigen::Map< const Eigen::Matrix< F, Eigen::Dynamic, 1 > >(inp, A.cols(), 1); // this should be a no-op
     if constexpr(gram){
       auto output = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >(out, A.cols(), 1); // this should be a no-op
       output = A.adjoint() * (A * input); 
     } else {
       auto output = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >(out, A.rows(), 1); // this should be a no-op
-      output = A * input; 
+      output.noalias() = A * input; 
     }
-    matvec_time += duration_cast< us >(dur_seconds(hr_clock::now() - ts)).count();
   }
 
   void rmatvec(const F* inp, F* out) const noexcept {
-    auto ts = hr_clock::now();
     if constexpr(gram){
       auto input = Eigen::Map< const Eigen::Matrix< F, Eigen::Dynamic, 1 > >(inp, A.cols(), 1); // this should be a no-op
       auto output = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >(out, A.cols(), 1); // this should be a no-op
@@ -85,17 +187,35 @@ struct SparseEigenLinearOperator {
     } else {
       auto input = Eigen::Map< const Eigen::Matrix< F, Eigen::Dynamic, 1 > >(inp, A.rows(), 1); // this should be a no-op
       auto output = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >(out, A.cols(), 1); // this should be a no-op
-      output = A.adjoint() * input; 
+      output.noalias() = A.adjoint() * input; 
+    }
+  }
+
+  void matvec_add(const F* inp, const F alpha, F* out) const {
+    auto input = Eigen::Map< const Eigen::Matrix< F, Eigen::Dynamic, 1 > >(inp, A.cols(), 1); // this should be a no-op
+    if constexpr(gram){
+      auto output = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >(out, A.cols(), 1); // this should be a no-op
+      output.noalias() += alpha * (A.adjoint() * (A * input)); 
+    } else {
+      auto output = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >(out, A.rows(), 1); // this should be a no-op
+      output.noalias() += alpha * (A * input); 
+    }
+  }
+
+  void rmatvec_add(const F* inp, const F alpha, F* out) const {
+    if constexpr(gram){
+      matvec_add(inp, alpha, out);
+    } else {
+      auto input = Eigen::Map< const Eigen::Matrix< F, Eigen::Dynamic, 1 > >(inp, A.rows(), 1); // this should be a no-op
+      auto output = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >(out, A.cols(), 1); // this should be a no-op
+      output.noalias() += alpha * (A.adjoint() * input); 
     }
-    matvec_time += duration_cast< us >(dur_seconds(hr_clock::now() - ts)).count();
   }
 
   void matmat(const F* X, F* Y, const size_t k) const noexcept {
-    auto ts = hr_clock::now();
     Eigen::Map< const DenseMatrix< F > > XM(X, A.cols(), k);
     Eigen::Map< DenseMatrix< F > > YM(Y, A.rows(), k);
-    YM = A * XM;
-    matvec_time += duration_cast< us >(dur_seconds(hr_clock::now() - ts)).count();
+    YM.noalias() = A * XM;
   }
 
   auto shape() const noexcept -> std::pair< size_t, size_t > {
@@ -103,6 +223,296 @@ struct SparseEigenLinearOperator {
   }
 };
 
+// Sparse operator of a symmetric matrix which stores only its upper triangle
+// Products go through Eigen's self-adjoint view, which applies each stored off-diagonal entry a_ij to both x_j and x_i
+// in the same pass. Relative to SparseEigenLinearOperator, this halves both the memory footprint and the bytes streamed 
+// per matvec. Only the upper triangle of the supplied matrix is read, so either A or its upper triangle may be given.
+// The triangle is shared by all copies of the operator, such that copying it, e.g. per call of a native routine on a
+// persistent handle, does not copy the matrix.
+// See: http://www.eigen.tuxfamily.org/dox/group__TutorialSparse.html
+template< std::floating_point F >
+struct SymmetricSparseEigenLinearOperator {
+  using value_type = F;
+  std::shared_ptr< const Eigen::SparseMatrix< F > > U_ptr; // upper triangle of A, including the diagonal
+  const Eigen::SparseMatrix< F >& U;
+
+  SymmetricSparseEigenLinearOperator(const Eigen::SparseMatrix< F >& _mat) 
+  : U_ptr(std::make_shared< const Eigen::SparseMatrix< F > >(_mat.template triangularView< Eigen::Upper >())), U(*U_ptr) {}
+
+  void matvec(const F* inp, F* out) const noexcept {
+    auto input = Eigen::Map< const Eigen::Matrix< F, Eigen::Dynamic, 1 > >(inp, U.cols(), 1); // this should be a no-op
+    auto output = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >(out, U.rows(), 1); // this should be a no-op
+    output.noalias() = U.template selfadjointView< Eigen::Upper >() * input; 
+  }
+
+  // A is symmetric, so the adjoint action is the action
+  void rmatvec(const F* inp, F* out) const noexcept {
+    matvec(inp, out);
+  }
+
+  // Eigen only scales self-adjoint products through a temporary, so the entries of U are applied directly
+  void matvec_add(const F* inp, const F alpha, F* out) const noexcept {
+    for (Eigen::Index j = 0; j < U.outerSize(); ++j){
+      const F xj = alpha * inp[j];
+      F acc = 0.0;
+      for (typename Eigen::SparseMatrix< F >::InnerIterator it(U, j); it; ++it){
+        const auto i = it.index();
+        out[i] += it.value() * xj;
+        if (i != j){ acc += it.value() * inp[i]; }
+      }
+      out[j] += alpha * acc;
+    }
+  }
+
+  void rmatvec_add(const F* inp, const F alpha, F* out) const noexcept {
+    matvec_add(inp, alpha, out);
+  }
+
+  void matmat(const F* X, F* Y, const size_t k) const noexcept {
+    Eigen::Map< const DenseMatrix< F > > XM(X, U.cols(), k);
+    Eigen::Map< DenseMatrix< F > > YM(Y, U.rows(), k);
+    YM.noalias() = U.template selfadjointView< Eigen::Upper >() * XM;
+  }
+
+  auto shape() const noexcept -> std::pair< size_t, size_t > {
+    return std::make_pair((size_t) U.rows(), (size_t) U.cols());
+  }
+};
+
+// Row-major (CSR) sparse operator whose products are computed in parallel over blocks of rows
+// The rows are split into one contiguous block per thread, each holding roughly the same number of non-zeros. Each row
+// product is a gather over the input, which is vectorized via `omp simd`. When called from within an active parallel 
+// region, e.g. by the probe-parallel trace estimators, products are instead computed by the calling thread alone.
+// As with the symmetric operator, the matrix is shared by all copies of the operator.
+template< std::floating_point F >
+struct CSREigenLinearOperator {
+  using value_type = F;
+  using CSRMatrix = Eigen::SparseMatrix< F, Eigen::RowMajor >;
+  std::shared_ptr< const CSRMatrix > A_ptr; // the (compressed) matrix, shared by all copies
+  const CSRMatrix& A;  
+  const int num_threads; 
+
+  CSREigenLinearOperator(CSRMatrix _mat, const int _num_threads = 0) 
+  : A_ptr(std::make_shared< const CSRMatrix >(compressed(std::move(_mat)))), A(*A_ptr), num_threads(param_threads(_num_threads)) {
+    // Partition the rows by their cumulative number of non-zeros
+    const auto outer = A.outerIndexPtr();
+    const auto nnz = A.nonZeros();
+    row_splits.resize(num_threads + 1, int(A.rows()));
+    row_splits[0] = 0;
+    for (int t = 1; t < num_threads; ++t){
+      const auto target = (nnz * t) / num_threads;
+      row_splits[t] = int(std::lower_bound(outer, outer + A.rows(), target) - outer);
+    }
+  }
+
+  void matvec(const F* inp, F* out) const noexcept {
+    spmv< false >(inp, F(1), out);
+  }
+
+  // Accumulates alpha * A x into the output in the same pass over the rows
+  void matvec_add(const F* inp, const F alpha, F* out) const noexcept {
+    spmv< true >(inp, alpha, out);
+  }
+
+  void rmatvec(const F* inp, F* out) const noexcept {
+    auto input = Eigen::Map< const Eigen::Matrix< F, Eigen::Dynamic, 1 > >(inp, A.rows(), 1); // this should be a no-op
+    auto output = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >(out, A.cols(), 1); // this should be a no-op
+    output.noalias() = A.adjoint() * input; 
+  }
+
+  void rmatvec_add(const F* inp, const F alpha, F* out) const noexcept {
+    auto input = Eigen::Map< const Eigen::Matrix< F, Eigen::Dynamic, 1 > >(inp, A.rows(), 1); // this should be a no-op
+    auto output = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >(out, A.cols(), 1); // this should be a no-op
+    output.noalias() += alpha * (A.adjoint() * input); 
+  }
+
+  // Streams each row once for all k columns of X
+  void matmat(const F* X, F* Y, const size_t k) const noexcept {
+    const int nt = omp_in_parallel() ? 1 : num_threads;
+    if (nt == 1){
+      spmm_rows(X, Y, k, 0, int(A.rows()));
+    } else {
+      #pragma omp parallel for num_threads(nt) schedule(static, 1)
+      for (int t = 0; t < num_threads; ++t){
+        spmm_rows(X, Y, k, row_splits[t], row_splits[t+1]);
+      }
+    }
+  }
+
+  auto shape() const noexcept -> std::pair< size_t, size_t > {
+    return std::make_pair((size_t) A.rows(), (size_t) A.cols());
+  }
+
+  private: 
+  std::vector< int > row_splits; // row_splits[t] is the first row of block t
+
+  static auto compressed(CSRMatrix M) -> CSRMatrix {
+    M.makeCompressed();
+    return M;
+  }
+
+  // y = A x, or y = y + alpha * A x if accumulating, split over the row blocks unless called from a parallel region
+  template< bool accumulate >
+  void spmv(const F* x, const F alpha, F* y) const noexcept {
+    const int nt = omp_in_parallel() ? 1 : num_threads;
+    if (nt == 1){
+      spmv_rows< accumulate >(x, alpha, y, 0, int(A.rows()));
+    } else {
+      #pragma omp parallel for num_threads(nt) schedule(static, 1)
+      for (int t = 0; t < num_threads; ++t){
+        spmv_rows< accumulate >(x, alpha, y, row_splits[t], row_splits[t+1]);
+      }
+    }
+  }
+
+  // y[r] = < A[r,:], x > (or y[r] += alpha * < A[r,:], x >) for all rows r in [r0, r1)
+  template< bool accumulate >
+  void spmv_rows(const F* x, const F alpha, F* y, const int r0, const int r1) const noexcept {
+    const auto outer = A.outerIndexPtr();
+    const auto inner = A.innerIndexPtr();
+    const auto values = A.valuePtr();
+    for (int r = r0; r < r1; ++r){
+      F acc = 0.0;
+      #pragma omp simd reduction(+:acc)
+      for (auto p = outer[r]; p < outer[r+1]; ++p){
+        acc += values[p] * x[inner[p]];
+      }
+      if constexpr (accumulate){ y[r] += alpha * acc; } else { y[r] = acc; }
+    }
+  }
+
+  // Y[r,:] = A[r,:] X for all rows r in [r0, r1), where X and Y are column-major
+  void spmm_rows(const F* X, F* Y, const size_t k, const int r0, const int r1) const noexcept {
+    const auto outer = A.outerIndexPtr();
+    const auto inner = A.innerIndexPtr();
+    const auto values = A.valuePtr();
+    const size_t n = A.cols(), m = A.rows();
+    for (int r = r0; r < r1; ++r){
+      for (size_t j = 0; j < k; ++j){
+        const F* x = X + j * n;
+        F acc = 0.0;
+        #pragma omp simd reduction(+:acc)
+        for (auto p = outer[r]; p < outer[r+1]; ++p){
+          acc += values[p] * x[inner[p]];
+        }
+        Y[j * m + r] = acc;
+      }
+    }
+  }
+};
+
+// Toeplitz operator T with first column c and first row r (r[0] = c[0]), whose products are computed via FFT
+// T is embedded in a circulant matrix C of size N >= 2n, whose first column is [c, 0, ..., 0, flip(r[1:])], such that 
+// T x is the first n entries of C [x; 0] = ifft(symbol * fft([x; 0])). N is the smallest multiple of 4 of the form 
+// 2^a 3^b 5^c, for which the real-to-complex transforms take their fastest (real, mixed-radix) path. The symbol, i.e. 
+// the half-spectrum of the first column of C scaled by 1/N, is computed once on construction.
+// Each (OS) thread applying a Toeplitz operator of type F uses its own thread_local FFT object (holding its plans and 
+// scratch) and padded buffers, which are allocated on the first product of that thread and re-used by every product 
+// after, of any operator of the same type. Products are thus safe from any number of threads, whether OpenMP threads or 
+// not (e.g. Python threads sharing an operator). Columns of matmat are transformed in parallel, unless called from a 
+// parallel region.
+template< std::floating_point F >
+struct ToeplitzLinearOperator {
+  using value_type = F;
+  using Complex = std::complex< F >;
+
+  ToeplitzLinearOperator(const F* c, const F* r, const size_t n) 
+  : plan(std::make_shared< Plan >()) {
+    plan->n = n;
+    plan->N = embedding_size(n);
+    const size_t N = plan->N;
+    auto d = std::vector< F >(N, F(0));
+    std::copy_n(c, n, d.begin());
+    for (size_t i = 1; i < n; ++i){ d[N - i] = r[i]; }
+    plan->symbol.resize(N / 2 + 1);
+    auto fft = Eigen::FFT< F >();
+    fft.SetFlag(Eigen::FFT< F >::HalfSpectrum);
+    fft.fwd(plan->symbol.data(), d.data(), N);
+    for (auto& s : plan->symbol){ s /= F(N); }
+  }
+
+  void matvec(const F* inp, F* out) const {
+    product< false >(inp, F(1), out);
+  }
+
+  // Accumulates alpha * T x from the padded output buffer, without a temporary
+  void matvec_add(const F* inp, const F alpha, F* out) const {
+    product< true >(inp, alpha, out);
+  }
+
+  void matmat(const F* X, F* Y, const size_t k) const {
+    const size_t n = plan->n;
+    if (k == 1 || omp_in_parallel()){
+      for (size_t j = 0; j < k; ++j){ matvec(X + j * n, Y + j * n); }
+    } else {
+      #pragma omp parallel for schedule(static)
+      for (size_t j = 0; j < k; ++j){ matvec(X + j * n, Y + j * n); }
+    }
+  }
+
+  auto shape() const noexcept -> std::pair< size_t, size_t > {
+    return std::make_pair(plan->n, plan->n);
+  }
+
+  // Size of the circulant embedding
+  auto embedding() const noexcept -> size_t { return plan->N; }
+
+  private: 
+  // Per-thread FFT plans and padded buffers
+  // The FFT object caches its plans per transform size, so a workspace may be shared by operators of different sizes.
+  struct Workspace {
+    Eigen::FFT< F > fft;
+    std::vector< F > z;        // zero-padded input / output (N)
+    std::vector< Complex > Z;  // half-spectrum (N / 2 + 1)
+    Workspace(){
+      fft.SetFlag(Eigen::FFT< F >::HalfSpectrum);
+      fft.SetFlag(Eigen::FFT< F >::Unscaled);
+    }
+  };
+
+  struct Plan {
+    size_t n = 0, N = 0;
+    std::vector< Complex > symbol;   // half-spectrum of the circulant, scaled by 1 / N
+  };
+  std::shared_ptr< Plan > plan; 
+
+  // Smallest multiple of 4 of the form 2^a 3^b 5^c that is at least 2n
+  static auto embedding_size(const size_t n) -> size_t {
+    const auto smooth = [](size_t m){ for (const size_t p : { 2, 3, 5 }){ while (m % p == 0){ m /= p; } } return m == 1; };
+    size_t m = std::max< size_t >((2 * n + 3) / 4, 1);
+    while (!smooth(m)){ ++m; }
+    return 4 * m;
+  }
+
+  template< bool accumulate >
+  void product(const F* x, const F alpha, F* y) const {
+    thread_local auto ws = Workspace();
+    apply< accumulate >(ws, x, alpha, y);
+  }
+
+  // y = T x, or y = y + alpha * T x if accumulating
+  template< bool accumulate >
+  void apply(Workspace& ws, const F* x, const F alpha, F* y) const {
+    const size_t n = plan->n, N = plan->N;
+    ws.z.resize(N);            // no-op in the steady state, and keeps the capacity across sizes
+    ws.Z.resize(N / 2 + 1);
+    std::copy_n(x, n, ws.z.begin());
+    std::fill(ws.z.begin() + n, ws.z.end(), F(0));
+    ws.fft.fwd(ws.Z.data(), ws.z.data(), N);
+    const Complex* s = plan->symbol.data();
+    for (size_t i = 0; i < ws.Z.size(); ++i){ ws.Z[i] *= s[i]; }
+    ws.fft.inv(ws.z.data(), ws.Z.data(), N);
+    if constexpr (accumulate){
+      for (size_t i = 0; i < n; ++i){ y[i] += alpha * ws.z[i]; }
+    } else {
+      std::copy_n(ws.z.begin(), n, y);
+    }
+  }
+};
+
+// Represents the affine operator A + tB of two sparse matrices for a parameter t set via set_parameter (see AffineOperator)
+// Products are fused as Ax + t(Bx), such that changing t never forms A + tB, i.e. sweeping t is free of any sparse algebra.
+// The parameter is shared by all copies of an operator in use, so it must not be changed while a product is in flight.
 template< std::floating_point F >
 struct SparseEigenAffineOperator {
   using value_type = F;
@@ -110,21 +520,31 @@ struct SparseEigenAffineOperator {
   const Eigen::SparseMatrix< F > A;  
   const Eigen::SparseMatrix< F > B;  
   mutable F _param; 
-  mutable size_t n_matvecs; 
 
   SparseEigenAffineOperator(
     const Eigen::SparseMatrix< F >& _A,
     const Eigen::SparseMatrix< F >& _B 
-  ) : A(_A), B(_B), n_matvecs(0) {
-    _param = 0.0f;
-  }
+  ) : A(_A), B(_B), _param(0.0) {}
 
-  // Uses Eigen basically as a no-overhead call to BLAS: https://eigen.tuxfamily.org/dox/group__TutorialMapClass.html
   void matvec(const F* inp, F* out) const noexcept {
-    auto input = Eigen::Map< const Eigen::Matrix< F, Eigen::Dynamic, 1 > >(inp, A.cols(), 1); // this should be a no-op
-    auto output = Eigen::Map< Eigen::Matrix< F, Eigen::Dynamic, 1 > >(out, A.rows(), 1);      // this should be a no-op
-    output = (A + _param * B) * input; // This is 100x faster than copying!
-    n_matvecs++;
+    auto input = Eigen::Map< const Vector< F > >(inp, A.cols(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.rows(), 1);      // this should be a no-op
+    output.noalias() = A * input;
+    if (_param != F(0.0)){ output.noalias() += _param * (B * input); }
+  }
+
+  void matvec_add(const F* inp, const F alpha, F* out) const noexcept {
+    auto input = Eigen::Map< const Vector< F > >(inp, A.cols(), 1); // this should be a no-op
+    auto output = Eigen::Map< Vector< F > >(out, A.rows(), 1);      // this should be a no-op
+    output.noalias() += alpha * (A * input);
+    if (_param != F(0.0)){ output.noalias() += (alpha * _param) * (B * input); }
+  }
+
+  void matmat(const F* X, F* Y, const size_t k) const noexcept {
+    Eigen::Map< const DenseMatrix< F > > XM(X, A.cols(), k);
+    Eigen::Map< DenseMatrix< F > > YM(Y, A.rows(), k);
+    YM.noalias() = A * XM;
+    if (_param != F(0.0)){ YM.noalias() += _param * (B * XM); }
   }
 
   auto shape() const noexcept -> std::pair< size_t, size_t > {
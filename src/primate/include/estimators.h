@@ -0,0 +1,98 @@
+#ifndef _ESTIMATORS_H
+#define _ESTIMATORS_H
+
+#include <concepts>   // std::floating_point
+#include <cstdint>    // int64_t
+#include <cmath>      // sqrt, abs
+#include <array>      // array
+#include <vector>     // vector
+#include <string>     // string
+#include <limits>     // numeric_limits
+#include <stdexcept>  // invalid_argument
+#include <algorithm>  // any_of
+
+// Streaming estimator of the mean and variance of scalar samples, mirroring `estimators.MeanEstimator(covariance=True)`
+// Batches are merged with the same (Chan et al.'s) update as `stats.Covariance`, and `delta` is the change of the mean
+// due to the last batch, such that the criteria below see the same quantities as their Python counterparts.
+struct MeanEstimator {
+  int64_t n = 0;                                         // number of samples
+  double mean = 0.0;                                     // sample mean
+  double m2 = 0.0;                                       // sum of squared deviations from the mean
+  double delta = std::numeric_limits< double >::infinity(); // change of the mean due to the last update
+
+  // Merges the batch of k samples x into the estimate
+  template< std::floating_point S >
+  void update(const S* x, const int k){
+    if (k <= 0){ return; }
+    double b_mean = 0.0, b_m2 = 0.0;
+    for (int i = 0; i < k; ++i){ b_mean += double(x[i]); }
+    b_mean /= double(k);
+    for (int i = 0; i < k; ++i){ const double d = double(x[i]) - b_mean; b_m2 += d * d; }
+    const double d = b_mean - mean;
+    const double n_new = double(n + k);
+    const double old_mean = mean;
+    mean += (double(k) / n_new) * d;
+    m2 += b_m2 + (double(n) * double(k) / n_new) * d * d;
+    delta = mean - old_mean;
+    n += k;
+  }
+
+  // Sample variance (ddof = 1), or infinity with fewer than two samples
+  auto variance() const -> double {
+    return n > 1 ? m2 / double(n - 1) : std::numeric_limits< double >::infinity();
+  }
+};
+
+// Stopping criteria of the native estimators, mirroring the criteria of `estimators`
+enum criterion_kind { count_criterion = 0, tolerance_criterion = 1, confidence_criterion = 2 };
+
+// Maps the names used by `estimators.CRITERIA` to a criterion
+inline auto parse_criterion(const std::string& name) -> criterion_kind {
+  if (name == "count"){ return count_criterion; }
+  if (name == "tolerance"){ return tolerance_criterion; }
+  if (name == "confidence"){ return confidence_criterion; }
+  throw std::invalid_argument("Invalid criterion '" + name + "' supplied; must be one of 'count', 'tolerance', or 'confidence'.");
+}
+
+// A single convergence test of a MeanEstimator; see `CountCriterion`, `ToleranceCriterion` and `ConfidenceCriterion`
+// The critical values of the confidence criterion (z and the first 30 t-scores) are supplied by the caller, such that they
+// match those computed by SciPy exactly.
+struct StoppingCriterion {
+  criterion_kind kind = count_criterion;
+  int64_t count = 0;                     // minimum number of samples (count)
+  double atol = 0.0;                     // absolute tolerance (tolerance, confidence)
+  double rtol = 0.0;                     // relative tolerance (tolerance, confidence)
+  double z = 0.0;                        // critical value of the normal distribution (confidence)
+  std::array< double, 30 > t_scores{};   // critical values of the t-distributions, by sample count (confidence)
+
+  // Margin of error and relative standard error of the estimate, as in `ConfidenceCriterion._error`
+  auto error(const MeanEstimator& est) const -> std::pair< double, double > {
+    constexpr double inf = std::numeric_limits< double >::infinity();
+    if (est.n < 3){ return { inf, inf }; }
+    const double std_error = std::sqrt(est.variance()) / std::sqrt(double(est.n));
+    const double rel_error = std::abs(std_error / est.mean);
+    const double score = est.n < 30 ? t_scores[est.n] : z;
+    return { score * std_error, rel_error };
+  }
+
+  auto operator()(const MeanEstimator& est) const -> bool {
+    switch (kind){
+      case count_criterion:
+        return est.n >= count;
+      case tolerance_criterion:
+        return std::abs(est.delta) < atol || std::abs(est.delta) < rtol * std::abs(est.mean);
+      case confidence_criterion: {
+        const auto [moe, rerr] = error(est);
+        return moe <= atol || rerr <= rtol;
+      }
+    }
+    return false;
+  }
+};
+
+// Whether any of the criteria is met, i.e. the disjunction `cc1 | cc2 | ...`
+inline auto any_met(const std::vector< StoppingCriterion >& criteria, const MeanEstimator& est) -> bool {
+  return std::any_of(criteria.begin(), criteria.end(), [&est](const auto& cc){ return cc(est); });
+}
+
+#endif
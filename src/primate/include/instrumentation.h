@@ -0,0 +1,134 @@
+#ifndef _INSTRUMENTATION_H
+#define _INSTRUMENTATION_H
+
+#include <cstdint>    // uint64_t
+#include <array>      // array
+#include <vector>     // vector
+#include <mutex>      // mutex, lock_guard
+#include <atomic>     // atomic
+#include <chrono>     // steady_clock
+#include <algorithm>  // find
+
+// Optional instrumentation of the native engines, compiled in by defining PRIMATE_INSTRUMENT, e.g. by building with
+//   pip install . -Csetup-args=-Dcpp_args=-DPRIMATE_INSTRUMENT
+// Each thread counts and times the phases below in its own counters, and PRIMATE_PHASE(p) scopes expand to nothing
+// otherwise. The phases are timed where the engines call into them, such that products of composite operators (or of
+// operators wrapping others, e.g. DeflatedOperator) are timed once.
+
+// Phases of the native engines timed by the instrumentation layer
+// matvec: products with the operator (a matmat of k columns counts as k); reorth: re-orthogonalization of the Lanczos
+// vectors; eigen: tridiagonal eigensolves; quad: quadrature rules (their weights, and f on their nodes); rng: probes.
+enum phase_kind { matvec_phase = 0, reorth_phase = 1, eigen_phase = 2, quad_phase = 3, rng_phase = 4 };
+constexpr int n_phases = 5;
+constexpr std::array< const char*, n_phases > phase_names = { "matvec", "reorth", "eigen", "quad", "rng" };
+
+// Event counts and elapsed nanoseconds of each phase
+struct PhaseStats {
+  std::array< uint64_t, n_phases > count{};
+  std::array< uint64_t, n_phases > ns{};
+  int threads = 0;  // number of threads that recorded any phase
+};
+
+#ifdef PRIMATE_INSTRUMENT
+constexpr bool instrumented = true;
+
+namespace instrument {
+
+// Counters of a single thread, which only that thread writes
+// The relaxed loads and stores compile to plain moves, but make reading the counters of a running thread well-defined.
+struct alignas(64) ThreadCounters {
+  std::array< std::atomic< uint64_t >, n_phases > count{};
+  std::array< std::atomic< uint64_t >, n_phases > ns{};
+
+  ThreadCounters();
+  ~ThreadCounters();
+
+  void add(const phase_kind p, const uint64_t events, const uint64_t elapsed) noexcept {
+    count[p].store(count[p].load(std::memory_order_relaxed) + events, std::memory_order_relaxed);
+    ns[p].store(ns[p].load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+  }
+};
+
+// Registry of the counters of the live threads; those of exited threads are folded into `retired`
+struct Registry {
+  std::mutex lock;
+  std::vector< const ThreadCounters* > live;
+  PhaseStats retired;
+};
+
+inline auto registry() -> Registry& {
+  static Registry r;
+  return r;
+}
+
+inline ThreadCounters::ThreadCounters(){
+  auto& r = registry();
+  const auto guard = std::lock_guard< std::mutex >(r.lock);
+  r.live.push_back(this);
+}
+
+inline ThreadCounters::~ThreadCounters(){
+  auto& r = registry();
+  const auto guard = std::lock_guard< std::mutex >(r.lock);
+  for (int p = 0; p < n_phases; ++p){
+    r.retired.count[p] += count[p].load(std::memory_order_relaxed);
+    r.retired.ns[p] += ns[p].load(std::memory_order_relaxed);
+  }
+  r.retired.threads += 1;
+  r.live.erase(std::find(r.live.begin(), r.live.end(), this));
+}
+
+// Counters of the calling thread, registered on first use
+inline auto local() -> ThreadCounters& {
+  thread_local ThreadCounters counters;
+  return counters;
+}
+
+// Times its scope as `events` events of phase p of the calling thread
+struct ScopedPhase {
+  const phase_kind p;
+  const uint64_t events;
+  const std::chrono::steady_clock::time_point t0;
+
+  explicit ScopedPhase(const phase_kind _p, const uint64_t _events = 1) noexcept
+  : p(_p), events(_events), t0(std::chrono::steady_clock::now()) {}
+
+  ~ScopedPhase(){
+    const auto elapsed = std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now() - t0);
+    local().add(p, events, uint64_t(elapsed.count()));
+  }
+};
+
+} // namespace instrument
+
+#define PRIMATE_CONCAT_(a, b) a##b
+#define PRIMATE_CONCAT(a, b) PRIMATE_CONCAT_(a, b)
+
+// Times the rest of the enclosing scope as phase `p`, optionally counting it as several events
+#define PRIMATE_PHASE(...) const instrument::ScopedPhase PRIMATE_CONCAT(primate_phase_, __LINE__)(__VA_ARGS__)
+#else
+constexpr bool instrumented = false;
+
+#define PRIMATE_PHASE(...) ((void)0)
+#endif
+
+// Sum of the counters of all threads that have recorded a phase, including those that have since exited
+// Always zero unless compiled with PRIMATE_INSTRUMENT.
+inline auto phase_totals() -> PhaseStats {
+  auto totals = PhaseStats();
+  #ifdef PRIMATE_INSTRUMENT
+  auto& r = instrument::registry();
+  const auto guard = std::lock_guard< std::mutex >(r.lock);
+  totals = r.retired;
+  for (const auto* c : r.live){
+    for (int p = 0; p < n_phases; ++p){
+      totals.count[p] += c->count[p].load(std::memory_order_relaxed);
+      totals.ns[p] += c->ns[p].load(std::memory_order_relaxed);
+    }
+  }
+  totals.threads += int(r.live.size());
+  #endif
+  return totals;
+}
+
+#endif
@@ -4,12 +4,22 @@
 #include <concepts> // std::floating_point
 #include <functional> // function
 #include <algorithm>  // max
+#include <cassert>    // assert
+#include <vector>     // vector
+#include <array>      // array
+#include <string>     // string
+#include <stdexcept>  // invalid_argument
+#include <limits>     // numeric_limits
+#include <memory>     // shared_ptr
 
 #include <Eigen/Eigenvalues>
 #include <Eigen/Core>
 
 #include "linear_operator.h" // LinearOperator
 #include "omp_support.h" // conditionally enables openmp pragmas
+#include "spectral_functions.h" // SpectralFunction
+#include "instrumentation.h" // PRIMATE_PHASE
+#include "tridiagonal.h" // jacobi_rules_block
 
 using Eigen::Dynamic; 
 using Eigen::Ref; 
@@ -35,12 +45,73 @@ constexpr inline auto mod(int a, int b) noexcept -> int {
   return (b + (a % b)) % b; 
 }
 
+// Inner product < x, y > accumulated in the scalar type S, which may be wider than that of the vectors (e.g. float -> double)
+// The casts are lazy expressions, so no temporaries are formed; when S matches the vectors' scalar type they are no-ops
+template< std::floating_point S, typename DerivedX, typename DerivedY >
+inline auto dot_as(const Eigen::MatrixBase< DerivedX >& x, const Eigen::MatrixBase< DerivedY >& y) -> S {
+  return x.template cast< S >().dot(y.template cast< S >());
+}
+
+// Fused level-1 kernels of the Lanczos step, each of which makes a single pass over its operands 
+// Between matvecs the recurrence is bandwidth-bound, so merging e.g. an axpy with the reduction that follows it halves
+// the bytes moved. Reductions are accumulated in S (see dot_as). Passes over at least `fused_parallel_min` entries 
+// are split across threads, unless already called from within a parallel region (e.g. by slq).
+constexpr size_t fused_parallel_min = size_t(1) << 17;
+
+// y <- y + a x, returning < z, y > of the updated y
+template< std::floating_point S, std::floating_point F >
+inline auto fused_axpy_dot(const size_t n, const F a, const F* x, F* y, const F* z) -> S {
+  S acc = 0;
+  [[maybe_unused]] const bool par = n >= fused_parallel_min && !omp_in_parallel();
+  #pragma omp parallel for simd reduction(+:acc) schedule(static) if(par)
+  for (size_t i = 0; i < n; ++i){
+    y[i] += a * x[i];
+    acc += S(z[i]) * S(y[i]);
+  }
+  return acc;
+}
+
+// y <- y + a x, returning < y, y > of the updated y
+template< std::floating_point S, std::floating_point F >
+inline auto fused_axpy_sqnorm(const size_t n, const F a, const F* x, F* y) -> S {
+  S acc = 0;
+  [[maybe_unused]] const bool par = n >= fused_parallel_min && !omp_in_parallel();
+  #pragma omp parallel for simd reduction(+:acc) schedule(static) if(par)
+  for (size_t i = 0; i < n; ++i){
+    y[i] += a * x[i];
+    acc += S(y[i]) * S(y[i]);
+  }
+  return acc;
+}
+
+// Returns (< x, x >, < x, y >) 
+template< std::floating_point S, std::floating_point F >
+inline auto fused_sqnorm_dot(const size_t n, const F* x, const F* y) -> std::pair< S, S > {
+  S xx = 0, xy = 0;
+  [[maybe_unused]] const bool par = n >= fused_parallel_min && !omp_in_parallel();
+  #pragma omp parallel for simd reduction(+:xx,xy) schedule(static) if(par)
+  for (size_t i = 0; i < n; ++i){
+    xx += S(x[i]) * S(x[i]);
+    xy += S(x[i]) * S(y[i]);
+  }
+  return { xx, xy };
+}
+
+// y <- a x
+template< std::floating_point F >
+inline void fused_scale(const size_t n, const F a, const F* x, F* y){
+  [[maybe_unused]] const bool par = n >= fused_parallel_min && !omp_in_parallel();
+  #pragma omp parallel for simd schedule(static) if(par)
+  for (size_t i = 0; i < n; ++i){ y[i] = a * x[i]; }
+}
+
 // Orthogonalizes v with respect to columns in U via modified gram schmidt
 // Cyclically projects v onto the columns U[:,i:(i+p)] = u_i, u_{i+1}, ..., u_{i+p}, removing from v the components 
 // of the vector projections. If any index i, ..., i+p exceeds the number of columns of U, the indices are cycled. 
 // Both near-zero projections and columns of U with near-zero norm are ignored to avoid collapsing v to the trivial vector.
+// The projections are accumulated in S, which may be wider than F (see dot_as).
 // Eigen::Ref use based on: https://stackoverflow.com/questions/21132538/correct-usage-of-the-eigenref-class
-template< std::floating_point F >
+template< std::floating_point F, std::floating_point S = F >
 void orth_vector(
   Ref< Vector< F > > v,                   // input/output vector
   const Ref< const DenseMatrix< F > >& U,    // matrix of vectors to project onto
@@ -56,16 +127,155 @@ void orth_vector(
   // If projection or the target vector is near-zero, ignore and continue, as numerical orthogonality is already met
   const int diff = reverse ? -1 : 1; 
   for (int i = mod(start_idx, m), c = 0; c < p; ++c, i = mod(i + diff, m)){
-    const auto u_norm = U.col(i).squaredNorm();      // norm of u_i
-    const auto s_proj = v.dot(U.col(i)); // < v, u_i > 
+    const auto [u_norm, s_proj] = fused_sqnorm_dot< S >(n, U.col(i).data(), v.data()); // (norm of u_i, < v, u_i >)
     // should protect against nan and 0 vectors, even is isnan(u_norm) is true
     if (u_norm > tol && std::abs(s_proj) > tol){ 
-      v -= (s_proj / u_norm) * U.col(i);
+      v -= F(s_proj / u_norm) * U.col(i);
     }
   }
 }
 
 
+// Orthogonalizes v against the p columns of Q ending at column c, taken cyclically backwards as in orth_vector, via
+// classical Gram-Schmidt applied twice ("twice is enough"). Each pass computes all p projections at once with GEMVs,
+// h = Q_w^T v and v -= Q_w h, as opposed to one column at a time. When the window wraps around the first column of 
+// Q, it is split into the contiguous blocks [0, c] and [ncv - (p - c - 1), ncv), each of which takes its own GEMVs.
+// The second pass is skipped if the first removed little of v, i.e. ||v'|| > ||v|| / sqrt(2) (the DGKS criterion), 
+// which is the common case for Lanczos vectors as the three-term recurrence already orthogonalizes them locally.
+// Unlike orth_vector, the columns of the window are assumed to have unit norm and the projections are computed in F.
+// Precondition: p <= Q.cols() and h holds at least p entries.
+template< std::floating_point F >
+void orth_block_cgs2(
+  Ref< Vector< F > > v,                     // input/output vector
+  const Ref< const DenseMatrix< F > >& Q,   // matrix of (orthonormal) vectors to project onto
+  const int c,                              // last column index of the window
+  const int p,                              // number of columns in the window
+  F* h                                      // workspace for the projection coefficients
+) {
+  const int m = (int) Q.cols();
+  const int p1 = std::min(p, c + 1);        // columns [c - p1 + 1, c]
+  const int p2 = p - p1;                    // wrapped columns [m - p2, m)
+  const auto Q1 = Q.middleCols(c - p1 + 1, p1);
+  const auto Q2 = Q.middleCols(m - p2, p2);
+  Eigen::Map< Vector< F > > h1(h, p1), h2(h + p1, p2);
+  for (int pass = 0; pass < 2; ++pass){
+    const F v_norm = v.norm();
+    h1.noalias() = Q1.transpose() * v;
+    if (p2 > 0){ h2.noalias() = Q2.transpose() * v; }
+    v.noalias() -= Q1 * h1;
+    if (p2 > 0){ v.noalias() -= Q2 * h2; }
+    if (v.norm() > v_norm * std::sqrt(F(0.5))){ break; }
+  }
+}
+
+// Methods of re-orthogonalizing each Lanczos vector against the previous orth vectors
+// The partial method re-orthogonalizes (with mgs) only at the steps where the estimated loss of orthogonality exceeds 
+// sqrt(eps); see OrthogonalityEstimate.
+enum orth_method { mgs = 0, cgs2 = 1, partial = 2 };
+
+inline auto parse_orth_method(const std::string& name) -> orth_method {
+  if (name == "mgs"){ return mgs; }
+  if (name == "cgs2"){ return cgs2; }
+  if (name == "partial" || name == "pro"){ return partial; }
+  throw std::invalid_argument("Invalid re-orthogonalization method '" + name + "' supplied; must be one of 'mgs', 'cgs2', or 'partial'.");
+}
+
+// Simon's ω-recurrence, which estimates the inner products ω_{j+1,k} ≈ < q_{j+1}, q_k > of each new Lanczos vector with
+// the previous ones from the entries of T alone, i.e. without touching the Lanczos vectors. Following Simon (1984), 
+// once max_k |ω_{j+1,k}| exceeds sqrt(eps), q_{j+1} is re-orthogonalized, as is q_{j+2} at the next step, since the 
+// three-term recurrence otherwise propagates the loss of orthogonality of q_j into q_{j+2}. 
+// Rounding errors in the recurrence itself are modeled by perturbing each estimate by eps1 = sqrt(n) eps / 2 away from 0.
+template< std::floating_point S >
+struct OrthogonalityEstimate {
+  Vector< S > w_prev, w_cur, w_next; // ω_{j-1,k}, ω_{j,k}, and ω_{j+1,k}
+  S eps;                             // unit roundoff of the Lanczos vectors
+  S eps1;                            // modeled local loss of orthogonality
+  S threshold;                       // semi-orthogonality level, past which q_{j+1} is re-orthogonalized
+  bool forced = false;               // whether the next step must be re-orthogonalized as well
+
+  // A non-positive degree allocates nothing, for recurrences which do not use the estimates
+  template< std::floating_point F >
+  OrthogonalityEstimate(const int deg, const size_t n, const F _eps) 
+  : w_prev(Vector< S >::Zero(deg > 0 ? deg + 1 : 0)), w_cur(Vector< S >::Zero(deg > 0 ? deg + 1 : 0)), 
+    w_next(Vector< S >::Zero(deg > 0 ? deg + 1 : 0)), eps(S(_eps)), threshold(std::sqrt(S(_eps))) {
+    restart(n);
+  }
+
+  // Number of Lanczos vectors whose loss of orthogonality may be tracked without re-allocating
+  auto capacity() const noexcept -> int { return std::max(int(w_cur.size()) - 1, 0); }
+
+  // Grows the capacity to deg Lanczos vectors, keeping the current estimates (e.g. to resume a recurrence)
+  void reserve(const int deg){
+    if (capacity() >= deg){ return; }
+    for (auto* w : { &w_prev, &w_cur, &w_next }){ w->conservativeResizeLike(Vector< S >::Zero(deg + 1)); }
+  }
+
+  // Resets the estimates for a new recurrence on an operator of dimension n, i.e. for j = 0
+  void restart(const size_t n){
+    eps1 = std::sqrt(S(n)) * eps / 2;
+    forced = false;
+    w_prev.setZero();
+    w_cur.setZero();
+    w_next.setZero();
+    if (w_cur.size() > 0){ w_cur[0] = 1; }
+  }
+
+  // Computes ω_{j+1,k} for k <= j from alpha[0..j] and beta[0..j+1], returning whether q_{j+1} should be re-orthogonalized
+  auto update(const int j, const S* alpha, const S* beta) -> bool {
+    S w_max = 0; 
+    for (int k = 0; k < j; ++k){
+      S t = beta[k+1] * w_cur[k+1] + (alpha[k] - alpha[j]) * w_cur[k] - beta[j] * w_prev[k];
+      t += k > 0 ? beta[k] * w_cur[k-1] : S(0);
+      w_next[k] = (t + (t >= 0 ? eps1 : -eps1)) / beta[j+1];
+      w_max = std::max(w_max, std::abs(w_next[k]));
+    }
+    w_next[j] = eps1;
+    w_next[j+1] = 1;
+    const bool reorth = forced || w_max > threshold;
+    forced = reorth && !forced;
+    return reorth;
+  }
+
+  // Records that q_{j+1} was re-orthogonalized against q_k for k in [k0, j]
+  void reset(const int k0, const int j){
+    for (int k = std::max(k0, 0); k <= j; ++k){ w_next[k] = eps1; }
+  }
+
+  // Shifts the estimates to the next step, i.e. j <- j + 1
+  void advance(){
+    std::swap(w_prev, w_cur);
+    std::swap(w_cur, w_next);
+  }
+};
+
+// Workspace used by the re-orthogonalization methods beyond the Lanczos vectors themselves, i.e. the projection 
+// coefficients of cgs2 and the ω-estimates of partial (one per recurrence). Reusing one across calls to the recurrences
+// avoids allocating these at the start of every call; they are only re-allocated if their capacity is insufficient.
+template< std::floating_point F, std::floating_point S = F >
+struct ReorthWorkspace {
+  Vector< F > h;                                    // projection coefficients of cgs2
+  std::vector< OrthogonalityEstimate< S > > omega;  // loss of orthogonality estimates of partial
+
+  // Ensures capacity for k recurrences of degree deg on an operator of dimension n, and restarts the ω-estimates 
+  void prepare(const orth_method reorth, const int orth, const int deg, const size_t n, const int k = 1){
+    if (reorth == cgs2 && h.size() < orth){ h.resize(orth); }
+    if (reorth == partial){
+      const F eps = std::numeric_limits< F >::epsilon();
+      if (int(omega.size()) < k || omega[0].capacity() < deg){ omega.assign(k, OrthogonalityEstimate< S >(deg, n, eps)); }
+      for (int i = 0; i < k; ++i){ omega[i].restart(n); }
+    }
+  }
+
+  // Ensures capacity for extending a single recurrence to degree deg, keeping the state of its ω-estimates
+  void extend(const orth_method reorth, const int orth, const int deg, const size_t n){
+    if (reorth == cgs2 && h.size() < orth){ h.resize(orth); }
+    if (reorth == partial){
+      if (omega.empty()){ prepare(reorth, orth, deg, n); }
+      omega[0].reserve(deg);
+    }
+  }
+};
+
 // Krylov dimension 'deg' should be at least 1 and at most dimension of the operator
 // Precondition: None
 constexpr int param_deg(const int deg, const std::pair< size_t, size_t > dim){
@@ -81,25 +291,54 @@ constexpr int param_ncv(const int ncv, const int deg, const std::pair< size_t, s
 // Orth should be strictly less than ncv, as there are only ncv Lanczos vectors in memory
 // If negative or larger than the Krylov dimension, orthogonalize against the maximal number of distinct Lanczos vectors 
 // Precondition: deg = param_deg(deg) and ncv = param_ncv(ncv)
-constexpr int param_orth(const int orth, const int deg, const int ncv, const std::pair< size_t, size_t > dim){
+constexpr int param_orth(const int orth, const int deg, const int ncv, const std::pair< size_t, size_t >){
   if (orth < 0 || orth > deg){ return std::min(deg, ncv - 1); }
   return std::min(orth, ncv - 1); // should only orthogonalize against in-memory Lanczos vectors
 } 
 
+// Callable receiving each Lanczos vector q_j as it is formed, e.g. to accumulate a linear combination of them on the fly
+template< std::floating_point F >
+using LanczosVisitor = std::function< void(const int, const F*) >;
+
+// State of a Lanczos recurrence after its last step, from which it may be resumed to extend T (see lanczos_recurrence)
+// The last two Lanczos vectors are the columns pos[0] and pos[1] of V, while the unnormalized residual beta_j q_j, 
+// which becomes the next Lanczos vector, is held by the input vector q. A default state starts a new recurrence.
+struct LanczosState {
+  std::array< int, 3 > pos = { 0, 0, 1 }; // cyclic indices of the previous, current, and next Lanczos vectors in V
+  int j = 0;                              // number of steps taken, i.e. the dimension of T
+  bool exhausted = false;                 // whether the Krylov space became (near) invariant, so no step remains
+};
+
 // Paige's A27 variant of the Lanczos method
 // Computes the first k elements (a,b) := (alpha,beta) of the tridiagonal matrix T(a,b) where T = Q^T A Q
+// The operator and the Lanczos vectors are stored in F, whereas (alpha, beta) and the inner products / norms forming 
+// them are accumulated in S. Mixed precision (F = float, S = double) halves the memory traffic of the basis while 
+// keeping the rounding error of the reductions at the level of double precision. 
+// Each new Lanczos vector is re-orthogonalized against the previous orth vectors either one at a time with modified 
+// Gram-Schmidt (mgs), or all at once with block classical Gram-Schmidt (cgs2), which is faster for large orth.
+// Partial re-orthogonalization (partial) applies mgs only at the steps where the ω-recurrence indicates it is needed.
+// If supplied, `visit(j, q_j)` is called on each of the (at most deg) Lanczos vectors once formed, which needn't be kept.
+// If `rw` is supplied, the re-orthogonalization workspace is taken from it rather than allocated for the call.
+// If `state` is supplied, the recurrence is resumed from it if it has taken any steps, extending T(alpha, beta) and V 
+// from step state->j up to deg, and the state after the last step is written back. The arguments must otherwise be those 
+// of the previous call, and q, V, alpha, beta (and rw) left untouched in between; alpha and beta must hold deg + 1 entries.
+// Resuming a recurrence from degree j to deg computes the same T as a single call of degree deg.
 // Precondition: orth < ncv <= deg and ncv >= 2.
-template< std::floating_point F, LinearOperator Matrix >
+template< std::floating_point F, LinearOperator Matrix, std::floating_point S = F >
 void lanczos_recurrence(
   const Matrix& A,            // Symmetric linear operator 
   F* q,                       // vector to expand the Krylov space K(A, q)
   const int deg,              // Dimension of the Krylov subspace to capture
   const F rtol,               // Tolerance of residual error for early-stopping the iteration.
   const int orth,             // Number of *additional* vectors to orthogonalize against 
-  F* alpha,                   // Output diagonal elements of T of size A.shape[1]+1
-  F* beta,                    // Output subdiagonal elements of T of size A.shape[1]+1; should be 0; 
+  S* alpha,                   // Output diagonal elements of T of size A.shape[1]+1
+  S* beta,                    // Output subdiagonal elements of T of size A.shape[1]+1; should be 0; 
   F* V,                       // Output matrix for Lanczos vectors (column-major)
-  const size_t ncv            // Number of Lanczos vectors pre-allocated (must be at least 2)
+  const size_t ncv,           // Number of Lanczos vectors pre-allocated (must be at least 2)
+  const orth_method reorth = mgs, // Method of re-orthogonalization
+  const LanczosVisitor< F >& visit = nullptr, // Optional callable receiving each Lanczos vector
+  ReorthWorkspace< F, S >* rw = nullptr, // Optional re-orthogonalization workspace
+  LanczosState* state = nullptr // Optional state to resume the recurrence from, and to save it to
 ){
   using VectorF = Eigen::Matrix< F, Dynamic, 1 >;
 
@@ -107,40 +346,190 @@ void lanczos_recurrence(
   const auto A_shape = A.shape();
   const size_t n = A_shape.first;
   const size_t m = A_shape.second;
-  const F residual_tol = std::sqrt(n) * rtol;
+  const S residual_tol = std::sqrt(n) * rtol;
 
   // Setup views
   Eigen::Map< DenseMatrix< F > > Q(V, n, ncv);                // Lanczos vectors 
   Eigen::Map< VectorF > v(q, m, 1);                           // map initial vector (no-op)
   const auto Q_ref = Eigen::Ref< const DenseMatrix< F > >(Q); // const view 
-
-  // Setup for first iteration
+  auto rw_local = ReorthWorkspace< F, S >();                  // allocates nothing unless it's used
+  auto& work = rw != nullptr ? *rw : rw_local;
+  const bool resume = state != nullptr && state->j > 0;
+  if (resume){ work.extend(reorth, orth, deg, n); } else { work.prepare(reorth, orth, deg, n); }
+  auto& h = work.h;                                           // projection coefficients for cgs2
+  auto* omega = reorth == partial ? &work.omega[0] : nullptr;  // ω-estimates for partial
+
+  // Setup for first iteration, or normalize the residual of the last one into the next Lanczos vector
   std::array< int, 3 > pos = { int(ncv) - 1, 0, 1 };          // Indices for the recurrence
-  Q.col(pos[0]) = static_cast< VectorF >(VectorF::Zero(n));   // Ensure previous is 0
-  Q.col(0) = v.normalized();                                  // Load unit-norm v as q0
-  beta[0] = 0.0;                                              // Ensure beta_0 is 0
+  const int j0 = resume ? state->j : 0;
+  if (!resume){
+    Q.col(pos[0]).setZero();                                  // Ensure previous is 0
+    Q.col(0) = v / F(std::sqrt(dot_as< S >(v, v)));          // Load unit-norm v as q0
+    beta[0] = 0.0;                                            // Ensure beta_0 is 0
+    if (visit){ visit(0, Q.col(0).data()); }
+  } else {
+    if (state->exhausted || j0 >= deg){ return; }
+    pos = state->pos;
+    fused_scale(m, F(F(1.0) / beta[j0]), v.data(), Q.col(pos[2]).data());
+    if (visit){ visit(j0, Q.col(pos[2]).data()); }
+    std::rotate(pos.begin(), pos.begin() + 1, pos.end());
+    pos[2] = mod(j0 + 1, ncv);
+  }
 
-  for (int j = 0; j < deg; ++j) {
+  for (int j = j0; j < deg; ++j) {
 
-    // Apply the three-term recurrence
+    // Apply the three-term recurrence, fusing each update of v with the reduction that follows it
     auto [p,c,n] = pos;                   // previous, current, next
-    A.matvec(Q.col(c).data(), v.data());  // v = A q_c
-    v -= beta[j] * Q.col(p);              // q_n = v - b q_p
-    alpha[j] = Q.col(c).dot(v);           // projection size of < qc, qn > 
-    v -= alpha[j] * Q.col(c);             // subtract projected components
+    {
+      PRIMATE_PHASE(matvec_phase);
+      A.matvec(Q.col(c).data(), v.data());  // v = A q_c
+    }
+    alpha[j] = fused_axpy_dot< S >(m, F(-beta[j]), Q.col(p).data(), v.data(), Q.col(c).data()); // q_n = v - b q_p, a = < qc, qn >
 
     // Re-orthogonalize q_n against previous orth lanczos vectors, up to ncv-1
-    if (orth > 0) {
+    // Only the j+1 vectors computed thus far are valid; the others may hold stale vectors from a previous call
+    if (orth > 0 && reorth != partial) {
+      PRIMATE_PHASE(reorth_phase);
+      v -= F(alpha[j]) * Q.col(c);        // subtract projected components
       auto qn = Eigen::Ref< Vector< F > >(v);          
-      orth_vector(qn, Q_ref, c, orth, true);
+      if (reorth == cgs2){
+        orth_block_cgs2< F >(qn, Q_ref, c, std::min(orth, j + 1), h.data());
+      } else {
+        orth_vector< F, S >(qn, Q_ref, c, std::min(orth, j + 1), true);
+      }
+      beta[j+1] = std::sqrt(dot_as< S >(v, v));
+    } else {
+      beta[j+1] = std::sqrt(fused_axpy_sqnorm< S >(m, F(-alpha[j]), Q.col(c).data(), v.data()));
+      if (orth > 0 && beta[j+1] > 0 && omega->update(j, alpha, beta)){
+        PRIMATE_PHASE(reorth_phase);
+        auto qn = Eigen::Ref< Vector< F > >(v);          
+        orth_vector< F, S >(qn, Q_ref, c, std::min(orth, j + 1), true);
+        omega->reset(j + 1 - std::min(orth, j + 1), j);
+        beta[j+1] = std::sqrt(dot_as< S >(v, v));
+      }
+      if (orth > 0){ omega->advance(); }
     }
 
     // Early-stop criterion is when K_j(A, v) is near invariant subspace.
-    beta[j+1] = v.norm();
     if (beta[j+1] < residual_tol || (j+1) == deg) { // additional break prevents overriding qn
+      const bool exhausted = beta[j+1] < residual_tol;
+      if (exhausted){ beta[j+1] = 0.0; }              // T ends here (see krylov_dim)
+      if (state != nullptr){ *state = LanczosState{ pos, j + 1, exhausted }; }
       break;
     }
-    Q.col(n) = v / beta[j+1]; // normalize such that Q stays orthonormal
+    fused_scale(m, F(F(1.0) / beta[j+1]), v.data(), Q.col(n).data()); // normalize such that Q stays orthonormal
+    if (visit){ visit(j + 1, Q.col(n).data()); }
+
+    // Cyclic left-rotate to update the working column indices
+    std::rotate(pos.begin(), pos.begin() + 1, pos.end());
+    pos[2] = mod(j+2, ncv);
+  }
+}
+
+// Batched variant of the recurrence above, which advances k independent Lanczos recurrences in lock-step
+// Each step applies A to all k current Lanczos vectors via a single matmat, if the operator supports it, such that 
+// the operator is streamed once per k vectors. Note this is *not* block Lanczos: each Krylov space K(A, q_i) is 
+// expanded (and re-orthogonalized) independently, and so each column computes the same T as lanczos_recurrence.
+// The Lanczos vectors are stored as ncv blocks of n x k columns, ordered such that the j-th vectors of all k 
+// recurrences are contiguous. Columns whose Krylov space is near-invariant stop updating their own (alpha, beta).
+// As above, (alpha, beta) and the reductions forming them are accumulated in S.
+// Precondition: orth < ncv <= deg and ncv >= 2.
+template< std::floating_point F, LinearOperator Matrix, std::floating_point S = F >
+void lanczos_recurrence_batch(
+  const Matrix& A,            // Symmetric linear operator 
+  F* q,                       // n x k matrix of vectors to expand the Krylov spaces K(A, q_i); overwritten (column-major)
+  const int k,                // Number of recurrences, i.e. columns of q
+  const int deg,              // Dimension of the Krylov subspace to capture
+  const F rtol,               // Tolerance of residual error for early-stopping the iteration.
+  const int orth,             // Number of *additional* vectors to orthogonalize against 
+  S* alpha,                   // Output diagonal elements of each T, as a (deg+1) x k matrix (column-major)
+  S* beta,                    // Output subdiagonal elements of each T, as a (deg+1) x k matrix (column-major)
+  F* V,                       // Output matrix of n x (ncv * k) Lanczos vectors (column-major)
+  const size_t ncv,           // Number of Lanczos vectors pre-allocated per recurrence (must be at least 2)
+  const orth_method reorth = mgs, // Method of re-orthogonalization
+  ReorthWorkspace< F, S >* rw = nullptr // Optional re-orthogonalization workspace
+){
+  using StridedMatrix = Eigen::Map< const DenseMatrix< F >, 0, Eigen::OuterStride<> >;
+
+  // Constants
+  const auto A_shape = A.shape();
+  const size_t n = A_shape.first;
+  const S residual_tol = std::sqrt(n) * rtol;
+
+  // Setup views
+  Eigen::Map< DenseMatrix< F > > Q(V, n, ncv * k);            // Lanczos vectors
+  Eigen::Map< DenseMatrix< F > > W(q, n, k);                  // map initial vectors (no-op)
+  Eigen::Map< DenseMatrix< S > > a(alpha, deg + 1, k);        // diagonals
+  Eigen::Map< DenseMatrix< S > > b(beta, deg + 1, k);         // subdiagonals
+  const auto q_idx = [k](const int j, const int i){ return j * k + i; }; // column of the j-th Lanczos vector of q_i
+  auto rw_local = ReorthWorkspace< F, S >();                             // allocates nothing unless it's used
+  auto& work = rw != nullptr ? *rw : rw_local;
+  work.prepare(reorth, orth, deg, n, k);
+  auto& h = work.h;                                                      // projection coefficients for cgs2
+  auto& omega = work.omega;                                              // loss of orthogonality of each recurrence
+
+  // Setup for first iteration
+  std::array< int, 3 > pos = { int(ncv) - 1, 0, 1 };          // Indices for the recurrence
+  Q.middleCols(pos[0] * k, k).setZero();                      // Ensure previous is 0
+  for (int i = 0; i < k; ++i){
+    Q.col(q_idx(0, i)) = W.col(i) / F(std::sqrt(dot_as< S >(W.col(i), W.col(i)))); // Load unit-norm q_i as the first vectors
+    b(0, i) = 0.0;                                            // Ensure beta_0 is 0
+  }
+  auto active = std::vector< bool >(k, true);
+  int n_active = k; 
+
+  for (int j = 0; j < deg && n_active > 0; ++j) {
+
+    // Apply the operator to every current Lanczos vector at once
+    auto [p,c,nx] = pos;                  // previous, current, next
+    if constexpr (SupportsMatrixMult< Matrix >){
+      PRIMATE_PHASE(matvec_phase, uint64_t(k));
+      A.matmat(Q.col(q_idx(c, 0)).data(), W.data(), k);
+    } else {
+      PRIMATE_PHASE(matvec_phase, uint64_t(k));
+      for (int i = 0; i < k; ++i){ A.matvec(Q.col(q_idx(c, i)).data(), W.col(i).data()); }
+    }
+
+    // Apply the three-term recurrence to each column separately
+    for (int i = 0; i < k; ++i){
+      if (!active[i]){ continue; }
+      auto v = W.col(i);
+      const auto qp = Q.col(q_idx(p, i)), qc = Q.col(q_idx(c, i));
+      a(j, i) = fused_axpy_dot< S >(n, F(-b(j, i)), qp.data(), v.data(), qc.data()); // q_n = v - b q_p, a = < qc, qn > 
+
+      // Re-orthogonalize q_n against the previous orth lanczos vectors of its own recurrence
+      const auto U = StridedMatrix(Q.col(i).data(), n, ncv, Eigen::OuterStride<>(n * k));
+      if (orth > 0 && reorth != partial) {
+        PRIMATE_PHASE(reorth_phase);
+        v -= F(a(j, i)) * qc;                 // subtract projected components
+        auto qn = Eigen::Ref< Vector< F > >(v);
+        if (reorth == cgs2){
+          orth_block_cgs2< F >(qn, U, c, std::min(orth, j + 1), h.data());
+        } else {
+          orth_vector< F, S >(qn, U, c, std::min(orth, j + 1), true);
+        }
+        b(j+1, i) = std::sqrt(dot_as< S >(v, v));
+      } else {
+        b(j+1, i) = std::sqrt(fused_axpy_sqnorm< S >(n, F(-a(j, i)), qc.data(), v.data()));
+        if (orth > 0 && b(j+1, i) > 0 && omega[i].update(j, a.col(i).data(), b.col(i).data())){
+          PRIMATE_PHASE(reorth_phase);
+          auto qn = Eigen::Ref< Vector< F > >(v);
+          orth_vector< F, S >(qn, U, c, std::min(orth, j + 1), true);
+          omega[i].reset(j + 1 - std::min(orth, j + 1), j);
+          b(j+1, i) = std::sqrt(dot_as< S >(v, v));
+        }
+        if (orth > 0){ omega[i].advance(); }
+      }
+
+      // Early-stop criterion is when K_j(A, q_i) is near invariant subspace.
+      if (b(j+1, i) < residual_tol || (j+1) == deg) { 
+        if (b(j+1, i) < residual_tol){ b(j+1, i) = 0.0; } // T ends here (see krylov_dim)
+        active[i] = false;
+        --n_active;
+        continue;
+      }
+      fused_scale(n, F(F(1.0) / b(j+1, i)), v.data(), Q.col(q_idx(nx, i)).data()); // normalize such that Q stays orthonormal
+    }
 
     // Cyclic left-rotate to update the working column indices
     std::rotate(pos.begin(), pos.begin() + 1, pos.end());
@@ -150,211 +539,376 @@ void lanczos_recurrence(
 
 enum weight_method { golub_welsch = 0, fttr = 1 };
 
+// Maps the names used by `integrate.quadrature` to a method of computing the quadrature weights
+inline auto parse_weight_method(const std::string& quad) -> weight_method {
+  if (quad == "gw" || quad == "golub_welsch"){ return golub_welsch; }
+  if (quad == "fttr"){ return fttr; }
+  throw std::invalid_argument("Invalid quadrature method '" + quad + "' supplied.");
+}
+
+// Number of leading rows of T(alpha, beta) before its first zero subdiagonal element, i.e. the dimension of the 
+// Krylov space if the Lanczos iteration terminated early. The trailing block of T carries no quadrature weight.
+template< std::floating_point F >
+constexpr int krylov_dim(const F* beta, const int k) noexcept {
+  for (int j = 1; j < k; ++j){ if (beta[j] == 0.0){ return j; } }
+  return k;
+}
+
+// Compacts the quadrature rule (nodes, weights) of size k onto its nodes of non-zero weight, which come first in order
+// If the Lanczos iteration terminated early, the trailing block of T carries no weight (see krylov_dim), but its nodes 
+// (e.g. zeros) may lie outside the domain of f, and f(x) * 0 is NaN for f(x) = 1/x at x = 0. The remaining entries are 
+// thus set to the last node of non-zero weight, with zero weight, such that f may be evaluated on all k nodes.
+// Returns the number of nodes of non-zero weight.
+template< std::floating_point F >
+int trim_rule(F* nodes, F* weights, const int k) noexcept {
+  int m = 0;
+  for (int j = 0; j < k; ++j){
+    if (weights[j] != F(0)){ nodes[m] = nodes[j]; weights[m] = weights[j]; ++m; }
+  }
+  const F last = m > 0 ? nodes[m - 1] : F(1);
+  std::fill(nodes + m, nodes + k, last);
+  std::fill(weights + m, weights + k, F(0));
+  return m;
+}
+
+// Forward three-term recurrence (FTTR) for the weights of the Gaussian quadrature rule of T(alpha, beta)
+// The weight of the node x is 1 / sum_j p_j(x)^2, where p_0 = 1, ..., p_{k-1} are the orthonormal polynomials generated 
+// by the recurrence encoded in T. Unlike Golub-Welsch, this needs no eigenvectors and only O(1) extra memory, though it 
+// is not backward stable. The recurrence is advanced on W nodes at once, which the compiler can keep in SIMD registers.
+// Based on: "Computing Gaussian quadrature rules with high relative accuracy", Laudadio et al. (2023). See also fttr.py.
+// Precondition: theta holds the k eigenvalues of T and beta[1], ..., beta[k-1] are non-zero.
+template< std::floating_point F, int W = 8 >
+void FTTR_weights(const F* theta, const F* alpha, const F* beta, const int k, F* weights) noexcept {
+  const auto ortho_poly = [=]< int B >(const F* x_ptr, F* w_ptr){
+    using ArrayB = Eigen::Array< F, B, 1 >;
+    const ArrayB x = Eigen::Map< const ArrayB >(x_ptr);
+    ArrayB z0 = ArrayB::Ones();
+    ArrayB z1 = (x - alpha[0]) / beta[1];   
+    ArrayB sq_sum = F(1.0) + z1.square();  
+    for (int j = 2; j < k; ++j){
+      const ArrayB z2 = ((x - alpha[j-1]) * z1 - beta[j-1] * z0) / beta[j];
+      sq_sum += z2.square();
+      z0 = z1;
+      z1 = z2;
+    }
+    auto w = Eigen::Map< ArrayB >(w_ptr);
+    w = sq_sum.inverse();
+  };
+  if (k == 1){ weights[0] = 1.0; return; }
+  int i = 0;
+  for (; i + W <= k; i += W){ ortho_poly.template operator()< W >(theta + i, weights + i); }
+  for (; i < k; ++i){ ortho_poly.template operator()< 1 >(theta + i, weights + i); }
+}
+
 // NOTE: one idea to reduce memory is to use the matching moment idea
 // - Take T - \lambda I for some eigenvalue \lambda; then dim(null(T- \lambda I)) = 1, thus 
 // - we can solve for (T - \lambda I)x = 0 for x repeatedly, for all \lambda, and take x[0] to be the quadrature weight
 
-// // FTTR 
-// // Uses the Lanczos method to obtain Gaussian quadrature estimates of the spectrum of an arbitrary operator
-// template< std::floating_point F >
-// auto lanczos_quadrature(
-//   const F* alpha,                           // Input diagonal elements of T of size k
-//   const F* beta,                            // Output subdiagonal elements of T of size k, whose non-zeros start at index 1
-//   const int k,                              // Size of input / output elements 
-//   AdjSolver< DenseMatrix< F > >& solver,    // Solver to use. Assumes workspace has been allocated
-//   F* nodes,                                 // Output nodes of the quadrature
-//   F* weights,                               // Output weights of the quadrature
-//   const weight_method method = golub_welsch  // The method of computing the weights 
-// ) -> void {
-//   using VectorF = Eigen::Array< F, Dynamic, 1>;
-//   assert(beta[0] == 0.0);
-  
-//   Eigen::Map< const VectorF > a(alpha, k);        // diagonal elements
-//   Eigen::Map< const VectorF > b(beta+1, k-1);     // subdiagonal elements (offset by 1!)
-
-//   // Golub-Welsch approach: just compute eigen-decomposition from T using QR steps
-//   if (method == golub_welsch){
-//     // std::cout << " GW ";
-//     solver.computeFromTridiagonal(a, b, Eigen::DecompositionOptions::ComputeEigenvectors);
-//     auto theta = static_cast< VectorF >(solver.eigenvalues()); // Rayleigh-Ritz values == nodes
-//     auto tau = static_cast< VectorF >(solver.eigenvectors().row(0));
-//     tau *= tau;
-//     std::copy(theta.begin(), theta.end(), nodes);
-//     std::copy(tau.begin(), tau.end(), weights);
-//   } else {
-//     // std::cout << " FTTR ";
-//   // Uses the Foward Three Term Recurrence (FTTR) approach 
-//     solver.computeFromTridiagonal(a, b, Eigen::DecompositionOptions::EigenvaluesOnly);
-//     auto theta = static_cast< VectorF >(solver.eigenvalues()); // Rayleigh-Ritz values == nodes
-//     std::copy(theta.begin(), theta.end(), nodes);
-
-//     // Compute weights via FTTR
-//     FTTR_weights(theta.data(), alpha, beta, k, weights);
-//   }
-// };
-
-// template< std::floating_point F, LinearOperator Matrix > 
-// struct MatrixFunction {
-//   // static const bool owning = false;
-//   using value_type = F;
-//   using VectorF = Eigen::Matrix< F, Dynamic, 1 >;
-//   using ArrayF = Eigen::Array< F, Dynamic, 1 >;
-//   using EigenSolver = Eigen::SelfAdjointEigenSolver< DenseMatrix< F > >; 
-
-//   // Use non-owning class here rather than copy-constructor to make parallizing easier
-//   // See: https://stackoverflow.com/questions/35770357/storing-const-reference-to-an-object-in-class
-//   // Also see: https://zpjiang.me/2020/01/20/const-reference-vs-pointer/
-//   const Matrix& op; 
-//   // const Matrix op; 
-
-//   // Fields
-//   // std::function< F(F) > f; 
-//   std::function< void(F*, const size_t) > f;
-//   bool native_f = false;
-//   const int deg;
-//   const int ncv; 
-//   F rtol; 
-//   int orth;
-//   weight_method wgt_method; 
-//   std::function< void(F*, const size_t) > transform;
-
-//   MatrixFunction(const Matrix& A, const std::function< void(F*, const size_t) > fun, int lanczos_degree, F lanczos_rtol, int _orth, int _ncv, bool native, weight_method _method = golub_welsch) 
-//   : op(A), f(fun), native_f(native),
-//     deg(param_deg(lanczos_degree, A.shape())), 
-//     ncv(param_ncv(_ncv, deg, A.shape())), 
-//     rtol(lanczos_rtol), 
-//     orth(param_orth(_orth, deg, ncv, A.shape())), 
-//     wgt_method(_method) 
-//   {
-//     // Pre-allocate all but Q memory needed for Lanczos iterations
-//     alpha = static_cast< ArrayF >(ArrayF::Zero(deg+1));
-//     beta = static_cast< ArrayF >(ArrayF::Zero(deg+1));
-//     nodes = static_cast< ArrayF >(ArrayF::Zero(deg));
-//     weights = static_cast< ArrayF >(ArrayF::Zero(deg));
-//     solver = EigenSolver(deg);
-//     transform = [](F* v, const size_t N){ return; };
-//   };
-
-//   MatrixFunction(Matrix&& A, const std::function< void(F*, const size_t) > fun, int lanczos_degree, F lanczos_rtol, int _orth, int _ncv, bool native, weight_method _method = golub_welsch) 
-//   : op(std::move(A)), f(fun), native_f(native),
-//     deg(param_deg(lanczos_degree, A.shape())), 
-//     ncv(param_ncv(_ncv, deg, A.shape())), 
-//     rtol(lanczos_rtol), 
-//     orth(param_orth(_orth, deg, ncv, A.shape())), 
-//     wgt_method(_method) {
-//     // Pre-allocate all but Q memory needed for Lanczos iterations
-//     alpha = static_cast< ArrayF >(ArrayF::Zero(deg+1));
-//     beta = static_cast< ArrayF >(ArrayF::Zero(deg+1));
-//     nodes = static_cast< ArrayF >(ArrayF::Zero(deg));
-//     weights = static_cast< ArrayF >(ArrayF::Zero(deg));
-//     solver = EigenSolver(deg);
-//     transform = [](F* v, const size_t N){ return; };
-//   };
+// Uses the Lanczos method to obtain Gaussian quadrature estimates of the spectrum of an arbitrary operator
+// The nodes are the Ritz values of T(alpha, beta). The weights are either the squared first components of its eigenvectors
+// (Golub-Welsch), or are computed from the nodes via the FTTR, which avoids forming the O(k^2) eigenvectors.
+// The solver takes its input by (plain) vector, so T is copied into `diag` and `subdiag` if supplied, which avoids 
+// allocating temporaries so long as their sizes match (i.e. barring early termination under the FTTR).
+template< std::floating_point F >
+void lanczos_quadrature(
+  const F* alpha,                           // Input diagonal elements of T of size k
+  const F* beta,                            // Input subdiagonal elements of T of size k, whose non-zeros start at index 1
+  const int k,                              // Size of input / output elements 
+  AdjSolver< DenseMatrix< F > >& solver,    // Solver to use. Assumes workspace has been allocated
+  F* nodes,                                 // Output nodes of the quadrature
+  F* weights,                               // Output weights of the quadrature
+  const weight_method method = golub_welsch, // Method to compute the weights with
+  Vector< F >* diag = nullptr,              // Optional storage for the diagonal of T
+  Vector< F >* subdiag = nullptr            // Optional storage for the subdiagonal of T
+) {
+  assert(beta[0] == 0.0);
+  auto diag_local = Vector< F >();
+  auto subdiag_local = Vector< F >();
+  auto& a = diag != nullptr ? *diag : diag_local;           // diagonal elements
+  auto& b = subdiag != nullptr ? *subdiag : subdiag_local;  // subdiagonal elements (offset by 1!)
+
+  if (method == golub_welsch){
+    // Golub-Welsch approach: just compute eigen-decomposition from T using QR steps
+    a = Eigen::Map< const Vector< F > >(alpha, k);
+    b = Eigen::Map< const Vector< F > >(beta+1, k-1);
+    {
+      PRIMATE_PHASE(eigen_phase);
+      solver.computeFromTridiagonal(a, b, Eigen::DecompositionOptions::ComputeEigenvectors);
+    }
+    PRIMATE_PHASE(quad_phase);
+    Eigen::Map< Array< F > >(nodes, k) = solver.eigenvalues().array();  // Rayleigh-Ritz values == nodes
+    Eigen::Map< Array< F > >(weights, k) = solver.eigenvectors().row(0).transpose().array().square();
+    if (krylov_dim(beta, k) < k){ trim_rule(nodes, weights, k); }
+  } else {
+    // FTTR approach: the recurrence requires a non-zero subdiagonal, so restrict to the leading block of T
+    const int m = krylov_dim(beta, k);
+    a = Eigen::Map< const Vector< F > >(alpha, m);
+    b = Eigen::Map< const Vector< F > >(beta+1, m-1);
+    {
+      PRIMATE_PHASE(eigen_phase);
+      solver.computeFromTridiagonal(a, b, Eigen::DecompositionOptions::EigenvaluesOnly);
+    }
+    PRIMATE_PHASE(quad_phase);
+    Eigen::Map< Array< F > >(nodes, m) = solver.eigenvalues().array();
+    FTTR_weights< F >(nodes, alpha, beta, m, weights);
+    std::fill(weights + m, weights + k, F(0.0));
+    trim_rule(nodes, weights, k);
+  }
+}
+
+// Reusable storage for stochastic Lanczos quadrature over blocks of k probes: the probes, their Lanczos vectors, the 
+// tridiagonals, their quadrature rules, and the workspace of the eigensolvers and of the re-orthogonalization methods.
+// The rules of the k probes of a block are stored contiguously, those of probe c starting at entry c * deg.
+// prepare() only re-allocates when the requested sizes differ from the current ones, such that a steady-state probe 
+// loop performs no heap allocations. Newly allocated storage is zeroed, as the recurrences may read stale vectors.
+template< std::floating_point F, std::floating_point S = F >
+struct LanczosWorkspace {
+  DenseMatrix< F > q;                   // n x k probe vectors
+  DenseMatrix< F > Q;                   // n x (ncv * k) Lanczos vectors
+  DenseMatrix< S > alpha;               // (deg + 1) x k diagonals of each T
+  DenseMatrix< S > beta;                // (deg + 1) x k subdiagonals of each T
+  Array< S > sq_norms;                  // squared norms of the probes
+  Array< S > nodes;                     // nodes of the quadrature rules (deg * k)
+  Array< S > weights;                   // weights of the quadrature rules (deg * k)
+  Vector< S > diag;                     // copy of the diagonal of T, for the solver
+  Vector< S > subdiag;                  // copy of the subdiagonal of T, for the solver
+  AdjSolver< DenseMatrix< S > > solver; // tridiagonal eigensolver, pre-allocated for degree solver_deg
+  Vector< S > jacobi_work;              // workspace of the batched Golub-Welsch solver (see jacobi_rules_block)
+  ReorthWorkspace< F, S > rw;           // workspace of the re-orthogonalization methods
+  int solver_deg = 0;
+  std::vector< AdjSolver< DenseMatrix< S > > > check_solvers; // eigensolvers of the intermediate degrees (see prepare_checks)
+  std::vector< Vector< S > > check_diags, check_subdiags;     // copies of T at the intermediate degrees
+  std::vector< int > check_degs;                              // degree of each intermediate solver
+
+  void prepare(const size_t n, const int deg, const int ncv, const int k = 1, const orth_method reorth = mgs, const int orth = 0){
+    const auto fit = [](auto& M, const Eigen::Index rows, const Eigen::Index cols){
+      if (M.rows() != rows || M.cols() != cols){ M.setZero(rows, cols); }
+    };
+    fit(q, n, k);
+    fit(Q, n, ncv * k);
+    fit(alpha, deg + 1, k);
+    fit(beta, deg + 1, k);
+    fit(sq_norms, k, 1);
+    fit(nodes, deg * k, 1);
+    fit(weights, deg * k, 1);
+    fit(jacobi_work, jacobi_work_size(deg), 1);
+    fit(diag, deg, 1);
+    fit(subdiag, deg - 1, 1);
+    if (solver_deg != deg){ solver = AdjSolver< DenseMatrix< S > >(deg); solver_deg = deg; }
+    rw.prepare(reorth, orth, deg, n, k);
+  }
+
+  // Pre-allocates a solver and copies of T for each of the n_checks degrees check_deg(0), ..., check_deg(n_checks - 1)
+  // at which slq_trace_adaptive evaluates the quadrature; only the solvers whose degree changed are re-allocated.
+  template< typename DegreeFn >
+  void prepare_checks(const int n_checks, const DegreeFn& check_deg){
+    if (int(check_solvers.size()) != n_checks){
+      check_solvers.resize(n_checks);
+      check_diags.resize(n_checks);
+      check_subdiags.resize(n_checks);
+      check_degs.resize(n_checks, 0);
+    }
+    for (int c = 0; c < n_checks; ++c){
+      const int dc = check_deg(c);
+      if (check_degs[c] == dc){ continue; }
+      check_solvers[c] = AdjSolver< DenseMatrix< S > >(dc);
+      check_diags[c].setZero(dc);
+      check_subdiags[c].setZero(dc - 1);
+      check_degs[c] = dc;
+    }
+  }
+};
+
+// Pool of per-thread workspaces, grown on demand by slq to the number of threads it launches
+template< std::floating_point F, std::floating_point S = F >
+struct LanczosArena {
+  std::vector< LanczosWorkspace< F, S > > workspaces; // one per thread
+};
+
+// Represents the matrix function f(A) = U f(Λ) U^T of a symmetric operator A = U Λ U^T
+// The actions v |-> f(A)v and v |-> v^T f(A) v are approximated by a fixed-degree Lanczos expansion of K(A, v). 
+// All workspace is pre-allocated on construction (except the full basis needed by matvec, which is allocated on first 
+// use), such that repeated calls to matvec() and quad() perform no heap allocations. As a consequence, a single instance
+// is not safe to use from multiple threads concurrently.
+// The n x deg basis of matvec() may instead be supplied as external storage (e.g. a memory-mapped file), or avoided 
+// entirely with `two_pass`, which re-runs the recurrence to accumulate f(A)v from each Lanczos vector as it is formed. 
+// The latter needs only the ncv vectors of quad(), at the cost of a second round of deg matvecs.
+template< std::floating_point F, LinearOperator Matrix > 
+struct MatrixFunction {
+  using value_type = F;
+  using VectorF = Eigen::Matrix< F, Dynamic, 1 >;
+  using ArrayF = Eigen::Array< F, Dynamic, 1 >;
+  using EigenSolver = Eigen::SelfAdjointEigenSolver< DenseMatrix< F > >; 
+
+  // Fields
+  std::shared_ptr< const Matrix > op_ptr; // the operator, shared by all copies (see thread_copy)
+  const Matrix& op; 
+  SpectralFunction< F > f;
+  const int deg;
+  const int ncv; 
+  F rtol; 
+  int orth;
+  weight_method method = golub_welsch; // method used by quad() to compute the quadrature weights
+  orth_method reorth = mgs;             // method used to re-orthogonalize the Lanczos vectors
+  bool two_pass = false;                // whether matvec() re-computes the Lanczos vectors rather than storing them
+  F* basis = nullptr;                   // external n x deg (column-major) storage for the basis of matvec(), if non-null
+  std::function< void(F*, const size_t) > transform;
+
+  MatrixFunction(Matrix A, SpectralFunction< F > fun, int lanczos_degree, F lanczos_rtol, int _orth, int _ncv) 
+  : op_ptr(std::make_shared< const Matrix >(std::move(A))), op(*op_ptr), f(std::move(fun)),
+    deg(param_deg(lanczos_degree, op.shape())), 
+    ncv(param_ncv(_ncv, deg, op.shape())), 
+    rtol(lanczos_rtol), 
+    orth(_orth)
+  {
+    // Pre-allocate all but the Q memory needed by matvec for Lanczos iterations
+    const size_t n = op.shape().first; 
+    Q = static_cast< DenseMatrix< F > >(DenseMatrix< F >::Zero(n, ncv));
+    v_copy = static_cast< VectorF >(VectorF::Zero(n));
+    alpha = static_cast< ArrayF >(ArrayF::Zero(deg+1));
+    beta = static_cast< ArrayF >(ArrayF::Zero(deg+1));
+    nodes = static_cast< ArrayF >(ArrayF::Zero(deg));
+    weights = static_cast< ArrayF >(ArrayF::Zero(deg));
+    diag = static_cast< VectorF >(VectorF::Zero(deg));
+    subdiag = static_cast< VectorF >(VectorF::Zero(deg-1));
+    coeffs = static_cast< VectorF >(VectorF::Zero(deg));
+    solver = EigenSolver(deg);
+    transform = [](F*, const size_t){ return; };
+  };
  
-//   // Approximates v |-> f(A)v via a limited degree Lanczos iteration
-//   void matvec(const F* v, F* y) const noexcept {
-//     // if (op == nullptr){ return; }
-
-//     // By default, Q is not allocated in constructor, as quad may used less memory
-//     // For all calls after the first matvec(), Eigen promises this is a no-op
-//     // Note we *need* Q to have exactly deg columns for the matvec approx
-//     if (Q.cols() < deg){ Q.resize(op.shape().first, deg); }
+  // Approximates v |-> f(A)v via a limited degree Lanczos iteration
+  void matvec(const F* v, F* y) const {
+    // By default, Q is not allocated in constructor, as quad may used less memory
+    // For all calls after the first matvec(), this is a no-op
+    // Note we *need* exactly deg Lanczos vectors for the matvec approx, unless they are re-computed
+    const size_t n = op.shape().first;
+    if (!two_pass && basis == nullptr && Q.cols() < deg){ Q = static_cast< DenseMatrix< F > >(DenseMatrix< F >::Zero(n, deg)); }
+    F* const Q_ptr = two_pass || basis == nullptr ? Q.data() : basis;
+    const int n_cols = two_pass ? ncv : deg;
   
-//     // Inputs / outputs 
-//     Eigen::Map< const VectorF > v_map(v, op.shape().second);
-//     Eigen::Map< VectorF > y_map(y, op.shape().first);
+    // Inputs / outputs 
+    Eigen::Map< const VectorF > v_map(v, op.shape().second);
+    Eigen::Map< VectorF > y_map(y, n);
     
-//     // Lanczos iteration: save v norm 
-//     VectorF v_copy = v_map;                // save copy of input 
-//     transform(v_copy.data(), v_copy.size()); // transform it, if necessary
-//     const F v_scale = v_copy.norm();        // save its norm
-
-//     // Apply Lanczos
-//     lanczos_recurrence< F >(op, v_copy.data(), deg, rtol, orth, alpha.data(), beta.data(), Q.data(), deg); 
-    
-//     // Note: Maps are used here to offset the pointers; they should be no-ops anyways
-//     Eigen::Map< ArrayF > a(alpha.data(), deg);      // diagonal elements
-//     Eigen::Map< ArrayF > b(beta.data()+1, deg-1);   // subdiagonal elements (offset by 1!)
-//     solver.computeFromTridiagonal(a, b, Eigen::DecompositionOptions::ComputeEigenvectors);
-
-//     // Apply the spectral function (in-place) to Rayleigh-Ritz values (nodes)
-//     auto theta = static_cast< ArrayF >(solver.eigenvalues());
-//     // theta.unaryExpr(f); // this doesn't always work for some reason
-//     // std::transform(theta.begin(), theta.end(), theta.begin(), f);
-//     f(theta.data(), theta.size());
+    // Lanczos iteration: save v norm 
+    v_copy = v_map;                           // save copy of input 
+    transform(v_copy.data(), v_copy.size());  // transform it, if necessary
+    const F v_scale = v_copy.norm();          // save its norm
+
+    // Apply Lanczos
+    alpha.setZero();
+    beta.setZero();
+    const int k_orth = param_orth(orth, deg, n_cols, op.shape());
+    lanczos_recurrence< F >(op, v_copy.data(), deg, rtol, k_orth, alpha.data(), beta.data(), Q_ptr, n_cols, reorth, nullptr, &rw); 
+    tridiagonal_eigen(Eigen::DecompositionOptions::ComputeEigenvectors);
+
+    // Apply the spectral function (in-place) to Rayleigh-Ritz values (nodes)
+    nodes = solver.eigenvalues().array();
+    f(nodes.data(), deg);
     
-//     // The approximation v |-> f(A)v 
-//     const auto V = static_cast< DenseMatrix< F > >(solver.eigenvectors()); // maybe dont cast here 
-//     auto v_mod = static_cast< ArrayF >(V.row(0).array());
-//     v_mod *= theta;
-//     y_map = Q * static_cast< VectorF >(V * v_mod.matrix()); // equivalent to Q V diag(sf(theta)) V^T e_1
-//     y_map.array() *= v_scale; // re-scale
-//   }   
-
-//   void matmat(const F* X, F* Y, const size_t k) const noexcept {
-//     // if (op == nullptr){ return; }
-//     Eigen::Map< const DenseMatrix< F > > XM(X, op.shape().second, k);
-//     Eigen::Map< DenseMatrix< F > > YM(Y, op.shape().first, k);
-//     for (size_t j = 0; j < k; ++j){
-//       matvec(XM.col(j).data(), YM.col(j).data());
-//     }
-//   }
-
-//   // Approximates v^T A v
-//   auto quad(const F* v) const noexcept -> F {
-//     // if (op == nullptr){ return; }
-
-//     // Only allocate NCV columns as necessary -- no-op after first resizing
-//     if (Q.cols() < ncv){ Q.resize(op.shape().first, ncv); }
-
-//     // Save copy of v + its norm 
-//     Eigen::Map< const VectorF > v_map(v, op.shape().second); // no-op 
-//     VectorF v_copy = v_map;                  // save copy; needs to be norm-1 for Lanczos + quad to work
-//     transform(v_copy.data(), v_copy.size()); // transform as needed
-//     const F v_scale = v_copy.norm(); 
-//     v_copy.normalize();
-
-//     // Execute lanczos method + Golub-Welsch algorithm
-//     lanczos_recurrence< F >(op, v_copy.data(), deg, rtol, orth, alpha.data(), beta.data(), Q.data(), ncv);   
-//     lanczos_quadrature< F >(alpha.data(), beta.data(), deg, solver, nodes.data(), weights.data(), wgt_method);
+    // The approximation v |-> f(A)v; equivalent to |v| Q V diag(f(theta)) V^T e_1
+    const auto& V = solver.eigenvectors(); 
+    weights = V.row(0).transpose().array() * nodes;               // diag(f(theta)) V^T e_1 
+    if (krylov_dim(beta.data(), deg) < deg){                      // the trailing block of T is not in its span
+      weights = (V.row(0).transpose().array() == F(0)).select(F(0), weights);
+    }
+    coeffs.noalias() = V * weights.matrix();
+    if (two_pass){
+      // The recurrence is deterministic, so re-running it from v reproduces the same Lanczos vectors
+      v_copy = v_map;
+      transform(v_copy.data(), v_copy.size());
+      y_map.setZero();
+      const auto accumulate = [this, &y_map](const int j, const F* q){ // small enough to not allocate as a std::function
+        y_map += coeffs[j] * Eigen::Map< const VectorF >(q, y_map.size()); 
+      };
+      lanczos_recurrence< F >(op, v_copy.data(), deg, rtol, k_orth, alpha.data(), beta.data(), Q_ptr, n_cols, reorth, accumulate, &rw);
+    } else {
+      y_map.noalias() = Eigen::Map< const DenseMatrix< F > >(Q_ptr, n, deg) * coeffs;
+    }
+    y_map *= v_scale; // re-scale
+  }   
+
+  void matmat(const F* X, F* Y, const size_t k) const {
+    Eigen::Map< const DenseMatrix< F > > XM(X, op.shape().second, k);
+    Eigen::Map< DenseMatrix< F > > YM(Y, op.shape().first, k);
+    for (size_t j = 0; j < k; ++j){
+      matvec(XM.col(j).data(), YM.col(j).data());
+    }
+  }
+
+  // Approximates v^T f(A) v via Lanczos quadrature 
+  auto quad(const F* v) const -> F {
+    // Save copy of v + its norm 
+    Eigen::Map< const VectorF > v_map(v, op.shape().second); // no-op 
+    v_copy = v_map;                          // save copy, as it is used as workspace by the recurrence
+    transform(v_copy.data(), v_copy.size()); // transform as needed
+    const F v_scale = v_copy.norm(); 
+
+    // Execute lanczos method + Golub-Welsch algorithm
+    alpha.setZero();
+    beta.setZero();
+    const int k_orth = param_orth(orth, deg, ncv, op.shape());
+    lanczos_recurrence< F >(op, v_copy.data(), deg, rtol, k_orth, alpha.data(), beta.data(), Q.data(), ncv, reorth, nullptr, &rw);   
+    // The FTTR requires a non-zero subdiagonal, so fall back to Golub-Welsch if the iteration terminated early
+    if (method == golub_welsch || krylov_dim(beta.data(), deg) < deg){
+      tridiagonal_eigen(Eigen::DecompositionOptions::ComputeEigenvectors);
+      PRIMATE_PHASE(quad_phase);
+      nodes = solver.eigenvalues().array();
+      weights = solver.eigenvectors().row(0).transpose().array().square();
+    } else {
+      tridiagonal_eigen(Eigen::DecompositionOptions::EigenvaluesOnly);
+      PRIMATE_PHASE(quad_phase);
+      nodes = solver.eigenvalues().array();
+      FTTR_weights< F >(nodes.data(), alpha.data(), beta.data(), deg, weights.data());
+    }
+    if (krylov_dim(beta.data(), deg) < deg){ trim_rule(nodes.data(), weights.data(), deg); }
   
-//     // Apply f to the nodes and sum
-//     // std::transform(nodes.begin(), nodes.end(), nodes.begin(), f);
-//     f(nodes.data(), nodes.size());
-
-//     // std::cout << "f(nodes): " << nodes << std::endl;
-//     // std::cout << "quad: " << F((nodes * weights).sum()) << std::endl; 
-//     // std::cout << "vscale**2 " << std::pow(v_scale, 2) << std::endl; 
-//     return std::pow(v_scale, 2) * (nodes * weights).sum();
-//   }
-
-//   // Returns (rows, columns)
-//   auto shape() const noexcept -> std::pair< size_t, size_t > {
-//     // if (op == nullptr){ return std::make_pair< size_t, size_t >(0, 0); }
-//     return op.shape();
-//   }
-
-//   // private: // Internal state to re-use
-//   mutable DenseMatrix< F > Q;
-//   mutable ArrayF alpha;
-//   mutable ArrayF beta;
-//   mutable ArrayF nodes;
-//   mutable ArrayF weights;
-//   mutable EigenSolver solver;  
-// };
-
-// // Approximates the action v |-> f(A)v via the Lanczos method
-// template< std::floating_point F, LinearOperator Matrix > 
-// void matrix_approx(
-//   const Matrix& A,                            // LinearOperator 
-//   std::function< F(F) > sf,             // the spectral function 
-//   const F* v,                                 // the input vector
-//   const int lanczos_degree,                   // Polynomial degree of the Krylov expansion
-//   const F lanczos_rtol,                       // residual tolerance to consider subspace A-invariant
-//   const int orth,                             // Number of vectors to re-orthogonalize against <= lanczos_degree
-//   F* y                                        // Output vector
-// ){
-//   MatrixFunction< F, Matrix >(A, sf, lanczos_degree, lanczos_rtol, orth, lanczos_degree).matvec(v, y);
-// };
+    // Apply f to the nodes and sum
+    PRIMATE_PHASE(quad_phase, 0); // counted with its rule
+    f(nodes.data(), deg);
+    return std::pow(v_scale, 2) * (nodes * weights).sum();
+  }
+
+  // Returns (rows, columns)
+  auto shape() const noexcept -> std::pair< size_t, size_t > {
+    return op.shape();
+  }
+
+  // Internal state to re-use
+  mutable DenseMatrix< F > Q;
+  mutable VectorF v_copy;
+  mutable ArrayF alpha;
+  mutable ArrayF beta;
+  mutable ArrayF nodes;
+  mutable ArrayF weights;
+  mutable VectorF diag;
+  mutable VectorF subdiag;
+  mutable VectorF coeffs;
+  mutable EigenSolver solver;  
+  mutable ReorthWorkspace< F > rw;
+
+  private: 
+  // Eigen-decomposes the tridiagonal T(alpha, beta) from pre-allocated storage, to avoid temporaries
+  void tridiagonal_eigen(const int options) const {
+    diag = alpha.head(deg).matrix();
+    subdiag = beta.segment(1, deg-1).matrix();
+    PRIMATE_PHASE(eigen_phase);
+    solver.computeFromTridiagonal(diag, subdiag, options);
+  }
+};
+
+// Approximates the action v |-> f(A)v via the Lanczos method
+template< std::floating_point F, LinearOperator Matrix > 
+void matrix_approx(
+  const Matrix& A,                            // LinearOperator 
+  const SpectralFunction< F >& sf,            // the spectral function 
+  const F* v,                                 // the input vector
+  const int lanczos_degree,                   // Polynomial degree of the Krylov expansion
+  const F lanczos_rtol,                       // residual tolerance to consider subspace A-invariant
+  const int orth,                             // Number of vectors to re-orthogonalize against <= lanczos_degree
+  F* y                                        // Output vector
+){
+  MatrixFunction< F, Matrix >(A, sf, lanczos_degree, lanczos_rtol, orth, lanczos_degree).matvec(v, y);
+};
 
 #endif 
\ No newline at end of file
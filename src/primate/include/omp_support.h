@@ -7,7 +7,14 @@
    #define omp_get_thread_num() 0
 	 #define omp_set_num_threads(x) 0
    #define omp_get_max_threads() 1 
+   #define omp_in_parallel() 0
+   #define omp_get_level() 0
 #endif
 
+// Number of threads to launch; non-positive values defer to the OpenMP runtime
+inline auto param_threads(const int num_threads) -> int {
+  return num_threads <= 0 ? omp_get_max_threads() : num_threads;
+}
+
 
 #endif
\ No newline at end of file
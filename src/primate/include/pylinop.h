@@ -3,73 +3,95 @@
 
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
+#include <functional> // function
+#include <vector>     // vector
+#include <algorithm>  // copy
 namespace py = pybind11;
 
 template< typename F >
 using py_array = py::array_t< F, py::array::f_style | py::array::forcecast >;
 
-#include <chrono>
-using us = std::chrono::microseconds;
-using dur_seconds = std::chrono::duration< double >;
-using hr_clock = std::chrono::high_resolution_clock;
-
+// Wraps a Python object exposing 'matvec' and 'shape' (e.g. a SciPy LinearOperator) as a LinearOperator
+// The bound 'matvec' (and 'matmat', if available) methods and the shape are looked up once on construction. Inputs are 
+// passed as read-only NumPy views of the native buffers, so the only copy made per product is that of the output. 
+// Note that the views are only valid for the duration of the call, and must not be stored by the Python operator.
 template< std::floating_point F > 
 struct PyLinearOperator {
   using value_type = F;
   const py::object _op; 
-  mutable size_t matvec_time; 
-	std::pair< size_t, size_t > _shape; // copy the shape on construct
+  std::pair< size_t, size_t > _shape; // copy the shape on construct
+  py::object _matvec;                 // bound methods
+  py::object _matmat;                 // None if the operator doesn't support matmat
   
-  PyLinearOperator(const py::object op) : _op(op), matvec_time(0.0) {
+  PyLinearOperator(const py::object op) : _op(op) {
     if (!py::hasattr(op, "matvec")) { throw std::invalid_argument("Supplied object is missing 'matvec' attribute."); }
     if (!py::hasattr(op, "shape")) { throw std::invalid_argument("Supplied object is missing 'shape' attribute."); }
     // if (!op.has_attr("dtype")) { throw std::invalid_argument("Supplied object is missing 'dtype' attribute."); }
-		_shape = _op.attr("shape").template cast< std::pair< size_t, size_t > >();
-    matvec_time = 0; 
+    _shape = _op.attr("shape").template cast< std::pair< size_t, size_t > >();
+    _matvec = _op.attr("matvec");
+    _matmat = py::hasattr(op, "matmat") ? py::object(_op.attr("matmat")) : py::none();
   }
 
-  // Calls the matvec in python, casts the result to py::array_t, and copies through
-  auto matvec(const F* inp, F* out) const {
-    auto ts = hr_clock::now(); 
-    py_array< F > input({ static_cast<py::ssize_t>(_shape.second) }, inp);
-    py::object matvec_out = _op.attr("matvec")(input);
-    py::array_t< F > output = matvec_out.cast< py::array_t< F > >();
-    // std::copy(output.data(), output.data() + output.size(), out);
-		std::copy(output.data(), output.data() + _shape.first, out);
-    matvec_time += duration_cast< us >(dur_seconds(hr_clock::now() - ts)).count();
+  // Calls the matvec in python on a view of the input, and copies the result through
+  void matvec(const F* inp, F* out) const {
+    const auto input = view(inp, { py::ssize_t(_shape.second) }, { py::ssize_t(sizeof(F)) });
+    const auto output = _matvec(input).template cast< py_array< F > >(); // no-op if already contiguous of type F
+    if (size_t(output.size()) != _shape.first){ throw std::invalid_argument("Output of 'matvec' does not match the shape of the operator."); }
+    std::copy(output.data(), output.data() + _shape.first, out);
   }
 
-  // auto matmat(const F* X, F* Y) const {
-  //   if (py::hasattr(op, "matvec")){ 
-  //     return; 
-  //   } else {
-
-  //   }
-  //   Eigen::Map< const DenseMatrix< F > > XM(X, op->shape().second, k);
-  //   Eigen::Map< DenseMatrix< F > > YM(Y, op->shape().first, k);
-  //   for (size_t j = 0; j < k; ++j){
-  //     matvec(XM.col(j).data(), YM.col(j).data());
-  //   }
-  //   // py_array< F > input({ static_cast<py::ssize_t>(shape().second) }, inp);
-  //   // py::object matvec_out = _op.attr("matvec")(input);
-  //   // py::array_t< F > output = matvec_out.cast< py::array_t< F > >();
-  //   // std::copy(output.data(), output.data() + output.size(), out);
-  // }
+  // Calls the matmat in python on a view of the column-major input, if it has one, and otherwise matvecs each column
+  void matmat(const F* X, F* Y, const size_t k) const {
+    if (_matmat.is_none()){
+      for (size_t j = 0; j < k; ++j){ matvec(X + j * _shape.second, Y + j * _shape.first); }
+      return;
+    }
+    const auto input = view(X, 
+      { py::ssize_t(_shape.second), py::ssize_t(k) }, 
+      { py::ssize_t(sizeof(F)), py::ssize_t(sizeof(F) * _shape.second) }
+    );
+    const auto output = _matmat(input).template cast< py_array< F > >(); // Fortran-ordered to match Y
+    if (size_t(output.size()) != _shape.first * k){ throw std::invalid_argument("Output of 'matmat' does not match the shape of the operator."); }
+    std::copy(output.data(), output.data() + _shape.first * k, Y);
+  }
 
   auto matvec(const py_array< F >& input) const -> py_array< F > {
-    auto out = std::vector< F >(static_cast< size_t >(shape().first), 0);
-    this->matvec(input.data(), static_cast< F* >(&out[0]));
-    return py::cast(out);
+    auto out = py_array< F >(static_cast< py::ssize_t >(_shape.first));
+    this->matvec(input.data(), out.mutable_data());
+    return out;
   }
 
   auto shape() const -> pair< size_t, size_t > { 
-    return _op.attr("shape").template cast< std::pair< size_t, size_t > >();
+    return _shape;
   }
 
   auto dtype() const -> py::dtype {
     auto dtype = pybind11::dtype(pybind11::format_descriptor< F >::format());
     return dtype;
   }
+
+  private: 
+  // Read-only NumPy view of native memory; the capsule is a no-op, as the memory is not owned by the view
+  static auto view(const F* data, std::vector< py::ssize_t > shape, std::vector< py::ssize_t > strides) -> py::array_t< F > {
+    const auto no_op = py::capsule(data, [](void*){});
+    auto arr = py::array_t< F >(std::move(shape), std::move(strides), data, no_op);
+    py::detail::array_proxy(arr.ptr())->flags &= ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+    return arr;
+  }
 };
 
+// Wraps a Python callable as a spectral function, evaluating it on a (zero-copy) view of the nodes
+// The result is copied back into the nodes; the caller must not release the GIL when a wrapped callable is used
+template< std::floating_point F >
+auto py_spectral_func(const py::function& fun) -> std::function< void(F*, const size_t) > {
+  return [fun](F* x, const size_t n){
+    py::gil_scoped_acquire gil;
+    const auto no_op = py::capsule(x, [](void*){}); // view does not own the memory
+    py::array_t< F > nodes({ static_cast< py::ssize_t >(n) }, { static_cast< py::ssize_t >(sizeof(F)) }, x, no_op);
+    py::array_t< F, py::array::c_style | py::array::forcecast > out = fun(nodes);
+    if (size_t(out.size()) != n){ throw std::invalid_argument("Spectral function must return an array matching the size of its input."); }
+    if (out.data() != x){ std::copy(out.data(), out.data() + n, x); } // identity-like functions may return the view
+  };
+}
+
 #endif
\ No newline at end of file
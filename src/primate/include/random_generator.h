@@ -0,0 +1,87 @@
+#ifndef _RANDOM_GENERATOR_H
+#define _RANDOM_GENERATOR_H
+
+#include <concepts>   // std::floating_point
+#include <string>     // string
+#include <stdexcept>  // invalid_argument
+#include <cmath>      // sqrt, log, cos, sin
+#include <cstdint>    // uint64_t
+#include <algorithm>  // min
+#include <array>      // array
+
+#include "instrumentation.h" // PRIMATE_PHASE
+
+// Isotropic distributions to sample probe vectors from; see `random.isotropic`
+enum Distribution { rademacher = 0, normal = 1, sphere = 2 };
+
+// Maps the names (and aliases) used by the Python API to a distribution
+inline auto parse_distribution(const std::string& pdf) -> Distribution {
+  if (pdf == "rademacher" || pdf == "signs"){ return rademacher; }
+  if (pdf == "normal" || pdf == "gaussian"){ return normal; }
+  if (pdf == "sphere"){ return sphere; }
+  throw std::invalid_argument("Invalid distribution '" + pdf + "' supplied.");
+}
+
+// Philox4x32-10 counter-based generator (Salmon, Moraes, Dror & Shaw, 2011)
+// Bijectively maps a 128-bit counter to 128 random bits under a 64-bit key. Unlike sequential generators, any draw can
+// be computed directly from its counter, such that draws may be divided among threads in any way without changing them.
+struct Philox4x32 {
+  using counter_type = std::array< uint32_t, 4 >;
+  static constexpr uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57; // round multipliers
+  static constexpr uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85; // Weyl sequence of the key schedule
+  const uint32_t k0, k1;
+
+  explicit Philox4x32(const uint64_t key) : k0(uint32_t(key)), k1(uint32_t(key >> 32)) {}
+
+  auto operator()(counter_type c) const -> counter_type {
+    uint32_t a = k0, b = k1;
+    for (int r = 0; r < 10; ++r, a += W0, b += W1){
+      const uint64_t p0 = uint64_t(M0) * c[0];
+      const uint64_t p1 = uint64_t(M1) * c[2];
+      c = { uint32_t(p1 >> 32) ^ c[1] ^ a, uint32_t(p1), uint32_t(p0 >> 32) ^ c[3] ^ b, uint32_t(p0) };
+    }
+    return c;
+  }
+};
+
+// Fills v with the probe `index`, i.e. E[v v^T] = I, of the given stream, sampled from an isotropic distribution keyed by `seed`
+// Each probe is a pure function of (seed, stream, index), and so is reproducible regardless of which thread generates it.
+// The 128-bit counter of block j of the probe is (j, index, stream). Rademacher entries are unpacked from the bits of each 
+// block, 128 entries at a time, in a branch-free loop that vectorizes. Normal entries are drawn two per block via the 
+// Box-Muller transform of two 53-bit uniforms, in double precision such that float and double probes match up to rounding.
+template< std::floating_point F >
+void generate_probe(const Distribution dist, const size_t n, const uint64_t seed, const uint32_t stream, const uint64_t index, F* v){
+  PRIMATE_PHASE(rng_phase);
+  const auto philox = Philox4x32(seed);
+  const uint32_t i_lo = uint32_t(index), i_hi = uint32_t(index >> 32);
+  if (dist == rademacher){
+    for (size_t i = 0, j = 0; i < n; i += 128, ++j){
+      const auto bits = philox({ uint32_t(j), i_lo, i_hi, stream });
+      const size_t m = std::min< size_t >(128, n - i);
+      #pragma omp simd
+      for (size_t l = 0; l < m; ++l){
+        v[i + l] = F(1.0) - F(2.0) * F((bits[l / 32] >> (l % 32)) & 1u);
+      }
+    }
+  } else {
+    constexpr double two_pi = 6.283185307179586476925286766559;
+    constexpr double unit = 1.0 / double(uint64_t(1) << 53);
+    for (size_t i = 0, j = 0; i < n; i += 2, ++j){
+      const auto bits = philox({ uint32_t(j), i_lo, i_hi, stream });
+      const double u1 = double(((uint64_t(bits[0]) << 32 | bits[1]) >> 11) + 1) * unit; // (0, 1]
+      const double u2 = double((uint64_t(bits[2]) << 32 | bits[3]) >> 11) * unit;       // [0, 1)
+      const double r = std::sqrt(-2.0 * std::log(u1));
+      v[i] = F(r * std::cos(two_pi * u2));
+      if (i + 1 < n){ v[i + 1] = F(r * std::sin(two_pi * u2)); }
+    }
+    if (dist == sphere){
+      // Project onto the sphere of radius sqrt(n)
+      double sq_norm = 0.0;
+      for (size_t i = 0; i < n; ++i){ sq_norm += double(v[i]) * double(v[i]); }
+      const F scale = F(std::sqrt(double(n) / sq_norm));
+      for (size_t i = 0; i < n; ++i){ v[i] *= scale; }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef _SPECTRAL_FUNCTIONS_H
+#define _SPECTRAL_FUNCTIONS_H
+
+#include <concepts>       // std::floating_point
+#include <functional>     // function
+#include <string>         // string
+#include <unordered_map>  // unordered_map
+#include <stdexcept>      // invalid_argument
+#include <cmath>          // log, exp, sqrt
+#include <limits>         // numeric_limits
+#include <algorithm>      // clamp
+
+// Spectral functions are applied in-place to a contiguous array of Ritz values (nodes)
+template< std::floating_point F >
+using SpectralFunction = std::function< void(F*, const size_t) >;
+
+template< std::floating_point F >
+using SpectralParams = std::unordered_map< std::string, F >;
+
+// Returns the value of a named parameter, or a default if it wasn't supplied
+template< std::floating_point F >
+auto get_param(const SpectralParams< F >& params, const std::string& key, const F default_value) -> F {
+  const auto it = params.find(key);
+  return it == params.end() ? default_value : it->second;
+}
+
+// Parameterizes one of the builtin spectral functions by name; these mirror `special.param_callable`
+// Evaluating them natively avoids calling back into the interpreter for every quadrature rule
+template< std::floating_point F >
+auto param_spectral_func(const std::string& name, const SpectralParams< F >& params = {}) -> SpectralFunction< F > {
+  if (name == "identity" || name.empty()){
+    return [](F*, const size_t){ return; };
+  } else if (name == "abs"){
+    return [](F* x, const size_t n){ for (size_t i = 0; i < n; ++i){ x[i] = std::abs(x[i]); } };
+  } else if (name == "sqrt"){
+    return [](F* x, const size_t n){ for (size_t i = 0; i < n; ++i){ x[i] = std::sqrt(x[i]); } };
+  } else if (name == "log"){
+    // Match the Python side, which clips the nodes to machine epsilon (in double precision) before taking logs
+    const F eps = static_cast< F >(std::numeric_limits< double >::epsilon());
+    return [eps](F* x, const size_t n){ for (size_t i = 0; i < n; ++i){ x[i] = std::log(std::max(x[i], eps)); } };
+  } else if (name == "inv"){
+    return [](F* x, const size_t n){ for (size_t i = 0; i < n; ++i){ x[i] = F(1.0) / x[i]; } };
+  } else if (name == "exp"){
+    const F t = get_param< F >(params, "t", 1.0);
+    return [t](F* x, const size_t n){ for (size_t i = 0; i < n; ++i){ x[i] = std::exp(t * x[i]); } };
+  } else if (name == "smoothstep"){
+    const F a = get_param< F >(params, "a", 0.0);
+    const F b = get_param< F >(params, "b", 1.0);
+    const F d = (b - a) != 0 ? (b - a) : F(1.0);
+    return [a, d](F* x, const size_t n){
+      for (size_t i = 0; i < n; ++i){
+        const F y = std::clamp((x[i] - a) / d, F(0.0), F(1.0)); // maps [a,b] |-> [0,1]
+        x[i] = y * y * (F(3.0) - F(2.0) * y);
+      }
+    };
+  } else if (name == "softsign"){
+    // Truncated series sum_{i=0}^{q} x (1 - x^2)^i prod_{j=1}^{i} (2j - 1) / (2j), which tends to sgn(x) on [-1, 1]
+    const int q = static_cast< int >(get_param< F >(params, "q", 10));
+    return [q](F* x, const size_t n){
+      for (size_t i = 0; i < n; ++i){
+        const F y = std::clamp(x[i], F(-1.0), F(1.0));
+        const F z = F(1.0) - y * y;
+        F s = y, term = y, coef = 1.0;
+        for (int j = 1; j <= q; ++j){
+          term *= z;
+          coef *= F(2 * j - 1) / F(2 * j);
+          s += coef * term;
+        }
+        x[i] = s;
+      }
+    };
+  } else if (name == "numrank"){
+    const F c = get_param< F >(params, "threshold", 0.000001);
+    return [c](F* x, const size_t n){ for (size_t i = 0; i < n; ++i){ x[i] = std::abs(x[i]) < c ? F(0.0) : F(1.0); } };
+  }
+  throw std::invalid_argument("Unknown spectral function '" + name + "'.");
+}
+
+#endif
@@ -0,0 +1,746 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <concepts>   // std::floating_point
+#include <random>     // random_device
+#include <cstdint>    // int64_t, uint32_t
+#include <atomic>     // atomic_bool
+#include <exception>  // exception_ptr
+#include <limits>     // numeric_limits
+#include <algorithm>  // min, max, lower_bound, is_sorted
+#include <string>     // string
+#include <stdexcept>  // invalid_argument
+
+#include "lanczos.h"              // lanczos_recurrence, lanczos_quadrature
+#include "random_generator.h"     // Distribution, generate_probe
+#include "spectral_functions.h"   // SpectralFunction
+#include "estimators.h"           // MeanEstimator, StoppingCriterion
+#include "omp_support.h"          // conditionally enables openmp pragmas
+
+#include <Eigen/QR>               // HouseholderQR
+
+// Callable receiving each probe vector v_i after it is sampled, which may modify it in-place (e.g. to deflate it)
+template< std::floating_point F >
+using ProbeVisitor = std::function< void(const int, F*) >;
+
+// Stochastic Lanczos quadrature (SLQ)
+// For each of `nv` isotropic probe vectors v, executes the Lanczos method on K(A, v) and then computes the Gaussian
+// quadrature rule (nodes, weights) of the resulting tridiagonal via Golub-Welsch or the FTTR. The Golub-Welsch rules of a
+// block are computed together by jacobi_rules_block, i.e. in SIMD lanes and without forming the eigenvectors. Each rule is handed to the callable
+// `f_quad(i, ||v||^2, nodes, weights)` from the thread that computed it, which is free to modify the nodes in-place.
+// Probes are distributed dynamically across threads in blocks of `block_size`, each of which owns its Lanczos / quadrature 
+// workspace. Blocks of more than one probe are tridiagonalized in lock-step with lanczos_recurrence_batch, which 
+// applies the operator to the whole block at once when it supports matmat. No more threads than blocks are launched, such 
+// that a single block leaves all threads to operators parallelizing their own products (e.g. CSREigenLinearOperator).
+// Probe i is the i-th probe of stream 0 of the counter-based generator keyed by `seed` (see generate_probe), and thus 
+// independent of the thread sampling it: the quadrature rules are the same for any number of threads, and for any block 
+// size up to rounding.
+// Exceptions thrown by the operator or by `f_quad` cancel the remaining probes and are re-thrown once all threads join.
+// The probes and Lanczos vectors are stored in F, whereas the tridiagonals, their quadrature rules and the squared norms 
+// of the probes are computed in S (see lanczos_recurrence), e.g. S = double with a float32 operator.
+// Each thread's workspace is taken from `arena`, if supplied, which is grown to the number of threads launched. Reusing 
+// an arena across calls of the same sizes avoids allocating the workspace on every call, e.g. for each batch of probes.
+// If supplied, `probe` is applied to each probe before its norm is taken, from the thread that sampled it.
+// If supplied, `cancel` is polled before each block; once set, the remaining blocks are skipped (see slq_trace_converge).
+// Probe i is sampled as probe `offset + i` of the generator, such that disjoint ranges of probes of the same seed may be 
+// divided among several calls (e.g. one per process); f_quad (and probe) still receive the local index i.
+// If supplied, probe i is instead read from column i of the n x nv (column-major) matrix `probes`, and no probe is sampled.
+// Precondition: A is symmetric and `f_quad` (and `probe`) are safe to call concurrently for distinct probe indices.
+template< std::floating_point F, std::floating_point S = F, LinearOperator Matrix, typename Lambda >
+void slq(
+  const Matrix& A,                // Symmetric linear operator
+  const Lambda& f_quad,           // Callable receiving the quadrature rule of each probe
+  const int nv,                   // Number of probe vectors to sample
+  const Distribution dist,        // Isotropic distribution to sample probes from
+  const int64_t seed,             // Seed for the random number generators; negative values draw from std::random_device
+  const int lanczos_degree,       // Dimension of the Krylov subspace to capture
+  const F lanczos_rtol,           // Tolerance of residual error for early-stopping the iteration.
+  const int orth,                 // Number of *additional* vectors to orthogonalize against
+  const int _ncv,                 // Number of Lanczos vectors to keep in memory (per thread)
+  const int num_threads,          // Number of threads to use; non-positive values use all available
+  const int block_size = 1,       // Number of probes to tridiagonalize simultaneously (per thread)
+  const weight_method method = golub_welsch, // Method to compute the quadrature weights with
+  const orth_method reorth = mgs, // Method of re-orthogonalizing the Lanczos vectors
+  LanczosArena< F, S >* arena = nullptr, // Optional per-thread workspace to re-use
+  const ProbeVisitor< F >& probe = nullptr, // Optional in-place transformation of each probe
+  const std::atomic_bool* cancel = nullptr, // Optional flag to stop sampling probes early
+  const uint64_t offset = 0,      // Index of the first probe in the stream of the generator
+  const F* probes = nullptr       // Optional fixed probes to use instead of sampling (n x nv)
+){
+  const auto A_shape = A.shape();
+  const size_t n = A_shape.first;
+  const int deg = param_deg(lanczos_degree, A_shape);
+  const int ncv = param_ncv(_ncv, deg, A_shape);
+  const int k_orth = param_orth(orth, deg, ncv, A_shape);
+  const int k = std::max(1, std::min(block_size, nv));
+  const int n_blocks = (nv + k - 1) / k;
+  [[maybe_unused]] const int nt = std::max(1, std::min(param_threads(num_threads), n_blocks));
+  const uint64_t base_seed = seed < 0 ? (uint64_t(std::random_device()()) << 32) | std::random_device()() : uint64_t(seed);
+  std::exception_ptr error = nullptr;
+  std::atomic_bool failed = false;
+  auto arena_local = LanczosArena< F, S >();
+  auto& workspaces = (arena != nullptr ? *arena : arena_local).workspaces;
+  if (int(workspaces.size()) < nt){ workspaces.resize(nt); }
+
+  #pragma omp parallel num_threads(nt)
+  {
+    // Thread-local workspace
+    const auto tid = static_cast< uint32_t >(omp_get_thread_num());
+    auto& ws = workspaces[tid];
+    ws.prepare(n, deg, ncv, k, reorth, k_orth);
+    auto& q = ws.q;
+    auto& Q = ws.Q;
+    auto& alpha = ws.alpha;
+    auto& beta = ws.beta;
+    auto& sq_norms = ws.sq_norms;
+    auto& nodes = ws.nodes;
+    auto& weights = ws.weights;
+
+    #pragma omp for schedule(dynamic)
+    for (int bi = 0; bi < n_blocks; ++bi){
+      if (failed || (cancel != nullptr && cancel->load(std::memory_order_relaxed))){ continue; }
+      try {
+        const int i0 = bi * k;
+        const int kb = std::min(k, nv - i0);  // the last block may be partial
+        for (int c = 0; c < kb; ++c){
+          if (probes != nullptr){
+            std::copy_n(probes + size_t(i0 + c) * n, n, q.col(c).data());
+          } else {
+            generate_probe< F >(dist, n, base_seed, 0, offset + uint64_t(i0 + c), q.col(c).data());
+          }
+          if (probe){ probe(i0 + c, q.col(c).data()); }
+          sq_norms[c] = dot_as< S >(q.col(c), q.col(c));
+        }
+
+        // Stale entries from previous probes must not leak into T if the iteration terminates early
+        alpha.setZero();
+        beta.setZero();
+        if (kb == 1){
+          lanczos_recurrence< F >(A, q.data(), deg, lanczos_rtol, k_orth, alpha.data(), beta.data(), Q.data(), ncv, reorth, nullptr, &ws.rw);
+        } else {
+          lanczos_recurrence_batch< F >(A, q.data(), kb, deg, lanczos_rtol, k_orth, alpha.data(), beta.data(), Q.data(), ncv, reorth, &ws.rw);
+        }
+        if (method == golub_welsch){
+          jacobi_rules_block< S >(alpha.data(), beta.data(), deg + 1, deg, kb, nodes.data(), weights.data(), deg, ws.jacobi_work.data());
+        }
+        for (int c = 0; c < kb; ++c){
+          S* const theta = nodes.data() + size_t(c) * deg;
+          S* const tau = weights.data() + size_t(c) * deg;
+          if (method != golub_welsch){
+            lanczos_quadrature< S >(alpha.col(c).data(), beta.col(c).data(), deg, ws.solver, theta, tau, method, &ws.diag, &ws.subdiag);
+          } else if (krylov_dim(beta.col(c).data(), deg) < deg){
+            trim_rule(theta, tau, deg);
+          }
+          PRIMATE_PHASE(quad_phase, 0); // counted with its rule
+          f_quad(i0 + c, sq_norms[c], theta, tau);
+        }
+      } catch (...) {
+        #pragma omp critical
+        { if (!failed){ error = std::current_exception(); failed = true; } }
+      }
+    }
+  }
+  if (error){ std::rethrow_exception(error); }
+}
+
+// Girard-Hutchinson estimates of tr(f(A)) via stochastic Lanczos quadrature
+// Writes the `nv` sample quadratic forms v^T f(A) v into `estimates`; their mean is an unbiased estimate of tr(f(A))
+// The spectral function and the estimates are evaluated in S, which may be wider than the operator's type F.
+// The probes are those of indices offset, ..., offset + nv - 1 (see slq), unless fixed `probes` are supplied.
+template< std::floating_point F, LinearOperator Matrix, std::floating_point S = F >
+void slq_trace(
+  const Matrix& A, const SpectralFunction< S >& sf,
+  const int nv, const Distribution dist, const int64_t seed,
+  const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv,
+  const int num_threads,
+  S* estimates, 
+  const int block_size = 1,
+  const weight_method method = golub_welsch,
+  const orth_method reorth = mgs,
+  LanczosArena< F, S >* arena = nullptr,
+  const ProbeVisitor< F >& probe = nullptr,
+  const uint64_t offset = 0,
+  const F* probes = nullptr
+){
+  const int deg = param_deg(lanczos_degree, A.shape());
+  const auto quad_est = [&](const int i, const S sq_norm, S* nodes, S* weights){
+    sf(nodes, deg);
+    estimates[i] = sq_norm * (Eigen::Map< const Array< S > >(nodes, deg) * Eigen::Map< const Array< S > >(weights, deg)).sum();
+  };
+  slq< F, S >(A, quad_est, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, block_size, method, reorth, arena, probe, nullptr, offset, probes);
+}
+
+// Girard-Hutchinson estimates of tr(f_1(A)), ..., tr(f_m(A)) from a single stochastic Lanczos quadrature run
+// The quadrature rule of each probe does not depend on f, so all m functions are evaluated on the same nodes and weights.
+// Writes the sample quadratic forms of probe i under f_j into estimates[i + j * nv], i.e. an nv x m column-major array, 
+// whose column means estimate the traces and whose rows are jointly distributed (e.g. to estimate their covariance).
+template< std::floating_point F, LinearOperator Matrix, std::floating_point S = F >
+void slq_trace_multi(
+  const Matrix& A, const std::vector< SpectralFunction< S > >& sfs,
+  const int nv, const Distribution dist, const int64_t seed,
+  const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv,
+  const int num_threads,
+  S* estimates, 
+  const int block_size = 1,
+  const weight_method method = golub_welsch,
+  const orth_method reorth = mgs,
+  LanczosArena< F, S >* arena = nullptr
+){
+  const int deg = param_deg(lanczos_degree, A.shape());
+  const int m = static_cast< int >(sfs.size());
+  auto values = static_cast< DenseMatrix< S > >(DenseMatrix< S >::Zero(deg, param_threads(num_threads)));
+  const auto quad_multi = [&](const int i, const S sq_norm, S* nodes, S* weights){
+    auto fx = values.col(omp_get_thread_num());
+    const auto theta = Eigen::Map< const Vector< S > >(nodes, deg);
+    const auto w = Eigen::Map< const Vector< S > >(weights, deg);
+    for (int j = 0; j < m; ++j){
+      fx = theta;
+      sfs[j](fx.data(), deg);
+      estimates[i + size_t(j) * nv] = sq_norm * fx.dot(w);
+    }
+  };
+  slq< F, S >(A, quad_multi, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, block_size, method, reorth, arena);
+}
+
+// Stochastic Lanczos quadrature rules of nv probes, for evaluating any number of functions f afterwards
+// Writes the nodes and weights of probe i into column i of the deg x nv column-major arrays `nodes` and `weights`, the 
+// weights being scaled by the squared norm of the probe, such that sum(weights[:, i] * f(nodes[:, i])) = v_i^T f(A) v_i. 
+template< std::floating_point F, LinearOperator Matrix, std::floating_point S = F >
+void slq_rules(
+  const Matrix& A,
+  const int nv, const Distribution dist, const int64_t seed,
+  const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv,
+  const int num_threads,
+  S* nodes, S* weights,
+  const int block_size = 1,
+  const weight_method method = golub_welsch,
+  const orth_method reorth = mgs,
+  LanczosArena< F, S >* arena = nullptr
+){
+  const int deg = param_deg(lanczos_degree, A.shape());
+  const auto quad_rule = [&](const int i, const S sq_norm, S* theta, S* w){
+    Eigen::Map< Vector< S > >(nodes + size_t(i) * deg, deg) = Eigen::Map< const Vector< S > >(theta, deg);
+    Eigen::Map< Vector< S > >(weights + size_t(i) * deg, deg) = sq_norm * Eigen::Map< const Vector< S > >(w, deg);
+  };
+  slq< F, S >(A, quad_rule, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, block_size, method, reorth, arena);
+}
+
+// Smoothing kernels of the spectral density estimator
+enum density_kernel { gaussian_kernel = 0, lorentzian_kernel = 1 };
+
+inline auto parse_density_kernel(const std::string& kernel) -> density_kernel {
+  if (kernel == "gaussian"){ return gaussian_kernel; }
+  if (kernel == "lorentzian" || kernel == "cauchy"){ return lorentzian_kernel; }
+  throw std::invalid_argument("Invalid kernel '" + kernel + "' supplied; must be one of 'gaussian' or 'lorentzian'.");
+}
+
+// Adds the smoothed quadrature rule sum_k w_k K_h(x - theta_k) onto the ng points x of `grid`, accumulating into `density`
+// Gaussian kernels are truncated at 8 bandwidths (a relative mass of ~1e-15) when the grid is sorted, such that each node 
+// only touches the grid points within its window; Lorentzian kernels are heavy-tailed and so are evaluated on the whole grid.
+template< std::floating_point S >
+void smooth_rule(
+  const S* nodes, const S* weights, const int deg, 
+  const S* grid, const int ng, const bool sorted,
+  const density_kernel kernel, const S h, 
+  S* density
+){
+  constexpr S inv_sqrt_2pi = S(0.39894228040143267794);
+  constexpr S inv_pi = S(0.31830988618379067154);
+  for (int k = 0; k < deg; ++k){
+    if (weights[k] == S(0)){ continue; }
+    const S theta = nodes[k];
+    if (kernel == gaussian_kernel){
+      const S c = weights[k] * inv_sqrt_2pi / h;
+      const S a = S(-0.5) / (h * h);
+      const int j0 = sorted ? int(std::lower_bound(grid, grid + ng, theta - 8 * h) - grid) : 0;
+      const int j1 = sorted ? int(std::upper_bound(grid + j0, grid + ng, theta + 8 * h) - grid) : ng;
+      #pragma omp simd
+      for (int j = j0; j < j1; ++j){
+        const S d = grid[j] - theta;
+        density[j] += c * std::exp(a * d * d);
+      }
+    } else {
+      const S c = weights[k] * h * inv_pi;
+      const S h2 = h * h;
+      #pragma omp simd
+      for (int j = 0; j < ng; ++j){
+        const S d = grid[j] - theta;
+        density[j] += c / (d * d + h2);
+      }
+    }
+  }
+}
+
+// Stochastic Lanczos quadrature estimate of the spectral density psi(x) = n^{-1} sum_i delta(x - lambda_i) of A
+// (Lin, Saad & Yang, 2016), smoothed by a kernel of bandwidth h and evaluated on the ng points of `grid`
+// The normalized quadrature rule of each probe (whose weights sum to one) is smoothed onto the grid by the thread that 
+// computed it, into its own histogram; the histograms are summed once all threads join and averaged over the nv probes 
+// into `density`. The memory used is thus O(ng) per thread, rather than the O(nv * deg) of the rules themselves.
+// As probes are scheduled dynamically, the order of the summation, and thus its rounding, depends on the number of threads.
+template< std::floating_point F, LinearOperator Matrix, std::floating_point S = F >
+void slq_density(
+  const Matrix& A,
+  const S* grid, const int ng, const density_kernel kernel, const S bandwidth,
+  const int nv, const Distribution dist, const int64_t seed,
+  const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv,
+  const int num_threads,
+  S* density,
+  const int block_size = 1,
+  const weight_method method = golub_welsch,
+  const orth_method reorth = mgs,
+  LanczosArena< F, S >* arena = nullptr
+){
+  if (!(bandwidth > S(0))){ throw std::invalid_argument("The bandwidth of the kernel must be positive."); }
+  const int deg = param_deg(lanczos_degree, A.shape());
+  const bool sorted = std::is_sorted(grid, grid + ng);
+  auto hist = static_cast< DenseMatrix< S > >(DenseMatrix< S >::Zero(ng, param_threads(num_threads)));
+  const auto quad_smooth = [&](const int, const S, S* nodes, S* weights){
+    smooth_rule< S >(nodes, weights, deg, grid, ng, sorted, kernel, bandwidth, hist.col(omp_get_thread_num()).data());
+  };
+  slq< F, S >(A, quad_smooth, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, block_size, method, reorth, arena);
+  Eigen::Map< Vector< S > >(density, ng) = hist.rowwise().sum() / S(std::max(nv, 1));
+}
+
+// Girard-Hutchinson estimates of tr(f(A + t B)) along the path of parameters t = ts[0], ..., ts[m-1], from the same nv probes
+// Writes the sample quadratic forms of probe i at parameter ts[j] into estimates[i + j * nv], i.e. an nv x m column-major array.
+// If A is an AffineOperator, B is its own; each parameter is set in turn, re-using the probes (by re-using the seed) and 
+// the per-thread workspaces across the path. Otherwise B = I: as the Lanczos tridiagonal of A + tI is that of A shifted 
+// by t, whose eigenvectors do not depend on t, each probe is tridiagonalized and its rule computed once, and the nodes
+// are shifted for every t. The cost of the whole path is then that of a single trace estimate, plus m evaluations of f.
+template< std::floating_point F, LinearOperator Matrix, std::floating_point S = F >
+void slq_trace_path(
+  const Matrix& A, const SpectralFunction< S >& sf,
+  const int m, const F* ts,
+  const int nv, const Distribution dist, const int64_t seed,
+  const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv,
+  const int num_threads,
+  S* estimates, 
+  const int block_size = 1,
+  const weight_method method = golub_welsch,
+  const orth_method reorth = mgs,
+  LanczosArena< F, S >* arena = nullptr
+){
+  if constexpr (AffineOperator< Matrix, F >){
+    auto arena_local = LanczosArena< F, S >();
+    for (int j = 0; j < m; ++j){
+      A.set_parameter(ts[j]);
+      slq_trace< F, Matrix, S >(A, sf, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, 
+        estimates + size_t(j) * nv, block_size, method, reorth, arena != nullptr ? arena : &arena_local);
+    }
+  } else {
+    const int deg = param_deg(lanczos_degree, A.shape());
+    auto shifted = static_cast< DenseMatrix< S > >(DenseMatrix< S >::Zero(deg, param_threads(num_threads)));
+    const auto quad_path = [&](const int i, const S sq_norm, S* nodes, S* weights){
+      auto theta = shifted.col(omp_get_thread_num());
+      const auto theta0 = Eigen::Map< const Vector< S > >(nodes, deg);
+      const auto w = Eigen::Map< const Vector< S > >(weights, deg);
+      for (int j = 0; j < m; ++j){
+        theta = theta0.array() + S(ts[j]);
+        sf(theta.data(), deg);
+        estimates[i + size_t(j) * nv] = sq_norm * theta.dot(w);
+      }
+    };
+    slq< F, S >(A, quad_path, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, block_size, method, reorth, arena);
+  }
+}
+
+// Girard-Hutchinson estimation of tr(f(A)) via stochastic Lanczos quadrature, stopping once any of `criteria` is met
+// Samples are folded into `est` in chunks of `check_every` consecutive probes, in probe order: the thread completing the 
+// last outstanding probe of the next chunk(s) merges them under a lock and tests the criteria, and then cancels the 
+// remaining probes if they are met. Only the probes of merged chunks count towards the estimate; probes in flight at the 
+// time of cancellation are discarded. The merged prefix, and thus the estimate, is the same for any number of threads.
+// Writes the samples into the first entries of `estimates` (of length nv) and returns the number merged into `est`,
+// which is less than nv if the criteria were met first. `est` may hold the state of previous calls (of different seeds).
+template< std::floating_point F, LinearOperator Matrix, std::floating_point S = F >
+auto slq_trace_converge(
+  const Matrix& A, const SpectralFunction< S >& sf,
+  const int nv, const Distribution dist, const int64_t seed,
+  const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv,
+  const int num_threads,
+  const std::vector< StoppingCriterion >& criteria, 
+  const int check_every,
+  S* estimates, 
+  MeanEstimator& est,
+  const int block_size = 1,
+  const weight_method method = golub_welsch,
+  const orth_method reorth = mgs,
+  LanczosArena< F, S >* arena = nullptr
+) -> int {
+  if (nv <= 0 || any_met(criteria, est)){ return 0; }
+  const int deg = param_deg(lanczos_degree, A.shape());
+  const int m = std::max(1, check_every);
+  const int n_chunks = (nv + m - 1) / m;
+  auto remaining = std::vector< std::atomic_int >(n_chunks);
+  for (int c = 0; c < n_chunks; ++c){ remaining[c].store(std::min(m, nv - c * m), std::memory_order_relaxed); }
+  int n_merged = 0; // number of chunks merged into est
+  std::atomic_bool stop = false;
+  const auto quad_est = [&](const int i, const S sq_norm, S* nodes, S* weights){
+    sf(nodes, deg);
+    estimates[i] = sq_norm * (Eigen::Map< const Array< S > >(nodes, deg) * Eigen::Map< const Array< S > >(weights, deg)).sum();
+    if (remaining[i / m].fetch_sub(1, std::memory_order_acq_rel) == 1){
+      #pragma omp critical(slq_trace_converge)
+      {
+        while (!stop && n_merged < n_chunks && remaining[n_merged].load(std::memory_order_acquire) == 0){
+          const int i0 = n_merged * m;
+          est.update(estimates + i0, std::min(m, nv - i0));
+          ++n_merged;
+          if (any_met(criteria, est)){ stop = true; }
+        }
+      }
+    }
+  };
+  slq< F, S >(A, quad_est, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, block_size, method, reorth, arena, nullptr, &stop);
+  return std::min(nv, n_merged * m);
+}
+
+// Returns the (non-negative) seed shared by the phases of an estimator, drawing one from std::random_device if negative
+inline auto param_seed(const int64_t seed) -> int64_t {
+  return seed < 0 ? int64_t(((uint64_t(std::random_device()()) << 32) | std::random_device()()) >> 1) : seed;
+}
+
+// Girard-Hutchinson estimates of tr(f(A)) via stochastic Lanczos quadrature of adaptive degree
+// The recurrence of each probe starts at degree `deg_start` and is resumed (see LanczosState) in increments of `deg_step` 
+// up to `lanczos_degree`, until its quadrature v^T f(A) v changes by at most atol + rtol |v^T f(A) v| between increments
+// or its Krylov space is exhausted. Writes the sample of probe i into estimates[i], and its final degree into degrees[i].
+// Probes are sampled as in slq, and so are the same for any number of threads, but are tridiagonalized one at a time.
+// The eigensolver and tridiagonal copies of each intermediate degree are kept in each thread's workspace (see 
+// LanczosWorkspace::prepare_checks), such that the quadrature at every increment re-uses its storage across probes, and 
+// across calls re-using the same arena. With zero tolerances, each sample equals that of slq_trace up to 
+// the rounding of the eigensolver. As in slq, probe i is probe `offset + i` of the generator.
+template< std::floating_point F, LinearOperator Matrix, std::floating_point S = F >
+void slq_trace_adaptive(
+  const Matrix& A, const SpectralFunction< S >& sf,
+  const int nv, const Distribution dist, const int64_t seed,
+  const int lanczos_degree, const F lanczos_rtol, const int orth, const int _ncv,
+  const int deg_start, const int deg_step, const S atol, const S rtol,
+  const int num_threads,
+  S* estimates, int* degrees,
+  const weight_method method = golub_welsch,
+  const orth_method reorth = mgs,
+  LanczosArena< F, S >* arena = nullptr,
+  const uint64_t offset = 0
+){
+  const auto A_shape = A.shape();
+  const size_t n = A_shape.first;
+  const int deg = param_deg(lanczos_degree, A_shape);
+  const int ncv = param_ncv(_ncv, deg, A_shape);
+  const int k_orth = param_orth(orth, deg, ncv, A_shape);
+  const int d0 = std::clamp(deg_start, std::min(2, deg), deg);
+  const int step = std::max(1, deg_step);
+  const int n_checks = 1 + (deg - d0 + step - 1) / step;
+  const auto check_deg = [=](const int c){ return std::min(d0 + c * step, deg); };
+  [[maybe_unused]] const int nt = std::max(1, std::min(param_threads(num_threads), nv));
+  const uint64_t base_seed = uint64_t(param_seed(seed));
+  std::exception_ptr error = nullptr;
+  std::atomic_bool failed = false;
+  auto arena_local = LanczosArena< F, S >();
+  auto& workspaces = (arena != nullptr ? *arena : arena_local).workspaces;
+  if (int(workspaces.size()) < nt){ workspaces.resize(nt); }
+
+  #pragma omp parallel num_threads(nt)
+  {
+    const auto tid = static_cast< uint32_t >(omp_get_thread_num());
+    auto& ws = workspaces[tid];
+    ws.prepare(n, deg, ncv, 1, reorth, k_orth);
+    ws.prepare_checks(n_checks, check_deg);
+
+    #pragma omp for schedule(dynamic)
+    for (int i = 0; i < nv; ++i){
+      if (failed){ continue; }
+      try {
+        auto q = ws.q.col(0);
+        generate_probe< F >(dist, n, base_seed, 0, offset + uint64_t(i), q.data());
+        const S sq_norm = dot_as< S >(q, q);
+        ws.alpha.setZero();
+        ws.beta.setZero();
+        auto state = LanczosState();
+        S value = 0, prev = std::numeric_limits< S >::quiet_NaN();
+        for (int c = 0; c < n_checks; ++c){
+          const int dc = check_deg(c);
+          lanczos_recurrence< F >(A, q.data(), dc, lanczos_rtol, k_orth, ws.alpha.data(), ws.beta.data(), ws.Q.data(), ncv, reorth, nullptr, &ws.rw, &state);
+          lanczos_quadrature< S >(ws.alpha.data(), ws.beta.data(), dc, ws.check_solvers[c], ws.nodes.data(), ws.weights.data(), method, &ws.check_diags[c], &ws.check_subdiags[c]);
+          {
+            PRIMATE_PHASE(quad_phase, 0); // counted with its rule
+            sf(ws.nodes.data(), dc);
+            value = sq_norm * (ws.nodes.head(dc) * ws.weights.head(dc)).sum();
+          }
+          if (state.exhausted || std::abs(value - prev) <= atol + rtol * std::abs(value)){ break; }
+          prev = value;
+        }
+        estimates[i] = value;
+        degrees[i] = state.j;
+      } catch (...) {
+        #pragma omp critical
+        { if (!failed){ error = std::current_exception(); failed = true; } }
+      }
+    }
+  }
+  if (error){ std::rethrow_exception(error); }
+}
+
+// Fills the k columns of the n x k matrix X with the probes offset, ..., offset + k - 1 of a stream (see generate_probe)
+// Columns are divided statically among threads; as each probe depends only on its index, X is the same for any thread count.
+template< std::floating_point F >
+void generate_probes(
+  const Distribution dist, const size_t n, const int k, const uint64_t seed, const uint32_t stream, const uint64_t offset, 
+  F* X, const int num_threads
+){
+  [[maybe_unused]] const int nt = std::max(1, std::min(param_threads(num_threads), k));
+  #pragma omp parallel for num_threads(nt) schedule(static)
+  for (int j = 0; j < k; ++j){ generate_probe< F >(dist, n, seed, stream, offset + uint64_t(j), X + size_t(j) * n); }
+}
+
+// Samples the k columns of the n x k matrix X as the first k probes of stream `stream + 1`, such that the first j columns 
+// are identical for any k >= j. Distinct streams of the same seed are independent of each other and of the probes of slq.
+template< std::floating_point F >
+void generate_sketch(const Distribution dist, const size_t n, const int k, const int64_t seed, F* X, const uint32_t stream = 0){
+  generate_probes< F >(dist, n, k, uint64_t(seed), stream + 1, 0, X, 1);
+}
+
+// Copies a matrix function for use by a single thread, which then owns its own workspace. The operator itself is held
+// by a shared pointer, so copies share it rather than copying the matrix it may own (e.g. a CSR matrix). External basis 
+// storage is also shared by all copies but is not safe to write concurrently, so the copy allocates its own instead.
+template< LinearOperator Matrix >
+auto thread_copy(const Matrix& A) -> Matrix {
+  auto A_local = A;
+  if constexpr (requires { A_local.basis; }){ A_local.basis = nullptr; }
+  return A_local;
+}
+
+// Applies Y = A X to the k columns of the n x k matrix X
+// Matrix functions (i.e. QuadOperators) offer no faster matmat than one Lanczos iteration per column, so their columns 
+// are distributed across threads, each of which applies its own copy of the operator and thus of its workspace; the
+// copies share the matrix held by the operator. Other operators apply matmat (or matvec) on the calling thread, which 
+// may parallelize internally.
+template< std::floating_point F, LinearOperator Matrix >
+void apply_columns(const Matrix& A, const F* X, F* Y, const int k, const int num_threads){
+  const auto [m, n] = A.shape();
+  if constexpr (QuadOperator< Matrix, F >){
+    [[maybe_unused]] const int nt = std::max(1, std::min(param_threads(num_threads), k));
+    if (nt == 1){
+      for (int j = 0; j < k; ++j){ A.matvec(X + j * n, Y + j * m); }
+      return;
+    }
+    std::exception_ptr error = nullptr;
+    #pragma omp parallel num_threads(nt)
+    {
+      const auto A_local = thread_copy(A);
+      #pragma omp for schedule(dynamic)
+      for (int j = 0; j < k; ++j){
+        try { A_local.matvec(X + j * n, Y + j * m); } catch (...) {
+          #pragma omp critical
+          { if (!error){ error = std::current_exception(); } }
+        }
+      }
+    }
+    if (error){ std::rethrow_exception(error); }
+  } else if constexpr (SupportsMatrixMult< Matrix, F >){
+    PRIMATE_PHASE(matvec_phase, uint64_t(k));
+    A.matmat(X, Y, size_t(k));
+  } else {
+    PRIMATE_PHASE(matvec_phase, uint64_t(k));
+    for (int j = 0; j < k; ++j){ A.matvec(X + j * n, Y + j * m); }
+  }
+}
+
+// Writes the k quadratic forms x_j^T A x_j of the columns of the n x k matrix X into `forms`
+// Matrix functions evaluate each one by Lanczos quadrature, which needs only ncv Lanczos vectors; see apply_columns
+template< std::floating_point F, LinearOperator Matrix >
+void quad_columns(const Matrix& A, const F* X, F* forms, const int k, const int num_threads){
+  const size_t n = A.shape().second;
+  if constexpr (QuadOperator< Matrix, F >){
+    [[maybe_unused]] const int nt = std::max(1, std::min(param_threads(num_threads), k));
+    if (nt == 1){
+      for (int j = 0; j < k; ++j){ forms[j] = A.quad(X + j * n); }
+      return;
+    }
+    std::exception_ptr error = nullptr;
+    #pragma omp parallel num_threads(nt)
+    {
+      const auto A_local = thread_copy(A);
+      #pragma omp for schedule(dynamic)
+      for (int j = 0; j < k; ++j){
+        try { forms[j] = A_local.quad(X + j * n); } catch (...) {
+          #pragma omp critical
+          { if (!error){ error = std::current_exception(); } }
+        }
+      }
+    }
+    if (error){ std::rethrow_exception(error); }
+  } else {
+    Eigen::Map< const DenseMatrix< F > > XM(X, n, k);
+    auto AX = static_cast< DenseMatrix< F > >(DenseMatrix< F >(A.shape().first, k));
+    apply_columns< F >(A, X, AX.data(), k, num_threads);
+    Eigen::Map< Vector< F > >(forms, k) = XM.cwiseProduct(AX).colwise().sum().transpose();
+  }
+}
+
+// Returns an orthonormal basis of the range of the n x k matrix Y (k <= n) via Householder QR, and optionally its R factor
+template< std::floating_point F >
+auto sketch_basis(const DenseMatrix< F >& Y, DenseMatrix< F >* R = nullptr) -> DenseMatrix< F > {
+  const auto qr = Eigen::HouseholderQR< DenseMatrix< F > >(Y);
+  if (R != nullptr){ *R = qr.matrixQR().topRows(Y.cols()).template triangularView< Eigen::Upper >(); }
+  return qr.householderQ() * DenseMatrix< F >::Identity(Y.rows(), Y.cols());
+}
+
+// Hutch++ estimates of tr(A) (Meyer et al., 2021)
+// Sketches the range of A with nb isotropic vectors W, whose basis Q = orth(A W) captures its dominant eigenspace, and 
+// then estimates the trace of the residual (I - QQ^T) A (I - QQ^T) with nv deflated Girard-Hutchinson probes.
+// Writes the nb quadratic forms q_j^T A q_j into `sketch_ests` and the nv residual quadratic forms into `defl_ests`; 
+// the Hutch++ estimate is sum(sketch_ests) + mean(defl_ests). 
+// Matrix functions estimate the residual phase natively with slq on their underlying operator, deflating each probe 
+// as it is sampled; other operators apply matmat to the block of deflated probes. 
+template< std::floating_point F, LinearOperator Matrix >
+void hutchpp(
+  const Matrix& A,                // Symmetric linear operator (or matrix function)
+  const int nb,                   // Number of sketch vectors
+  const int nv,                   // Number of residual probe vectors
+  const Distribution dist,        // Isotropic distribution to sample the sketch and probes from
+  const int64_t seed,             // Seed for the random number generators; negative values draw from std::random_device
+  const int num_threads,          // Number of threads to use; non-positive values use all available
+  F* sketch_ests,                 // Output quadratic forms of the sketch basis (nb)
+  F* defl_ests                    // Output quadratic forms of the deflated probes (nv)
+){
+  const size_t n = A.shape().first;
+  const int k = std::min(nb, int(n));
+  const int64_t base_seed = param_seed(seed);
+  std::fill(sketch_ests + k, sketch_ests + nb, F(0.0));
+
+  // Sketch the range of A and estimate the trace of its projection exactly
+  auto W = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, k));
+  auto Y = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, k));
+  generate_sketch< F >(dist, n, k, base_seed, W.data());
+  apply_columns< F >(A, W.data(), Y.data(), k, num_threads);
+  const auto Q = sketch_basis< F >(Y);
+  quad_columns< F >(A, Q.data(), sketch_ests, k, num_threads);
+
+  // Estimate the trace of the residual; the basis is orthonormal, so one pass of MGS projects out its range 
+  const auto deflate = [&Q, n](const int, F* g){
+    Eigen::Map< Vector< F > > g_map(g, n);
+    for (Eigen::Index j = 0; j < Q.cols(); ++j){ g_map -= Q.col(j).dot(g_map) * Q.col(j); }
+  };
+  if constexpr (QuadOperator< Matrix, F > && requires { A.op; A.f; }){
+    using Op = std::remove_cvref_t< decltype(A.op) >;
+    slq_trace< F, Op, F >(A.op, A.f, nv, dist, base_seed, A.deg, A.rtol, A.orth, A.ncv, num_threads, defl_ests, 1, A.method, A.reorth, nullptr, deflate);
+  } else {
+    auto G = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, nv));
+    generate_sketch< F >(dist, n, nv, base_seed, G.data(), 1);
+    for (int i = 0; i < nv; ++i){ deflate(i, G.col(i).data()); }
+    quad_columns< F >(A, G.data(), defl_ests, nv, num_threads);
+  }
+}
+
+// Deflation P A P of a symmetric operator by the orthogonal projector P = I - Q Q^T, where the k columns of Q are 
+// orthonormal (e.g. Ritz vectors of the extremal eigenvalues of A) 
+// Products are formed as P (A x), which equals P A P x for every x in the range of P, i.e. for the deflated probes and 
+// their Krylov spaces. One pass of MGS projects out the range of Q in-place, such that no workspace is shared by threads.
+template< std::floating_point F, LinearOperator Matrix >
+struct DeflatedOperator {
+  using value_type = F;
+  const Matrix& op;
+  const Eigen::Map< const DenseMatrix< F > > Q;
+
+  DeflatedOperator(const Matrix& A, const F* basis, const int k) : op(A), Q(basis, A.shape().first, k) {}
+
+  // Projects y onto the range of P
+  void project(F* y) const {
+    Eigen::Map< Vector< F > > y_map(y, Q.rows());
+    for (Eigen::Index j = 0; j < Q.cols(); ++j){ y_map -= Q.col(j).dot(y_map) * Q.col(j); }
+  }
+
+  void matvec(const F* x, F* y) const {
+    op.matvec(x, y);
+    project(y);
+  }
+
+  void matmat(const F* X, F* Y, const size_t k) const requires SupportsMatrixMult< Matrix > {
+    op.matmat(X, Y, k);
+    for (size_t j = 0; j < k; ++j){ project(Y + j * Q.rows()); }
+  }
+
+  auto shape() const noexcept -> std::pair< size_t, size_t > { return op.shape(); }
+};
+
+// Girard-Hutchinson estimates of tr(f(A)) deflated by the k orthonormal columns of Q, e.g. cached Ritz vectors of A
+// As tr(f(A)) = tr(Q^T f(A) Q) + tr(P f(A) P), the k forms q_j^T f(A) q_j are approximated by Lanczos quadrature 
+// into `defl_ests`, while the nv deflated probes P v are tridiagonalized on the deflated operator P A P, so that the 
+// eigenvalues captured by Q affect neither the Krylov spaces nor the variance of the samples written into `estimates`. 
+// The estimate of tr(f(A)) is sum(defl_ests) + mean(estimates). The samples estimate tr(P f(PAP) P), which equals 
+// tr(P f(A) P) only for invariant subspaces Q; otherwise the estimate is biased by the residual of Q.
+template< std::floating_point F, LinearOperator Matrix, std::floating_point S = F >
+void slq_trace_deflated(
+  const Matrix& A, const SpectralFunction< S >& sf,
+  const F* Q, const int k,
+  const int nv, const Distribution dist, const int64_t seed,
+  const int lanczos_degree, const F lanczos_rtol, const int orth, const int ncv,
+  const int num_threads,
+  S* defl_ests, S* estimates, 
+  const int block_size = 1,
+  const weight_method method = golub_welsch,
+  const orth_method reorth = mgs,
+  LanczosArena< F, S >* arena = nullptr,
+  const uint64_t offset = 0
+){
+  slq_trace< F, Matrix, S >(A, sf, k, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, defl_ests, 1, method, reorth, arena, nullptr, 0, Q);
+  const auto D = DeflatedOperator< F, Matrix >(A, Q, k);
+  const auto deflate = [&D](const int, F* v){ D.project(v); };
+  slq_trace< F, DeflatedOperator< F, Matrix >, S >(D, sf, nv, dist, seed, lanczos_degree, lanczos_rtol, orth, ncv, num_threads, estimates, block_size, method, reorth, arena, deflate, offset);
+}
+
+// Column-wise dot products diag(X^T Y) of two m x m matrices
+template< std::floating_point F >
+auto diag_prod(const DenseMatrix< F >& X, const DenseMatrix< F >& Y) -> Array< F > {
+  return X.cwiseProduct(Y).colwise().sum().transpose().array();
+}
+
+// XTrace estimates of tr(A) (Epperly, Tropp & Webber, 2024)
+// Forms the basis Q R = A W of m isotropic sketch vectors W and writes the m exchangeable leave-one-out estimates of 
+// tr(A), each of which uses the basis of the remaining m - 1 vectors, into `estimates`; their mean is the estimate. 
+// As the sketch is sampled sequentially (see generate_sketch), the sketches of a given seed are nested in m. 
+template< std::floating_point F, LinearOperator Matrix >
+void xtrace(
+  const Matrix& A,                // Symmetric linear operator (or matrix function)
+  const int m,                    // Number of sketch vectors, at most the dimension of A
+  const Distribution dist,        // Isotropic distribution to sample the sketch from
+  const int64_t seed,             // Seed for the random number generators; negative values draw from std::random_device
+  const int num_threads,          // Number of threads to use; non-positive values use all available
+  F* estimates                    // Output leave-one-out estimates (m)
+){
+  const size_t n = A.shape().first;
+  if (m < 1 || size_t(m) > n){ throw std::invalid_argument("The number of sketch vectors must be between 1 and the dimension of the operator."); }
+  auto W = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, m));
+  auto Y = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, m));
+  auto Z = static_cast< DenseMatrix< F > >(DenseMatrix< F >(n, m));
+  generate_sketch< F >(dist, n, m, param_seed(seed), W.data());
+  apply_columns< F >(A, W.data(), Y.data(), m, num_threads);
+  auto R = DenseMatrix< F >();
+  const auto Q = sketch_basis< F >(Y, &R);
+  apply_columns< F >(A, Q.data(), Z.data(), m, num_threads);
+
+  // S normalizes the columns of R^{-T}, whose j-th column is orthogonal to all but the j-th column of R
+  const DenseMatrix< F > I = DenseMatrix< F >::Identity(m, m);
+  DenseMatrix< F > S = R.template triangularView< Eigen::Upper >().solve(I).transpose();
+  S.array().rowwise() /= S.colwise().norm().array();
+
+  // Intermediate quantities
+  const DenseMatrix< F > W_proj = Q.transpose() * W;
+  const DenseMatrix< F > H = Q.transpose() * Z;
+  const DenseMatrix< F > HW = H * W_proj;
+  const DenseMatrix< F > T = Z.transpose() * W;
+  const Array< F > dSW = diag_prod< F >(S, W_proj);
+  const Array< F > dSHS = diag_prod< F >(S, H * S);
+  const Array< F > dTW = diag_prod< F >(T, W_proj);
+  const Array< F > dWHW = diag_prod< F >(W_proj, HW);
+  const Array< F > dSRmHW = diag_prod< F >(S, R - HW);
+  const Array< F > dTmHRS = diag_prod< F >(T - H.transpose() * W_proj, S);
+
+  // The sphere is scaled to account for the norm of the vector left out
+  auto scale = static_cast< Array< F > >(Array< F >::Ones(m));
+  if (dist == sphere){
+    const F c = F(n - m + 1);
+    scale = c / (F(n) - W_proj.colwise().squaredNorm().transpose().array() + dSW.square());
+  }
+  Eigen::Map< Array< F > >(estimates, m) = H.trace() - dSHS + (-dTW + dWHW + dSW * dSRmHW + dSW.square() * dSHS + dTmHRS * dSW) * scale;
+}
+
+#endif
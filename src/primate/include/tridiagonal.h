@@ -0,0 +1,209 @@
+#ifndef _TRIDIAGONAL_H
+#define _TRIDIAGONAL_H
+
+#include <concepts>   // std::floating_point
+#include <cstddef>    // size_t
+#include <cmath>      // abs, sqrt, copysign
+#include <limits>     // numeric_limits
+#include <vector>     // vector
+#include <algorithm>  // min, max
+
+#include "instrumentation.h"  // PRIMATE_PHASE
+#include "omp_support.h"      // conditionally enables openmp pragmas
+
+// Gaussian quadrature rules of nl <= W Jacobi matrices T(alpha, beta) of size k, solved together in the W lanes of SIMD
+// registers via the implicit QL method with Wilkinson shifts (tql2 in EISPACK; tqli in tqli.py). Only the first row of
+// the eigenvector matrix is accumulated by the Givens rotations, which is all the Golub-Welsch weights require, such
+// that each rule takes O(k^2) time and O(k) space, as opposed to the O(k^3) time of a full eigendecomposition.
+// Matrix j is read from column j of the column-major alpha and beta (leading dimension ld), whose subdiagonal as in
+// lanczos_quadrature starts at beta[1]; its (ascending) nodes and weights are written to column j of nodes and weights
+// (leading dimension ldo). The matrices are stored lane-interleaved in `work`, i.e. entry i of lane j is at i * W + j,
+// and each sweep is run over all lanes at once: lanes whose current eigenvalue has converged, or whose sweep is shorter,
+// are masked rather than branched on. The unused lanes of a partial batch hold zero matrices, which converge at once.
+// The arithmetic of each lane does not depend on the other lanes, so the rules of a matrix do not depend on the others
+// solved with it; solving it with a different W may only change them by rounding (e.g. by the contraction of FMAs).
+// Matrices whose eigenvalues do not converge within 30 sweeps each are left at their last iterate.
+// Precondition: `work` holds at least 3 * k * W entries and k >= 1.
+template< std::floating_point F, int W = 8 >
+void jacobi_rules_lanes(
+  const F* alpha,         // Input diagonals, column-major (ld x nl)
+  const F* beta,          // Input subdiagonals, column-major (ld x nl), whose non-zeros start at index 1
+  const size_t ld,        // Leading dimension of alpha and beta
+  const int k,            // Size of each Jacobi matrix
+  const int nl,           // Number of matrices, at most W
+  F* nodes,               // Output nodes, column-major (ldo x nl)
+  F* weights,             // Output weights, column-major (ldo x nl)
+  const size_t ldo,       // Leading dimension of nodes and weights
+  F* work                 // Workspace for the lane-interleaved matrices (3 * k * W)
+) {
+  constexpr int max_sweeps = 30;
+  const F eps = std::numeric_limits< F >::epsilon();
+  F* d = work;            // diagonals, converging to the nodes
+  F* e = work + k * W;    // subdiagonals; e[i] couples d[i] and d[i+1], and e[k-1] = 0
+  F* z = work + 2 * k * W; // first row of the eigenvector matrix
+  {
+    PRIMATE_PHASE(eigen_phase, uint64_t(nl));
+    for (int i = 0; i < k; ++i){
+      for (int w = 0; w < W; ++w){
+        const bool used = w < nl;
+        d[i * W + w] = used ? alpha[w * ld + i] : F(0);
+        e[i * W + w] = used && i + 1 < k ? beta[w * ld + i + 1] : F(0);
+        z[i * W + w] = i == 0 ? F(1) : F(0);
+      }
+    }
+
+    // Per-lane state of the current sweep
+    int m[W];
+    bool active[W], broken[W];
+    F s[W], c[W], p[W], g[W];
+    for (int l = 0; l < k; ++l){
+      for (int sweep = 0; sweep <= max_sweeps; ++sweep){
+        // The block of each lane starting at l ends at its first negligible subdiagonal e[m]
+        bool found[W];
+        for (int w = 0; w < W; ++w){ m[w] = k - 1; found[w] = false; }
+        for (int i = l; i < k - 1; ++i){
+          int n_found = 0;
+          #pragma omp simd reduction(+:n_found)
+          for (int w = 0; w < W; ++w){
+            const F dd = std::abs(d[i * W + w]) + std::abs(d[(i + 1) * W + w]);
+            const bool small = std::abs(e[i * W + w]) <= eps * dd;
+            m[w] = !found[w] && small ? i : m[w];
+            found[w] = found[w] || small;
+            n_found += int(found[w]);
+          }
+          if (n_found == W){ break; }
+        }
+        int m_max = l;
+        for (int w = 0; w < W; ++w){
+          active[w] = m[w] != l;
+          m_max = std::max(m_max, active[w] ? m[w] : l);
+        }
+        if (m_max == l || sweep == max_sweeps){ break; }
+
+        // Wilkinson shift of the leading 2 x 2 block of each lane
+        #pragma omp simd
+        for (int w = 0; w < W; ++w){
+          const F el = active[w] ? e[l * W + w] : F(1);
+          const F gl = (d[(l + 1) * W + w] - d[l * W + w]) / (F(2) * el);
+          const F r = std::sqrt(gl * gl + F(1));
+          g[w] = d[m[w] * W + w] - d[l * W + w] + el / (gl + std::copysign(r, gl));
+          s[w] = F(1); c[w] = F(1); p[w] = F(0);
+          broken[w] = false;
+        }
+
+        // Chase the bulge from the bottom of each lane's block up to l, skipping the rotations outside of it
+        for (int i = m_max - 1; i >= l; --i){
+          F* const di = d + i * W;
+          F* const di1 = d + (i + 1) * W;
+          F* const ei = e + i * W;
+          F* const ei1 = e + (i + 1) * W;
+          F* const zi = z + i * W;
+          F* const zi1 = z + (i + 1) * W;
+          #pragma omp simd
+          for (int w = 0; w < W; ++w){
+            const bool on = active[w] && !broken[w] && i < m[w];
+            const F f = s[w] * ei[w];
+            const F b = c[w] * ei[w];
+            const F r = std::sqrt(f * f + g[w] * g[w]);
+            const bool zero = on && r == F(0);  // the rotation underflowed: deflate, and restart the sweep
+            const bool go = on && r != F(0);
+            const F rr = go ? r : F(1);
+            const F sn = f / rr, cn = g[w] / rr;
+            const F gn = di1[w] - p[w];
+            const F rn = (di[w] - gn) * sn + F(2) * cn * b;
+            const F pn = sn * rn;
+            ei1[w] = go ? r : ei1[w];
+            di1[w] = go ? gn + pn : (zero ? di1[w] - p[w] : di1[w]);
+            const F zf = zi1[w];
+            zi1[w] = go ? sn * zi[w] + cn * zf : zf;
+            zi[w] = go ? cn * zi[w] - sn * zf : zi[w];
+            s[w] = go ? sn : s[w];
+            c[w] = go ? cn : c[w];
+            p[w] = go ? pn : p[w];
+            g[w] = go ? cn * rn - b : g[w];
+            broken[w] = broken[w] || zero;
+          }
+        }
+        for (int w = 0; w < W; ++w){
+          if (!active[w]){ continue; }
+          if (!broken[w]){ d[l * W + w] -= p[w]; e[l * W + w] = g[w]; }
+          e[m[w] * W + w] = F(0);
+        }
+      }
+    }
+  }
+
+  // Sort each rule by its nodes, which the sweeps leave nearly sorted
+  PRIMATE_PHASE(quad_phase, uint64_t(nl));
+  for (int w = 0; w < nl; ++w){
+    F* const x = nodes + w * ldo;
+    F* const t = weights + w * ldo;
+    for (int i = 0; i < k; ++i){
+      const F xi = d[i * W + w], ti = z[i * W + w] * z[i * W + w];
+      int j = i;
+      for (; j > 0 && x[j - 1] > xi; --j){ x[j] = x[j - 1]; t[j] = t[j - 1]; }
+      x[j] = xi;
+      t[j] = ti;
+    }
+  }
+}
+
+// Number of SIMD lanes, i.e. of Jacobi matrices, of the batches of jacobi_rules_block
+constexpr int jacobi_lanes = 8;
+
+// Size of the workspace of jacobi_rules_block for matrices of size k
+constexpr auto jacobi_work_size(const int k) -> size_t {
+  return 3 * size_t(k) * jacobi_lanes;
+}
+
+// Golub-Welsch quadrature rules of the nv Jacobi matrices of a block, e.g. of the tridiagonals of a block of probes
+// Full batches of jacobi_lanes matrices are solved together with jacobi_rules_lanes, and the remaining ones one at a
+// time, as the lanes of a partial batch would cost as much as a full one. Arguments are as in jacobi_rules_lanes.
+// Precondition: `work` holds at least jacobi_work_size(k) entries.
+template< std::floating_point F >
+void jacobi_rules_block(
+  const F* alpha, const F* beta, const size_t ld, const int k, const int nv, 
+  F* nodes, F* weights, const size_t ldo, F* work
+) {
+  constexpr int W = jacobi_lanes;
+  int j = 0;
+  for (; j + W <= nv; j += W){
+    jacobi_rules_lanes< F, W >(alpha + j * ld, beta + j * ld, ld, k, W, nodes + j * ldo, weights + j * ldo, ldo, work);
+  }
+  for (; j < nv; ++j){
+    jacobi_rules_lanes< F, 1 >(alpha + j * ld, beta + j * ld, ld, k, 1, nodes + j * ldo, weights + j * ldo, ldo, work);
+  }
+}
+
+// Golub-Welsch quadrature rules of nv Jacobi matrices of size k, e.g. of the tridiagonals of many probes
+// The matrices are solved in batches of jacobi_lanes with jacobi_rules_block, which are divided statically among threads.
+// Matrix j is read from column j of alpha and beta, whose subdiagonals start at beta[1] (see lanczos_quadrature), and
+// its ascending nodes and weights are written to column j of nodes and weights; all four arrays have leading dimension ld.
+template< std::floating_point F >
+void jacobi_rules(
+  const F* alpha,         // Input diagonals, column-major (ld x nv)
+  const F* beta,          // Input subdiagonals, column-major (ld x nv)
+  const size_t ld,        // Leading dimension of the inputs and outputs (at least k)
+  const int k,            // Size of each Jacobi matrix
+  const int nv,           // Number of matrices
+  F* nodes,               // Output nodes, column-major (ld x nv)
+  F* weights,             // Output weights, column-major (ld x nv)
+  const int num_threads   // Number of threads to use; non-positive values use all available
+) {
+  if (k < 1 || nv < 1){ return; }
+  constexpr int W = jacobi_lanes;
+  const int n_batches = (nv + W - 1) / W;
+  [[maybe_unused]] const int nt = std::max(1, std::min(param_threads(num_threads), n_batches));
+  #pragma omp parallel num_threads(nt)
+  {
+    auto work = std::vector< F >(jacobi_work_size(k));
+    #pragma omp for schedule(static)
+    for (int bi = 0; bi < n_batches; ++bi){
+      const size_t j0 = size_t(bi) * W;
+      const int nl = std::min(W, nv - int(j0));
+      jacobi_rules_block< F >(alpha + j0 * ld, beta + j0 * ld, ld, k, nl, nodes + j0 * ld, weights + j0 * ld, ld, work.data());
+    }
+  }
+}
+
+#endif
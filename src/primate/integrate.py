@@ -1,8 +1,11 @@
-from typing import Optional
+from typing import Optional, Union
 
 import numpy as np
+from scipy.sparse.linalg import LinearOperator
 
 from .fttr import fttr
+from .lanczos import _lanczos
+from .operators import MatrixFunction
 from .tridiag import eigh_tridiag, eigvalsh_tridiag
 
 
@@ -13,6 +16,7 @@ def quadrature(
 	quad: str = "gw",  # The method of computing the weights
 	nodes: Optional[np.ndarray] = None,  # Output nodes of the quadrature
 	weights: Optional[np.ndarray] = None,  # Output weights of the quadrature
+	num_threads: int = 0,
 	**kwargs,
 ) -> tuple:
 	r"""Compute the Gaussian quadrature rule of a tridiagonal Jacobi matrix.
@@ -36,15 +40,16 @@ def quadrature(
 	For more details on this, see the references.
 
 	Parameters:
-		d: array of `n` diagonal elements.
-		e: array of `n` or `n-1` off-diagonal elements. See details.
+		d: array of `n` diagonal elements, or an `(nv, n)` array holding the diagonals of `nv` matrices in its rows.
+		e: array of `n` or `n-1` off-diagonal elements, or an `(nv, n)` or `(nv, n-1)` array thereof. See details.
 		deg: degree of the quadrature rule to compute.
 		quad: method used to compute the rule. Either Golub Welsch or FTTR is supported.
 		nodes: output array to store the `deg` nodes of the quadrature (optional).
 		weights: output array to store the `deg` weights of the quadrature (optional).
+		num_threads: number of threads to compute the rules of multiple matrices with. Non-positive values use all available.
 
 	Returns:
-		tuple (nodes, weights) of the degree-`deg` Gaussian quadrature rule.
+		tuple (nodes, weights) of the degree-`deg` Gaussian quadrature rule, or of `(nv, deg)` arrays of the rules of each row.
 
 	Notes:
 		To compute the weights of the quadrature, `quad` can be set to either 'golub_welsch' or 'fttr'. The former uses a LAPACK call to
@@ -53,7 +58,14 @@ def quadrature(
 		$O(\mathrm{deg}^2)$ time to execute, the former requires $O(\mathrm{deg}^2)$ space but is highly accurate, while the latter uses
 		only $O(1)$ space at the cost of backward stability. If `deg` is large, `fttr` is preferred for performance, though pilot testing
 		should be done to ensure that instability does not cause a large bias in the approximation.
+
+		Two-dimensional `d` and `e`, such as the tridiagonals returned by `lanczos` for a matrix of starting vectors, are
+		solved natively under Golub-Welsch: the matrices are solved in batches occupying the lanes of SIMD registers via the
+		implicit QL method, which only accumulates the first components of the eigenvectors, with the batches divided among
+		`num_threads` threads. This avoids calling LAPACK, and validating and allocating its arguments, once per matrix.
 	"""
+	if np.ndim(d) == 2:
+		return _quadrature_batch(np.asarray(d), np.asarray(e), deg, quad, nodes, weights, num_threads, **kwargs)
 	deg = len(d) if deg is None else int(min(deg, len(d)))
 	e = np.append([0], e) if len(e) == (len(d) - 1) else e
 	assert len(d) == len(e) and np.isclose(e[0], 0.0), "Subdiagonal first element 'e[0]' must be close to zero"
@@ -74,3 +86,72 @@ def quadrature(
 		np.copyto(nodes, theta)
 		np.copyto(weights, tau)
 	return theta, tau
+
+
+def _quadrature_batch(d: np.ndarray, e: np.ndarray, deg, quad, nodes, weights, num_threads, **kwargs) -> tuple:
+	nv, k = d.shape
+	deg = k if deg is None else int(min(deg, k))
+	e = np.hstack([np.zeros((nv, 1), dtype=e.dtype), e]) if e.shape == (nv, k - 1) else e
+	assert e.shape == d.shape and np.allclose(e[:, 0], 0.0), "Subdiagonal first elements 'e[:,0]' must be close to zero"
+	if quad in {"gw", "golub_welsch"}:
+		dt = np.float32 if d.dtype == np.float32 else np.float64
+		alpha = np.asfortranarray(d[:, :deg].T, dtype=dt)
+		beta = np.asfortranarray(e[:, :deg].T, dtype=dt)
+		theta, tau = (X.T for X in _lanczos.jacobi_rules(alpha, beta, num_threads))
+	elif quad == "fttr":
+		rules = [quadrature(d[i], e[i], deg=deg, quad=quad, **kwargs) for i in range(nv)]
+		theta, tau = np.array([r[0] for r in rules]), np.array([r[1] for r in rules])
+	else:
+		raise ValueError(f"Invalid quadrature method '{quad}' supplied")
+	if nodes is not None and weights is not None:
+		assert nodes.shape == (nv, deg) and weights.shape == (nv, deg), "`nodes` and `weights` output arrays must be (nv, deg)."
+		np.copyto(nodes, theta)
+		np.copyto(weights, tau)
+	return theta, tau
+
+
+def spectral_density(
+	A: Union[LinearOperator, np.ndarray],
+	grid: np.ndarray,
+	nv: int = 100,
+	kernel: str = "gaussian",
+	bandwidth: Optional[float] = None,
+	pdf: str = "rademacher",
+	seed: Union[int, np.random.Generator, None] = None,
+	num_threads: int = 0,
+	block_size: int = 1,
+	**kwargs: dict,
+) -> np.ndarray:
+	r"""Estimates the spectral density of a symmetric `A` on a grid via stochastic Lanczos quadrature.
+
+	The spectral density of $A$ with eigenvalues $\lambda_1, \dots, \lambda_n$ is the normalized sum of point masses:
+
+	$$ \psi(x) = \frac{1}{n} \sum\limits_{i=1}^n \delta(x - \lambda_i) \approx \frac{1}{n_v} \sum\limits_{j=1}^{n_v} \sum\limits_{k=1}^{d} \tau_{jk} K_h(x - \theta_{jk}) $$
+
+	where $(\theta_{jk}, \tau_{jk})$ is the (normalized) degree-$d$ quadrature rule of the $j$-th probe (see `quadrature`) and
+	$K_h$ is a smoothing kernel of bandwidth $h$ (Lin, Saad & Yang, 2016). The rule of each probe is smoothed onto the grid by
+	the thread that computed it, into a per-thread histogram, such that the memory used does not grow with `nv`.
+
+	Parameters:
+		A: real symmetric matrix, linear operator, or `MatrixFunction` (whose function is not used).
+		grid: points to evaluate the density at.
+		nv: number of probe vectors to sample.
+		kernel: smoothing kernel; either 'gaussian' or 'lorentzian'.
+		bandwidth: bandwidth of the kernel (its standard deviation, or half-width at half-maximum). Defaults to the width of the grid divided by the Lanczos degree.
+		pdf: isotropic distribution to sample probes from.
+		seed: seed to initialize the `rng` entropy source.
+		num_threads: number of threads to use; non-positive values use all available.
+		block_size: number of probes to tridiagonalize simultaneously per thread.
+		**kwargs: additional keyword arguments to parameterize the `MatrixFunction` with, e.g. `deg` or `orth`.
+
+	Returns:
+		Estimates of the smoothed spectral density at each point of `grid`, which integrate to (at most) one.
+	"""
+	M = A if isinstance(A, MatrixFunction) else MatrixFunction(A, **kwargs)
+	grid = np.ravel(grid)
+	assert len(grid) > 0, "The grid must contain at least one point."
+	if bandwidth is None:
+		bandwidth = max(np.ptp(grid), np.finfo(np.float64).eps) / M._deg
+	assert bandwidth > 0, "The bandwidth of the kernel must be positive."
+	opts = dict(pdf=pdf, seed=seed, num_threads=num_threads, block_size=block_size)
+	return M._spectral_density(grid, nv, kernel=kernel, bandwidth=bandwidth, **opts)
@@ -2,13 +2,101 @@ import typing
 from typing import Any, Optional, Union
 
 import numpy as np
-from scipy.sparse import sparray, spdiags
+from scipy.sparse import issparse, sparray, spdiags
 from scipy.sparse.linalg import LinearOperator
 
 from . import _lanczos  # type: ignore
 from .tridiag import eigh_tridiag, eigvalsh_tridiag
 
 
+def _operator_kind(A: Any, storage: str = "full") -> str:
+	"""Classifies which native operator `A` is wrapped by: 'dense', 'csr' (row-major sparse), 'sparse', 'sym', 'toeplitz',
+	'composite', or 'linop'.
+
+	Sparse matrices with `storage='upper'` are wrapped by the symmetric operator, which only reads their upper triangle.
+	Toeplitz operators are applied natively via FFT, and composite operators (see `operators.composite`) as lazy compositions
+	of native operators. Both are recognized by their native handles, or by operators exposing one as `_native`, as are the
+	CSR and symmetric handles returned by `_native_operator`.
+	"""
+	assert storage in {"full", "upper"}, f"Invalid storage '{storage}'; must be one of 'full' or 'upper'."
+	if isinstance(A, np.ndarray):
+		return "dense"
+	elif issparse(A):
+		if storage == "upper":
+			return "sym"
+		return "csr" if A.format == "csr" else "sparse"
+	handle = getattr(A, "_native", A)
+	prefixes = {"toeplitz": "ToeplitzOperator_", "composite": "CompositeOperator_", "csr": "CSROperator_", "sym": "SymmetricOperator_"}
+	for kind, prefix in prefixes.items():
+		if isinstance(handle, (getattr(_lanczos, prefix + "float32"), getattr(_lanczos, prefix + "float64"))):
+			return kind
+	return "linop"
+
+
+def _native_suffix(kind: str) -> str:
+	"""Suffix of the native routines specialized for the given kind of operator, if any."""
+	return {"csr": "_csr", "sym": "_sym", "toeplitz": "_toeplitz", "composite": "_composite"}.get(kind, "")
+
+
+def _native_operator(A: Any, dtype: Optional[np.dtype] = None, storage: str = "full", general: bool = False) -> Any:
+	"""Wraps dense and sparse matrices in a persistent native operator handle.
+
+	The handle of a dense or (non-CSR) sparse matrix views the memory of `A` (keeping it alive), so it can be passed to the
+	native routines any number of times without `A` being converted to a new Eigen matrix on every call. Copies are only
+	made if `A` does not match `dtype` or its layout cannot be viewed directly. Row-major arrays are viewed through their
+	transpose, which is equal to `A` by symmetry, unless `A` is `general` (e.g. the operand of a composite), in which case
+	they are copied to column-major order. CSR matrices, and sparse matrices with `storage='upper'`, are instead
+	converted once into the row-parallel (or symmetric) operator, whose handle shares that copy with every routine it is
+	passed to. Toeplitz and composite operators are returned as their native handle; only Toeplitz operators may be rebuilt
+	for another dtype. All other operators are returned as-is.
+	"""
+	kind = _operator_kind(A, storage)
+	if kind not in {"dense", "sparse", "csr", "sym", "toeplitz", "composite"}:
+		return A
+	dtype = np.dtype(A.dtype if dtype is None else dtype)
+	if kind in {"csr", "sym"}:
+		if not issparse(A):
+			assert A.dtype == dtype, f"Native {kind} handles cannot be converted to '{dtype.name}'; wrap the matrix with that dtype."
+			return A
+		prefix = "CSROperator_" if kind == "csr" else "SymmetricOperator_"
+		return getattr(_lanczos, prefix + dtype.name)(A.astype(dtype, copy=False))
+	if kind in {"toeplitz", "composite"}:
+		op = getattr(A, "_native", A)
+		if op.dtype == dtype:
+			return op
+		assert kind == "toeplitz" and op is not A, f"Native {kind} handles cannot be converted to '{dtype.name}'; construct the operator with that dtype."
+		return getattr(_lanczos, f"ToeplitzOperator_{dtype.name}")(np.asarray(A.c, dtype=dtype), np.asarray(A.r, dtype=dtype))
+	if kind == "dense":
+		A = np.asarray(A).astype(dtype, copy=False)
+		A = A.T if A.flags["C_CONTIGUOUS"] and not general else np.asfortranarray(A)
+		return getattr(_lanczos, f"DenseOperator_{dtype.name}")(A)
+	A = A if A.format == "csc" else A.tocsc()
+	assert A.nnz < np.iinfo(np.int32).max, "Sparse operators support at most 2^31 - 1 non-zeros."
+	indptr, indices = np.asarray(A.indptr, dtype=np.int32), np.asarray(A.indices, dtype=np.int32)
+	data = np.ascontiguousarray(A.data, dtype=dtype)
+	return getattr(_lanczos, f"SparseOperator_{dtype.name}")(A.shape, indptr, indices, data)
+
+
+def _phase_stats(since: Optional[dict] = None) -> dict:
+	"""Counts and times (in seconds) of the phases of the native engines, summed over all threads.
+
+	Maps each phase ('matvec', 'reorth', 'eigen', 'quad' and 'rng') to its `count` and `time`, and 'threads' to the number
+	of threads that recorded any phase. If `since` is a previous result, the phases recorded since then are returned.
+	Empty unless the extension was compiled with `PRIMATE_INSTRUMENT` (see `include/instrumentation.h`).
+	"""
+	if not _lanczos.instrumented:
+		return {}
+	stats = _lanczos.phase_stats()
+	threads = stats.pop("threads")
+	stats = {phase: dict(count=int(count), time=float(time)) for phase, (count, time) in stats.items()}
+	if since:
+		for phase, s in stats.items():
+			s["count"] -= since[phase]["count"]
+			s["time"] -= since[phase]["time"]
+	stats["threads"] = threads
+	return stats
+
+
 def _validate_lanczos(N: int, ncv: int, deg: int, orth: int, atol: float, rtol: float) -> tuple:
 	deg: int = N if deg < 0 else int(np.clip(deg, 1, N))  # 1 <= deg <= N
 	ncv: int = int(np.clip(ncv, 2, min(deg, N)))  # 2 <= ncv <= deg
@@ -32,6 +120,9 @@ def lanczos(
 	return_basis: bool = False,
 	seed: Union[int, np.random.Generator, None] = None,
 	dtype: Optional[np.dtype] = None,
+	storage: str = "full",
+	mixed: bool = False,
+	reorth: str = "mgs",
 	**kwargs: Any,
 ) -> tuple:
 	r"""Lanczos method for symmetric tridiagonalization.
@@ -52,20 +143,47 @@ def lanczos(
 	This implementation supports varying degrees of re-orthogonalization. In particular, `orth=0` corresponds to no 
 	re-orthogonalization, `orth < deg` corresponds to partial re-orthogonalization, and `orth >= deg` corresponds to full re-orthogonalization.
 	The number of matvecs scales linearly with `deg` and the number of inner-products scales quadratically with `orth`.
+	With `reorth='cgs2'`, each Lanczos vector is instead projected against the previous `orth` vectors all at once 
+	(twice, for stability) via matrix-vector products, which is typically much faster for large `orth`. With `reorth='partial'`,
+	the loss of orthogonality is instead estimated from `(a,b)` via Simon's ω-recurrence (2), and Lanczos vectors are only
+	re-orthogonalized (against up to `orth` previous vectors) at the steps where it exceeds $\sqrt{\epsilon}$. This maintains
+	semi-orthogonality, which suffices for `(a,b)` to be accurate to working precision, at a fraction of the cost of `orth=deg`.
 
 	Parameters:
 		A: Symmetric operator to tridiagonalize.
-		v0: Initial vector to orthogonalize against.
+		v0: Initial vector to orthogonalize against. If two-dimensional, each column is tridiagonalized independently. 
 		deg: Size of the Krylov subspace to expand.
 		rtol: Relative tolerance to consider the invariant subspace as converged.
 		orth: Number of additional Lanczos vectors to orthogonalize against.
 		sparse_mat: Whether to output the tridiagonal matrix as a sparse matrix.
 		return_basis: If `True`, returns the Krylov basis vectors `Q`.
 		dtype: The precision dtype to specialize the computation.
+		storage: If 'upper' and `A` is sparse, only the upper triangle of `A` is stored and read. See details.
+		mixed: If `True` and `A` is single precision, the tridiagonal entries are accumulated in double precision. See details.
+		reorth: Method of re-orthogonalization; one of 'mgs', 'cgs2', or 'partial'. See details.
 
 	Returns:
 		A tuple `(a,b)` parameterizing the diagonal and off-diagonal of the tridiagonal Jacobi matrix. If `return_basis=True`,
 		the tuple `(a,b), Q` is returned, where `Q` represents an orthogonal basis for the degree-`deg` Krylov subspace.
+		If `v0` has `k` columns, `a` and `b` are instead `(k, deg)` and `(k, deg - 1)` arrays, one row per column of `v0`.
+
+	:::{.callout-note}
+	When `v0` has multiple columns, the `k` recurrences are advanced in lock-step, such that each step applies `A` to 
+	all `k` Lanczos vectors via a single matrix-matrix product (when supported). As sparse matrix-vector products are 
+	typically memory-bandwidth bound, this can be substantially faster than tridiagonalizing each column in turn.
+	:::
+
+	:::{.callout-note}
+	With `storage='upper'`, sparse matrices are multiplied via their upper triangle alone, halving both the memory used by
+	the native operator and the bytes moved per matvec. In this case `A` may also be given as just its upper triangle,
+	e.g. `scipy.sparse.triu(A)`.
+	:::
+
+	:::{.callout-note}
+	With `mixed=True`, a `float32` operator and its Lanczos vectors remain in single precision, whereas the dot products
+	and norms forming `(a,b)` are accumulated in double precision and returned as `float64`. This halves the memory moved
+	per iteration relative to `float64`, while limiting the loss of accuracy of `(a,b)` to that of the matvecs themselves.
+	:::
 
 	See Also:
 		- scipy.linalg.eigh_tridiagonal : Eigenvalue solver for real symmetric tridiagonal matrices.
@@ -73,6 +191,7 @@ def lanczos(
 
 	References:
 		1. Paige, Christopher C. "Computational variants of the Lanczos method for the eigenproblem." IMA Journal of Applied Mathematics 10.3 (1972): 373-381.
+		2. Simon, Horst D. "The Lanczos algorithm with partial reorthogonalization." Mathematics of Computation 42.165 (1984): 115-142.
 	"""
 	## Basic parameter validation
 	n: int = A.shape[0]
@@ -83,12 +202,17 @@ def lanczos(
 	## Get the dtype; infer it if it's not available
 	f_dtype = (A @ np.zeros(A.shape[1])).dtype if not hasattr(A, "dtype") else A.dtype
 	assert f_dtype.type in {np.float32, np.float64}, "Only 32- or 64-bit floating point numbers are supported."
+	s_dtype = np.dtype(np.float64) if mixed else f_dtype
 
 	## Determine number of projections + lanczos vectors
 	orth: int = deg if orth < 0 or orth > deg else orth
 	ncv: int = np.clip(orth, 2, deg) if not (return_basis) else deg
 	# _validate_lanczos(n, ncv, deg, orth)
 
+	## View dense / sparse matrices without copying them into a new native operator
+	kind: str = _operator_kind(A, storage)
+	A_op = _native_operator(A, f_dtype, storage)
+
 	## Generate the starting vector if none is specified
 	if v0 is None:
 		rng = np.random.default_rng(seed)
@@ -97,16 +221,28 @@ def lanczos(
 		v0: np.ndarray = np.array(v0).astype(dt)
 	assert len(v0) == A.shape[1], "Invalid starting vector; must match the number of columns of A."  # type: ignore
 
+	## Multiple starting vectors expand their Krylov spaces independently, sharing each application of A
+	if v0.ndim == 2:
+		assert not sparse_mat and not return_basis, "Multiple starting vectors only support returning the tridiagonal entries."
+		k: int = v0.shape[1]
+		alpha = np.zeros((deg + 1, k), dtype=s_dtype, order="F")
+		beta = np.zeros((deg + 1, k), dtype=s_dtype, order="F")
+		Q = np.zeros((n, ncv * k), dtype=f_dtype, order="F")
+		lanczos_batch = getattr(_lanczos, "lanczos_batch" + _native_suffix(kind))
+		lanczos_batch(A_op, np.asfortranarray(v0, dtype=f_dtype), deg, rtol, orth, alpha, beta, Q, reorth)
+		return alpha[:deg].T, beta[1:deg].T
+
 	## Allocate the tridiagonal elements + lanczos vectors in column-major storage
-	alpha = kwargs.get("alpha", np.zeros(deg + 1, dtype=f_dtype))
-	beta = kwargs.get("beta", np.zeros(deg + 1, dtype=f_dtype))
+	alpha = kwargs.get("alpha", np.zeros(deg + 1, dtype=s_dtype))
+	beta = kwargs.get("beta", np.zeros(deg + 1, dtype=s_dtype))
 	Q = kwargs.get("Q", np.zeros((n, ncv), dtype=f_dtype, order="F"))
-	assert isinstance(alpha, np.ndarray) and len(alpha) == deg + 1 and alpha.dtype == f_dtype and alpha.flags["WRITEABLE"]
-	assert isinstance(beta, np.ndarray) and len(beta) == deg + 1 and beta.dtype == f_dtype and beta.flags["WRITEABLE"]
+	assert isinstance(alpha, np.ndarray) and len(alpha) == deg + 1 and alpha.dtype == s_dtype and alpha.flags["WRITEABLE"]
+	assert isinstance(beta, np.ndarray) and len(beta) == deg + 1 and beta.dtype == s_dtype and beta.flags["WRITEABLE"]
 	assert Q.ndim == 2 and Q.shape == (n, ncv) and Q.flags["F_CONTIGUOUS"] and Q.flags["WRITEABLE"] and Q.flags["OWNDATA"]
 
 	## Call the procedure
-	_lanczos.lanczos(A, v0, deg, rtol, orth, alpha, beta, Q)
+	lanczos_fun = getattr(_lanczos, "lanczos" + _native_suffix(kind))
+	lanczos_fun(A_op, v0, deg, rtol, orth, alpha, beta, Q, reorth)
 
 	## Format the output(s)
 	if sparse_mat:
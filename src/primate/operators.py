@@ -1,13 +1,15 @@
+import tempfile
+from functools import partial
+from numbers import Number
 from typing import Any, Callable, Optional, Union
 
 import numpy as np
+from scipy.sparse import issparse
 from scipy.sparse.linalg import LinearOperator, aslinearoperator, eigsh
 from scipy.sparse.linalg._interface import IdentityOperator
 
-from .integrate import quadrature
-from .lanczos import _lanczos
+from .lanczos import _lanczos, _native_operator, _native_suffix, _operator_kind
 from .special import param_callable
-from .tridiag import eigh_tridiag
 
 F64: np.dtype = np.dtype("float64")
 
@@ -49,41 +51,92 @@ class MatrixFunction(LinearOperator):
 		deg: degree of the Krylov expansion to perform.
 		orth: number of Lanczos vectors to orthogonalize against.
 		dtype: floating point dtype to execute in. Must be float64 or float32.
+		quad: method used to compute the quadrature weights of `quad()`, either 'golub_welsch' (or 'gw') or 'fttr'.
+		storage: if 'upper' and `A` is sparse, only the upper triangle of `A` is stored and read.
+		mixed: if `True` and `dtype` is float32, native trace estimates accumulate the tridiagonals and quadratures in float64.
+		reorth: method of re-orthogonalization; one of 'mgs', 'cgs2', or 'partial' (see `lanczos`).
+		basis: storage of the (n x deg) Lanczos basis needed by matvecs; one of 'full', 'none', or 'mmap'. See details.
+		basis_file: file to memory-map the basis to when `basis='mmap'`; defaults to an anonymous temporary file.
 		kwargs: keyword arguments to pass to the Lanczos method.
+
+	:::{.callout-note}
+	Matrix-vector products by default keep all `deg` Lanczos vectors in memory to form $f(A)v \approx \lVert v \rVert Q f(T) e_1$,
+	which requires $O(n \cdot \mathrm{deg})$ memory. With `basis='none'`, the recurrence is instead executed twice: once to
+	obtain $T$, and once more to accumulate $f(A)v$ from each Lanczos vector as it is re-computed. This needs only $O(n)$
+	memory, at the cost of twice the matvecs with `A`. Alternatively, `basis='mmap'` keeps the basis in a memory-mapped file.
+	:::
 	"""
 
 	def __init__(
-		self, A: np.ndarray, fun: Optional[Callable] = None, deg: int = 20, orth: int = 3, dtype: np.dtype = F64, **kwargs
+		self,
+		A: np.ndarray,
+		fun: Optional[Callable] = None,
+		deg: int = 20,
+		orth: int = 3,
+		dtype: np.dtype = F64,
+		quad: str = "gw",
+		storage: str = "full",
+		mixed: bool = False,
+		reorth: str = "mgs",
+		basis: str = "full",
+		basis_file: Optional[str] = None,
+		**kwargs,
 	) -> None:
 		assert is_linear_op(A), "Invalid operator `A`; must be dim=2 symmetric operator with defined matvec"
 		assert deg >= 2, "Degree must be >= 2"
 		self.shape = A.shape
 		self.dtype = np.dtype(dtype)
 
-		## Parmaeterize function
+		## Parmaeterize function; builtin functions supplied by name can also be evaluated natively
+		native_fun = (fun, {k: float(v) for k, v in kwargs.items() if isinstance(v, Number)}) if isinstance(fun, str) else None
+		fun_arg = fun
 		fun = fun if fun is not None else lambda x: x
 		fun = param_callable(fun, **kwargs) if isinstance(fun, str) else fun
+		self._engine = None
 		self.fun = fun
+		self._native_fun = native_fun
 
 		self._deg = min(deg, A.shape[0])
-		self._alpha = np.zeros(self._deg + 1, dtype=dtype)
-		self._beta = np.zeros(self._deg + 1, dtype=dtype)
-		self._nodes = np.zeros(self._deg, dtype=dtype)
-		self._weights = np.zeros(self._deg, dtype=dtype)
-
-		# ncv = kwargs.get("ncv", 3)
-		## NOTE: ncv is fixed to deg for matrix function to work
-		## NOTE: todo, change this to not allocate in-case quad is used
-		self._Q = np.zeros((A.shape[0], self._deg), dtype=dtype, order="F")
-		assert self._Q.flags["F_CONTIGUOUS"] and self._Q.flags["WRITEABLE"] and self._Q.flags["OWNDATA"]
 		self._rtol = 1e-8
 		self._orth = self._deg if orth < 0 or orth > self._deg else orth
-		self._A = A
+		self._mixed = bool(mixed)
+		self._arenas = {}
+		self._op = A
+		self._deflation = None
+		self._adaptive = None
+
+		## The native operator owns all of the Lanczos workspace, so repeated matvecs / quads do not re-allocate
+		## NOTE: Q is allocated with ncv columns for quad(), and is only expanded to deg columns on the first matvec
+		## NOTE: CSR matrices use the row-parallel sparse operator; all other sparse formats are converted to CSC
+		## NOTE: dense and sparse matrices are viewed by a persistent native handle, and are not copied unless their dtype differs
+		## NOTE: CSR and upper-triangular matrices are copied once into a native handle, shared by every native call after
+		kind = _operator_kind(A, storage)
+		self._kind = kind
+		self._A = _native_operator(A, self.dtype, storage)
+		ncv = int(np.clip(self._orth + 1, 2, self._deg))
+		engine = getattr(_lanczos, f"MatrixFunction_{kind}_{self.dtype.name}")
+		f_args = native_fun if native_fun is not None else (("identity", {}) if fun_arg is None else (self._fun,))
+		self._engine = engine(self._A, *f_args, self._deg, self._rtol, self._orth, ncv)
+		self._engine.quad = quad
+		self._engine.reorth = reorth
+
+		## The basis of matvecs can be avoided by recomputing it, or kept out of core in a memory-mapped file
+		assert basis in {"full", "none", "mmap"}, f"Invalid basis storage '{basis}'; must be one of 'full', 'none', or 'mmap'."
+		self._engine.two_pass = basis == "none"
+		if basis == "mmap":
+			file = basis_file if basis_file is not None else tempfile.TemporaryFile()
+			self._basis = np.memmap(file, dtype=self.dtype, mode="w+", shape=(A.shape[0], self._deg), order="F")
+			self._engine.set_basis(self._basis)
 
 	@property
 	def degree(self) -> int:
 		return self._deg
 
+	@property
+	def native(self) -> bool:
+		"""Whether quadratic forms of this operator can be evaluated entirely by the native quadrature engine."""
+		return self._native_fun is not None
+
 	@property
 	def fun(self) -> Callable:
 		return self._fun
@@ -95,6 +148,9 @@ class MatrixFunction(LinearOperator):
 		assert isinstance(out, np.ndarray), "Function must return array-like"
 		assert out.shape[-1] == self.shape[0], "Last dimension of output must match number of rows."
 		self._fun = value
+		self._native_fun = None
+		if self._engine is not None:
+			self._engine.set_function(value)
 
 	def _adjoint(self):
 		return self
@@ -110,18 +166,12 @@ class MatrixFunction(LinearOperator):
 		Though mathematically equivalent, this method is computationally distinct from the operation `A.quad(x)`; see `.quad()` for more details.
 		:::
 		"""
-		if self._Q.shape[1] < self._deg:
-			self._Q = np.zeros((self.shape[0], self._deg), dtype=self.dtype, order="F")
-		# self.Q.fill(0)  # this is necessary to prevent orthogonalization
-		self._Q[:, -self._deg :].fill(0)  # this is necessary to prevent NaN's during re-orthogonalization
-		x = x.astype(self.dtype).reshape(-1)
-		x_norm = np.linalg.norm(x)
-		_lanczos.lanczos(self._A, x, self._deg, self._rtol, self._orth, self._alpha, self._beta, self._Q)
-
-		## TODO: call the lapack function with pre-allocated memory for extra speed
-		rw, Y = eigh_tridiag(self._alpha[: self._deg], self._beta[1 : self._deg])  # O(d^2) space
-		# return x_norm * self._Q @ Y @ (self._fun(rw) * Y[0, :])[:, np.newaxis]
-		return x_norm * self._Q @ Y @ (np.atleast_2d(self._fun(rw)) * Y[0, :]).T
+		x = np.ravel(x).astype(self.dtype, copy=False)
+		return self._engine.matvec(x)[:, np.newaxis]
+
+	def _matmat(self, X: np.ndarray):
+		X = np.asarray(X, dtype=self.dtype, order="F")
+		return self._engine.matmat(X)
 
 	def quad(self, x: np.ndarray):
 		r"""Estimates the quadratic form using Lanczos quadrature.
@@ -135,20 +185,457 @@ class MatrixFunction(LinearOperator):
 		which first applies $x \mapsto f(A)x$ and then performs a dot product.
 		:::
 		"""
-		if self._orth < self._Q.shape[1]:
-			self._Q.resize((self.shape[0], self._deg))
-		x = x.astype(self.dtype)
+		x = np.asarray(x, dtype=self.dtype)
+		x = np.atleast_2d(x).T if x.ndim == 1 else x
+		return self._engine.quad(np.asfortranarray(x)).astype(np.float64)
+
+	def _trace_quad(
+		self,
+		nv: int,
+		pdf: str = "rademacher",
+		seed: Union[int, np.random.Generator, None] = None,
+		num_threads: int = 0,
+		block_size: int = 1,
+		mixed: Optional[bool] = None,
+		offset: int = 0,
+	) -> np.ndarray:
+		r"""Samples `nv` quadratic forms $v^T f(A) v$ of isotropic vectors $v$ using the native quadrature engine.
+
+		Probe generation, the Lanczos iterations, and the quadrature rules are all computed natively in parallel over
+		`num_threads` threads (all available, if non-positive). The mean of the returned samples estimates $\mathrm{tr}(f(A))$.
+		If `block_size` > 1, each thread tridiagonalizes blocks of `block_size` probes in lock-step, applying the operator
+		to the whole block at once; this is typically faster for sparse or otherwise bandwidth-bound operators.
+		If `mixed` is `True` (defaults to the operator's setting), single precision operators produce double precision
+		estimates, accumulating the Lanczos reductions and quadrature rules in double precision.
+		If the operator is deflated (see `deflate`), each sample is the exact trace of $f(A)$ over the deflation basis plus
+		the quadratic form of a deflated probe, which is tridiagonalized on the deflated operator. Otherwise, if the degree is
+		adaptive (see `adapt`), each probe is tridiagonalized one at a time up to the degree its quadrature converges at.
+		The probes are those of indices `offset`, ..., `offset + nv - 1` of the generator keyed by `seed`, such that disjoint
+		ranges of the same seed (e.g. one per process, see `trace.hutch_mpi`) partition the probes of a single call.
+		"""
+		assert self.native, "Native quadrature requires the spectral function to be specified by name."
+		if self._adaptive is not None and self._deflation is None:
+			return self._trace_adaptive(nv, pdf=pdf, seed=seed, num_threads=num_threads, mixed=mixed, offset=offset)[0]
+		rng = np.random.default_rng(seed)
+		fun, fun_params = self._native_fun
+		ncv = int(np.clip(self._orth + 1, 2, self._deg))
+		mixed = self._mixed if mixed is None else bool(mixed)
+		estimates = np.zeros(int(nv), dtype=np.float64 if mixed else self.dtype)
+		seed = int(rng.integers(2**31))
+		args = (self._deg, self._rtol, self._orth, ncv, pdf, seed, int(num_threads), int(block_size), self._engine.quad, self._engine.reorth)
+		if self._deflation is not None:
+			defl_ests = np.zeros(self._deflation.shape[1], dtype=estimates.dtype)
+			trace_deflated = getattr(_lanczos, "trace_deflated" + _native_suffix(self._kind))
+			trace_deflated(self._A, fun, fun_params, self._deflation, *args, defl_ests, estimates, self._arena(estimates.dtype), int(offset))
+			return estimates + np.sum(defl_ests)
+		trace_quad = getattr(_lanczos, "trace_quad" + _native_suffix(self._kind))
+		trace_quad(self._A, fun, fun_params, *args, estimates, self._arena(estimates.dtype), int(offset))
+		return estimates
+
+	def adapt(self, step: int = 10, rtol: float = 1e-6, atol: float = 0.0, start: Optional[int] = None) -> "MatrixFunction":
+		r"""Adapts the degree of the native trace estimates of this operator to each probe, up to the operator's degree.
+
+		The Lanczos recurrence of each probe $v$ starts at degree `start` and is resumed in increments of `step` (rather than
+		recomputed), until the quadrature $v^T f(A) v$ changes by at most `atol + rtol * |v^T f(A) v|` between increments,
+		or the Krylov space is exhausted. The degree of the operator thus acts as an upper bound, which only the probes whose
+		quadrature has not converged reach. Used by every subsequent native Girard-Hutchinson estimate (i.e. `hutch`) of
+		this operator, unless it is also deflated; `adapt(0)` restores the fixed degree.
+
+		Parameters:
+			step: number of Lanczos steps per increment; non-positive values disable the adaptive degree.
+			rtol: relative tolerance of the change of the quadrature between increments.
+			atol: absolute tolerance of the change of the quadrature between increments.
+			start: degree of the first quadrature; defaults to `step`.
+
+		Returns:
+			The operator itself, such that it may be chained, e.g. `hutch(MatrixFunction(A, "log", deg=100).adapt())`.
+		"""
+		if step <= 0:
+			self._adaptive = None
+			return self
+		start = int(step) if start is None else int(start)
+		assert start >= 1 and rtol >= 0 and atol >= 0, "The starting degree must be positive, and the tolerances non-negative."
+		self._adaptive = (min(start, self._deg), int(step), float(atol), float(rtol))
+		return self
+
+	def _trace_adaptive(
+		self,
+		nv: int,
+		pdf: str = "rademacher",
+		seed: Union[int, np.random.Generator, None] = None,
+		num_threads: int = 0,
+		mixed: Optional[bool] = None,
+		offset: int = 0,
+	) -> tuple:
+		r"""Samples `nv` quadratic forms $v^T f(A) v$ at the degree each one converges at; see `adapt`.
+
+		Returns the samples and the (int32) degree of the Lanczos recurrence of each one. The probes are those of `_trace_quad`,
+		starting at index `offset`.
+		"""
+		assert self.native, "Native quadrature requires the spectral function to be specified by name."
+		rng = np.random.default_rng(seed)
+		fun, fun_params = self._native_fun
+		start, step, atol, rtol = self._adaptive if self._adaptive is not None else (self._deg, 1, 0.0, 0.0)
+		ncv = int(np.clip(self._orth + 1, 2, self._deg))
+		mixed = self._mixed if mixed is None else bool(mixed)
+		estimates = np.zeros(int(nv), dtype=np.float64 if mixed else self.dtype)
+		degrees = np.zeros(int(nv), dtype=np.int32)
+		seed = int(rng.integers(2**31))
+		args = (self._deg, self._rtol, self._orth, ncv, pdf, seed, int(num_threads), start, step, atol, rtol, self._engine.quad, self._engine.reorth)
+		trace_adaptive = getattr(_lanczos, "trace_adaptive" + _native_suffix(self._kind))
+		trace_adaptive(self._A, fun, fun_params, *args, estimates, degrees, self._arena(estimates.dtype), int(offset))
+		return estimates, degrees
+
+	def deflate(
+		self,
+		k: int = 0,
+		Q: Optional[np.ndarray] = None,
+		which: str = "LA",
+		deg: Optional[int] = None,
+		seed: Union[int, np.random.Generator, None] = None,
+	) -> "MatrixFunction":
+		r"""Deflates the native trace estimates of this operator by `k` extremal Ritz vectors of $A$, or by the columns of `Q`.
+
+		With an orthonormal basis $Q$ and $P = I - QQ^T$, the trace splits as $\mathrm{tr}(f(A)) = \mathrm{tr}(Q^T f(A) Q) + \mathrm{tr}(P f(A) P)$.
+		The former is approximated by Lanczos quadrature, column by column, while the latter is estimated stochastically from
+		deflated probes $Pv$ with the Lanczos method on $PAP$. If $Q$ captures the outlying eigenvalues of $A$, these no longer
+		drive the degree needed by the Krylov spaces nor the variance of the samples. The basis is cached, and used by every
+		subsequent native Girard-Hutchinson estimate (i.e. `hutch`) of this operator until it is replaced; `deflate()` removes it.
+
+		Note the stochastic part estimates $\mathrm{tr}(P f(PAP) P)$, which equals $\mathrm{tr}(P f(A) P)$ only if $Q$ spans an
+		invariant subspace of $A$; otherwise the estimate is biased by the residual $AQ - Q(Q^T A Q)$. The Ritz vectors computed by
+		`deflate(k)` come from a Lanczos run of `deg` steps and are thus only approximately invariant; raise `deg` to reduce
+		this bias.
+
+		Parameters:
+			k: number of Ritz vectors to compute, if `Q` is not given.
+			Q: basis to deflate by, whose columns are orthonormalized; supersedes `k`.
+			which: Ritz values to deflate, either the largest ('LA'), smallest ('SA'), largest in magnitude ('LM'), or both ends ('BE').
+			deg: degree of the (fully re-orthogonalized) Lanczos expansion computing the Ritz pairs; defaults to `4k + 20`.
+			seed: seed of the starting vector of the Lanczos expansion.
+
+		Returns:
+			The operator itself, such that it may be chained, e.g. `hutch(M.deflate(5))`.
+		"""
+		from .lanczos import rayleigh_ritz
+
+		if Q is None and k > 0:
+			assert which in {"LA", "SA", "LM", "BE"}, f"Invalid Ritz values '{which}'; must be one of 'LA', 'SA', 'LM', or 'BE'."
+			n = self.shape[0]
+			deg = min(n, 4 * k + 20 if deg is None else int(deg))
+			assert k <= deg, "The number of Ritz vectors cannot exceed the degree of the Lanczos expansion."
+			rw, Y, V = rayleigh_ritz(self._op, deg=deg, return_eigenvectors=True, return_basis=True, orth=deg, seed=seed)
+			order = {"LA": np.argsort(-rw), "SA": np.argsort(rw), "LM": np.argsort(-np.abs(rw))}
+			if which == "BE":
+				order["BE"] = np.ravel(np.column_stack((np.argsort(-rw), np.argsort(rw))))
+			Q = V @ Y[:, list(dict.fromkeys(order[which]))[:k]]
+		if Q is None or np.shape(Q)[-1] == 0:
+			self._deflation = None
+			return self
+		Q = np.atleast_2d(np.asarray(Q, dtype=np.float64).T).T
+		assert Q.shape[0] == self.shape[0] and Q.shape[1] <= Q.shape[0], "The deflation basis must be an (n x k) array with k <= n."
+		self._deflation = np.asfortranarray(np.linalg.qr(Q)[0], dtype=self.dtype)
+		return self
+
+	def _trace_converge(
+		self,
+		nv: int,
+		criteria: list,
+		estimator: Any,
+		check_every: int = 32,
+		pdf: str = "rademacher",
+		seed: Union[int, np.random.Generator, None] = None,
+		num_threads: int = 0,
+		block_size: int = 1,
+		mixed: Optional[bool] = None,
+	) -> np.ndarray:
+		r"""Samples up to `nv` quadratic forms $v^T f(A) v$ natively, stopping as soon as any of the `criteria` is met.
+
+		As with `_trace_quad`, but the native engine folds the samples into the native `estimator` every `check_every` probes
+		(in probe order) and tests the criteria itself, cancelling the remaining probes once they are met. The criteria are
+		given by the parameters of `ConvergenceCriterion._native_params()`. Returns the samples merged into `estimator`,
+		which carries its state across calls and may thus be re-used to continue sampling with a different seed.
+		"""
+		assert self.native, "Native quadrature requires the spectral function to be specified by name."
+		rng = np.random.default_rng(seed)
+		fun, fun_params = self._native_fun
+		ncv = int(np.clip(self._orth + 1, 2, self._deg))
+		mixed = self._mixed if mixed is None else bool(mixed)
+		estimates = np.zeros(int(nv), dtype=np.float64 if mixed else self.dtype)
+		seed = int(rng.integers(2**31))
+		criteria = [_lanczos.StoppingCriterion(**p) for p in criteria]
+		args = (self._deg, self._rtol, self._orth, ncv, pdf, seed, int(num_threads), int(block_size), self._engine.quad, self._engine.reorth)
+		trace_converge = getattr(_lanczos, "trace_converge" + _native_suffix(self._kind))
+		n = trace_converge(self._A, fun, fun_params, *args, criteria, int(check_every), estimator, estimates, self._arena(estimates.dtype))
+		return estimates[:n]
+
+	def _trace_multi(
+		self,
+		funs: list,
+		nv: int,
+		pdf: str = "rademacher",
+		seed: Union[int, np.random.Generator, None] = None,
+		num_threads: int = 0,
+		block_size: int = 1,
+		mixed: Optional[bool] = None,
+	) -> np.ndarray:
+		r"""Samples the quadratic forms $v^T f_j(A) v$ of `nv` isotropic vectors $v$ for each of the named functions `funs`.
+
+		Each entry of `funs` is a pair (name, params) of a builtin spectral function, e.g. `("exp", {"t": -1.0})`. All of the
+		functions are evaluated on the same quadrature rule of each probe, i.e. from a single run of the Lanczos method.
+		Returns an (nv, len(funs)) array, whose column means estimate $\mathrm{tr}(f_j(A))$. The function of this operator (if
+		any) is not used.
+		"""
+		rng = np.random.default_rng(seed)
+		ncv = int(np.clip(self._orth + 1, 2, self._deg))
+		mixed = self._mixed if mixed is None else bool(mixed)
+		names, params = [str(f) for f, _ in funs], [{k: float(v) for k, v in p.items()} for _, p in funs]
+		estimates = np.zeros((int(nv), len(funs)), dtype=np.float64 if mixed else self.dtype, order="F")
+		seed = int(rng.integers(2**31))
+		args = (self._deg, self._rtol, self._orth, ncv, pdf, seed, int(num_threads), int(block_size), self._engine.quad, self._engine.reorth)
+		trace_quad_multi = getattr(_lanczos, "trace_quad_multi" + _native_suffix(self._kind))
+		trace_quad_multi(self._A, names, params, *args, estimates, self._arena(estimates.dtype))
+		return estimates
+
+	def _trace_rules(
+		self,
+		nv: int,
+		pdf: str = "rademacher",
+		seed: Union[int, np.random.Generator, None] = None,
+		num_threads: int = 0,
+		block_size: int = 1,
+		mixed: Optional[bool] = None,
+	) -> tuple:
+		r"""Computes the quadrature rules (nodes, weights) of `nv` isotropic vectors $v$ using the native quadrature engine.
+
+		Returns two (deg, nv) arrays, the weights of each probe being scaled by its squared norm, such that the quadratic form
+		$v_i^T f(A) v_i$ of any vectorized function $f$ is given by `np.sum(weights[:, i] * f(nodes[:, i]))`.
+		"""
+		rng = np.random.default_rng(seed)
+		ncv = int(np.clip(self._orth + 1, 2, self._deg))
+		mixed = self._mixed if mixed is None else bool(mixed)
+		s_dtype = np.float64 if mixed else self.dtype
+		nodes = np.zeros((self._deg, int(nv)), dtype=s_dtype, order="F")
+		weights = np.zeros((self._deg, int(nv)), dtype=s_dtype, order="F")
+		seed = int(rng.integers(2**31))
+		args = (self._deg, self._rtol, self._orth, ncv, pdf, seed, int(num_threads), int(block_size), self._engine.quad, self._engine.reorth)
+		trace_rules = getattr(_lanczos, "trace_rules" + _native_suffix(self._kind))
+		trace_rules(self._A, *args, nodes, weights, self._arena(nodes.dtype))
+		return nodes, weights
+
+	def _spectral_density(
+		self,
+		grid: np.ndarray,
+		nv: int,
+		kernel: str = "gaussian",
+		bandwidth: float = 0.1,
+		pdf: str = "rademacher",
+		seed: Union[int, np.random.Generator, None] = None,
+		num_threads: int = 0,
+		block_size: int = 1,
+		mixed: Optional[bool] = None,
+	) -> np.ndarray:
+		r"""Estimates the spectral density of the operator on `grid` from the quadrature rules of `nv` isotropic vectors.
+
+		The rule of each probe is smoothed onto the grid with the given `kernel` and `bandwidth` by the thread computing it,
+		such that no rules are stored; see `integrate.spectral_density`.
+		"""
+		rng = np.random.default_rng(seed)
+		ncv = int(np.clip(self._orth + 1, 2, self._deg))
+		mixed = self._mixed if mixed is None else bool(mixed)
+		s_dtype = np.float64 if mixed else self.dtype
+		grid = np.ascontiguousarray(np.ravel(grid), dtype=s_dtype)
+		density = np.zeros(len(grid), dtype=s_dtype)
+		seed = int(rng.integers(2**31))
+		args = (self._deg, self._rtol, self._orth, ncv, pdf, seed, int(num_threads), int(block_size), self._engine.quad, self._engine.reorth)
+		spectral_density = getattr(_lanczos, "spectral_density" + _native_suffix(self._kind))
+		spectral_density(self._A, grid, str(kernel), float(bandwidth), int(nv), *args, density, self._arena(s_dtype))
+		return density
+
+	def _trace_path(
+		self,
+		ts: np.ndarray,
+		nv: int,
+		pdf: str = "rademacher",
+		seed: Union[int, np.random.Generator, None] = None,
+		num_threads: int = 0,
+		block_size: int = 1,
+		mixed: Optional[bool] = None,
+		affine: Optional[Any] = None,
+	) -> np.ndarray:
+		r"""Samples the quadratic forms $v^T f(A + tB) v$ of `nv` isotropic vectors $v$ for every parameter $t$ in `ts`.
+
+		Returns an (nv, len(ts)) array, whose column means estimate $\mathrm{tr}(f(A + tB))$. The same probes are used for every
+		$t$. Unless an affine operator $A + tB$ is supplied as `affine` (see `trace_path`), $B = I$, in which case each probe is
+		tridiagonalized once and only the nodes of its quadrature rule are shifted for each $t$.
+		"""
+		assert self.native, "Native quadrature requires the spectral function to be specified by name."
+		rng = np.random.default_rng(seed)
+		fun, fun_params = self._native_fun
+		ncv = int(np.clip(self._orth + 1, 2, self._deg))
+		mixed = self._mixed if mixed is None else bool(mixed)
+		ts = np.ravel(ts).astype(self.dtype)
+		estimates = np.zeros((int(nv), len(ts)), dtype=np.float64 if mixed else self.dtype, order="F")
+		seed = int(rng.integers(2**31))
+		args = (self._deg, self._rtol, self._orth, ncv, pdf, seed, int(num_threads), int(block_size), self._engine.quad, self._engine.reorth)
+		op, suffix = (self._A, _native_suffix(self._kind)) if affine is None else (affine, "_affine")
+		trace_path = getattr(_lanczos, "trace_path" + suffix)
+		trace_path(op, fun, fun_params, ts, *args, estimates, self._arena(estimates.dtype))
+		return estimates
+
+	def _arena(self, est_dtype: np.dtype):
+		"""Per-thread workspace of the native quadrature engine, re-used across calls accumulating estimates in `est_dtype`."""
+		est_dtype = np.dtype(est_dtype)
+		if est_dtype not in self._arenas:
+			suffix = "" if est_dtype == self.dtype else f"_{est_dtype.name}"
+			self._arenas[est_dtype] = getattr(_lanczos, f"LanczosArena_{self.dtype.name}{suffix}")()
+		return self._arenas[est_dtype]
+
+
+class ChebyshevFunction(LinearOperator):
+	r"""Linear operator class for matrix functions approximated by Chebyshev expansions.
+
+	This class represents the degree-`deg` Chebyshev interpolant $p$ of a spectral function $f$ on an interval $[a, b]$
+	containing the spectrum of $A$, i.e. a `LinearOperator` approximating $f(A) \approx p(A) = \sum_k c_k T_k(B)$, where
+	$B = (2A - (a + b)I) / (b - a)$. Unlike `MatrixFunction`, products and quadratic forms need no Lanczos basis, no
+	reorthogonalization and no inner products between steps: each step of the three-term recurrence is a single matvec
+	over three vectors, so blocks of vectors are expanded with one `matmat` per step.
+
+	Parameters:
+		A: numpy array, sparse matrix, or LinearOperator.
+		fun: spectral function to expand, either by name (see `special.param_callable`) or as a callable.
+		deg: degree of the expansion.
+		bounds: interval $(a, b)$ containing the spectrum of `A`; estimated via `eigsh` (and padded by 1%) if not given.
+		damping: damping of the coefficients; one of 'none' or 'jackson' (suppresses oscillations for non-smooth `fun`).
+		dtype: floating point dtype to execute in. Must be float64 or float32.
+		storage: if 'upper' and `A` is sparse, only the upper triangle of `A` is stored and read.
+		kwargs: parameters of the spectral function, if given by name.
+
+	:::{.callout-note}
+	The coefficients are fit once on construction, which is the only time `fun` is evaluated; callables are thus never
+	called back by the native estimators. The expansion is accurate when `fun` is smooth on `bounds`; eigenvalues outside
+	of `bounds` are not supported, as the Chebyshev polynomials grow rapidly outside of $[-1, 1]$.
+	:::
+	"""
+
+	def __init__(
+		self,
+		A: Union[np.ndarray, LinearOperator],
+		fun: Union[str, Callable, None] = None,
+		deg: int = 50,
+		bounds: Optional[tuple] = None,
+		damping: str = "none",
+		dtype: np.dtype = F64,
+		storage: str = "full",
+		**kwargs,
+	) -> None:
+		assert is_linear_op(A), "Invalid operator `A`; must be dim=2 symmetric operator with defined matvec"
+		assert deg >= 0, "Degree must be non-negative"
+		self.shape = A.shape
+		self.dtype = np.dtype(dtype)
+		self._deg = int(deg)
+		lo, hi = _spectral_bounds(A) if bounds is None else (float(bounds[0]), float(bounds[1]))
+		assert lo < hi, "Invalid spectral bounds; must satisfy lo < hi."
+		self._bounds = (lo, hi)
+
+		kind = _operator_kind(A, storage)
+		self._kind = kind
+		self._A = _native_operator(A, self.dtype, storage)
+		if isinstance(fun, str) or fun is None:
+			fun_params = {k: float(v) for k, v in kwargs.items() if isinstance(v, Number)}
+			f_args = ("identity" if fun is None else fun, fun_params)
+		else:
+			assert callable(fun), "Function must be callable, or the name of a builtin spectral function."
+			f_args = (fun,)
+		engine = getattr(_lanczos, f"ChebyshevFunction_{kind}_{self.dtype.name}")
+		self._engine = engine(self._A, *f_args, self._deg, lo, hi, damping)
+
+	@property
+	def degree(self) -> int:
+		return self._deg
+
+	@property
+	def bounds(self) -> tuple:
+		"""Interval the expansion was fit on."""
+		return self._bounds
+
+	@property
+	def coeffs(self) -> np.ndarray:
+		"""Chebyshev coefficients $c_0, \dots, c_{deg}$ of the expansion."""
+		return self._engine.coeffs
+
+	@property
+	def native(self) -> bool:
+		"""Chebyshev expansions are always evaluated natively, as their function is only evaluated on construction."""
+		return True
+
+	def _adjoint(self):
+		return self
+
+	def _matvec(self, x: np.ndarray) -> np.ndarray:
+		x = np.ravel(x).astype(self.dtype, copy=False)
+		return self._engine.matvec(x)[:, np.newaxis]
+
+	def _matmat(self, X: np.ndarray) -> np.ndarray:
+		X = np.asarray(X, dtype=self.dtype, order="F")
+		return self._engine.matmat(X)
+
+	def quad(self, x: np.ndarray) -> np.ndarray:
+		r"""Estimates the quadratic forms $x^T p(A) x$ of the columns of `x`, using $\lceil deg / 2 \rceil$ matvecs each."""
+		x = np.asarray(x, dtype=self.dtype)
 		x = np.atleast_2d(x).T if x.ndim == 1 else x
-		x = np.array(x, order="F", copy=None)
-		x_norm_sq = np.square(np.linalg.norm(x, axis=0))
-		y = np.zeros(x.shape[1])
-		for j in range(x.shape[1]):
-			xc = x[:, j]
-			x_norm_sq = np.linalg.norm(xc) ** 2
-			_lanczos.lanczos(self._A, xc, self._deg, self._rtol, self._orth, self._alpha, self._beta, self._Q)
-			quadrature(self._alpha, self._beta, deg=self._deg, quad="gw", nodes=self._nodes, weights=self._weights)
-			y[j] = np.sum(self._fun(self._nodes) * self._weights, axis=-1) * x_norm_sq
-		return y
+		return self._engine.quad(np.asfortranarray(x)).astype(np.float64)
+
+	def _trace_quad(
+		self,
+		nv: int,
+		pdf: str = "rademacher",
+		seed: Union[int, np.random.Generator, None] = None,
+		num_threads: int = 0,
+		block_size: int = 1,
+		mixed: Optional[bool] = None,
+		offset: int = 0,
+	) -> np.ndarray:
+		r"""Samples `nv` quadratic forms $v^T p(A) v$ of isotropic vectors $v$ natively, in parallel over `num_threads` threads.
+
+		If `block_size` > 1, each thread expands blocks of `block_size` probes together, applying the operator to the whole
+		block at once. The expansion is evaluated in the operator's dtype, so `mixed` is ignored. As with
+		`MatrixFunction._trace_quad`, the probes are those of indices `offset`, ..., `offset + nv - 1`.
+		"""
+		rng = np.random.default_rng(seed)
+		estimates = np.zeros(int(nv), dtype=self.dtype)
+		self._engine.trace(pdf, int(rng.integers(2**31)), int(num_threads), int(block_size), estimates, int(offset))
+		return estimates
+
+
+def _spectral_bounds(A: Union[np.ndarray, LinearOperator], pad: float = 0.01) -> tuple:
+	"""Estimates an interval containing the spectrum of the symmetric `A` from its extremal eigenvalues, padded by `pad`."""
+	if A.shape[0] < 3:
+		ew = np.linalg.eigvalsh(A @ np.eye(A.shape[0]))
+		lo, hi = ew[0], ew[-1]
+	else:
+		lo = eigsh(A, k=1, which="SA", tol=1e-4, return_eigenvectors=False).item()
+		hi = eigsh(A, k=1, which="LA", tol=1e-4, return_eigenvectors=False).item()
+	width = max(hi - lo, np.abs(hi), np.finfo(np.float32).eps)
+	return (float(lo - pad * width), float(hi + pad * width))
+
+
+def _native_estimator(A: Union[LinearOperator, np.ndarray], name: str, f_dtype: np.dtype) -> Optional[Callable]:
+	"""Returns the native estimator `name` (e.g. 'hutchpp' or 'xdiag') bound to `A`, or None if `A` is not supported natively.
+
+	Native matrix functions are supported if their function was specified by name, as Python callbacks cannot be evaluated
+	concurrently; Chebyshev expansions are always supported. Dense and sparse matrices are viewed through the native operators used by `lanczos`, and Toeplitz
+	operators are applied through their native handle.
+	"""
+	if isinstance(A, MatrixFunction):
+		return getattr(A._engine, name) if A.native else None
+	if isinstance(A, ChebyshevFunction):
+		return getattr(A._engine, name)
+	kind = _operator_kind(A)
+	if kind != "linop":
+		op = _native_operator(A, f_dtype)
+		return partial(getattr(_lanczos, name + _native_suffix(kind)), op)
+	return None
 
 
 ## NOTE: this could act as a nice way of handling keyword arguments in kwargs to generate a MF
@@ -163,28 +650,124 @@ def matrix_function(A: LinearOperator, fun: Optional[Callable] = None, v: Option
 
 ## From: https://www.mathworks.com/matlabcentral/fileexchange/8548-toeplitzmult
 class Toeplitz(LinearOperator):
-	"""Matrix-free operator for representing Toeplitz or circulant matrices."""
+	"""Matrix-free operator for representing Toeplitz or circulant matrices.
+
+	The Toeplitz matrix with first column `c` and first row `r` (defaulting to `c`, i.e. a symmetric Toeplitz matrix) is
+	embedded in a circulant matrix, whose products are computed natively via real-to-complex FFTs. Its spectrum is
+	computed once on construction, and the native routines (e.g. `lanczos`, `hutch`, or `MatrixFunction`) apply it in
+	parallel without calling back into Python.
+	"""
 
 	def __init__(self, c: np.ndarray, r: Optional[np.ndarray] = None, dtype: np.dtype = F64):
-		self.c = np.array(c)
-		self.r = np.array(c if r is None else r)
-		self._d = np.concatenate((self.c, [0], np.flip(self.r[1:])))
-		self._dfft = np.real(np.fft.fft(self._d))
-		self._z = np.zeros(len(c) * 2)  # workspace
-		self.shape = (len(c), len(c))
-		self.dtype = dtype
-
-	## NOTE: We return a copy because the output cannot be a view
+		self.dtype = np.dtype(dtype)
+		assert self.dtype in {np.dtype("float32"), F64}, "Toeplitz operators support only 'float32' or 'float64' dtypes."
+		self.c = np.ravel(c).astype(self.dtype)
+		self.r = self.c.copy() if r is None else np.ravel(r).astype(self.dtype)
+		assert len(self.r) == len(self.c), "The first row 'r' must have the same length as the first column 'c'."
+		self.shape = (len(self.c), len(self.c))
+		self._native = getattr(_lanczos, f"ToeplitzOperator_{self.dtype.name}")(self.c, self.r)
+
 	def _matvec(self, x: np.ndarray) -> np.ndarray:
 		assert len(x) == len(self.c), f"Invalid shape of input vector 'x'; must have length {len(self.c)}"
-		self._z[: self.shape[0]] = x.ravel().astype(self.dtype, copy=False)
-		x_fft = np.fft.fft(self._z)
-		y = np.real(np.fft.ifft(self._dfft * x_fft))
-		return y[: self.shape[0]].astype(self.dtype)
+		return self._native.matvec(np.ravel(x))
+
+	def _matmat(self, X: np.ndarray) -> np.ndarray:
+		return self._native.matmat(np.asarray(X).reshape(self.shape[0], -1))
+
+
+class Composite(LinearOperator):
+	"""Lazy composition of native operators, whose products are computed natively without calling back into Python.
+
+	Composites are built from dense or sparse matrices, Toeplitz operators, or other composites via `composite`, and
+	are closed under scaling (`c * A`, `A / c`, `-A`), sums (`A + B`, `A - B`), products (`A @ B`), shifts (`A.shift(s)`,
+	i.e. $A + sI$) and Gram operators (`A.gram()`, i.e. $A^T A$); none of these form the resulting matrix. Operands that
+	are not supported natively fall back to the arithmetic of SciPy's `LinearOperator`. Since the composites are native
+	operators, `lanczos`, the trace and diagonal estimators and `MatrixFunction` apply them in parallel.
+	"""
+
+	def __init__(self, handle: Any):
+		self._native = handle
+		self.shape = tuple(handle.shape)
+		self.dtype = np.dtype(handle.dtype)
+
+	def _matvec(self, x: np.ndarray) -> np.ndarray:
+		return self._native.matvec(np.ravel(x))
+
+	def _matmat(self, X: np.ndarray) -> np.ndarray:
+		return self._native.matmat(np.asarray(X).reshape(self.shape[1], -1))
+
+	def shift(self, sigma: float) -> "Composite":
+		"""Returns the composite $A + \sigma I$."""
+		return Composite(self._native.shifted(sigma))
+
+	def gram(self) -> "Composite":
+		"""Returns the composite $A^T A$; every operand must support adjoint products (i.e. not be a Toeplitz operator)."""
+		return Composite(self._native.gram())
+
+	def dot(self, x: Any) -> Any:
+		if np.isscalar(x):
+			return Composite(self._native.scaled(x))
+		other = _composite_handle(x, self.dtype) if isinstance(x, LinearOperator) or issparse(x) else None
+		return Composite(self._native.compose(other)) if other is not None else super().dot(x)
+
+	def __rmul__(self, x: Any) -> Any:
+		return Composite(self._native.scaled(x)) if np.isscalar(x) else super().__rmul__(x)
+
+	def __truediv__(self, x: Any) -> Any:
+		return Composite(self._native.scaled(1.0 / x)) if np.isscalar(x) else super().__truediv__(x)
+
+	def __neg__(self) -> "Composite":
+		return Composite(self._native.scaled(-1.0))
+
+	def __add__(self, x: Any) -> Any:
+		other = _composite_handle(x, self.dtype)
+		return Composite(self._native.add(other)) if other is not None else super().__add__(x)
+
+	def __radd__(self, x: Any) -> Any:
+		return self.__add__(x)
+
+	def __sub__(self, x: Any) -> Any:
+		other = _composite_handle(x, self.dtype)
+		return Composite(self._native.add(other.scaled(-1.0))) if other is not None else super().__sub__(x)
+
+
+def _composite_handle(A: Any, dtype: np.dtype) -> Optional[Any]:
+	"""Native composite handle of `A` in the given dtype, or None if `A` is not supported natively."""
+	kind = _operator_kind(A)
+	if kind == "linop":
+		return None
+	elif kind == "composite":
+		return _native_operator(A, dtype)
+	return getattr(_lanczos, f"CompositeOperator_{dtype.name}")(_native_operator(A, dtype, general=True))
+
+
+def composite(A: Union[np.ndarray, LinearOperator], dtype: Optional[np.dtype] = None) -> Composite:
+	"""Lifts a dense or sparse matrix, a Toeplitz operator, or a composite to a (lazy) native composite operator.
+
+	Dense and sparse matrices are viewed rather than copied when their dtype matches (row-major arrays and CSR matrices are
+	copied once). Operands need not be symmetric or square.
+	Integer matrices are lifted in double precision.
+
+	Parameters:
+		A: matrix or operator to compose.
+		dtype: floating point type of the composite; defaults to the dtype of `A`.
+	"""
+	dtype = np.dtype(getattr(A, "dtype", F64) if dtype is None else dtype)
+	dtype = dtype if dtype in {np.dtype("float32"), F64} else F64
+	handle = _composite_handle(A, dtype)
+	assert handle is not None, "Only dense or sparse matrices, Toeplitz operators and composites may be composed natively."
+	return Composite(handle)
 
 
 def normalize_unit(A: LinearOperator, interval: tuple = (-1, 1)) -> LinearOperator:
-	"""Normalizes a linear operator to have its spectra contained in the interval [-1,1]."""
+	"""Normalizes a linear operator to have its spectra contained in the interval [-1,1].
+
+	Operators supported natively (see `composite`) are normalized by a native composite, rather than by SciPy's
+	`LinearOperator` arithmetic.
+	"""
+	if _operator_kind(A) != "linop":
+		alpha = eigsh(A, k=1, which="LM", return_eigenvectors=False).item()
+		return composite(A).shift(alpha) / (2 * alpha)
 	A = aslinearoperator(A) if not isinstance(A, LinearOperator) else A
 	assert isinstance(A, LinearOperator), "A must be a linear operator"
 	alpha = eigsh(A, k=1, which="LM", return_eigenvectors=False).item()
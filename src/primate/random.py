@@ -8,6 +8,8 @@ import numpy as np
 from numpy.random import SeedSequence
 import scipy as sp  # allows for lazy loading
 
+from .lanczos import _lanczos
+
 
 _ISO_DISTRIBUTIONS = {
 	"rademacher": "rademacher",
@@ -97,6 +99,31 @@ def isotropic(
 	# return W
 
 
+def probes(
+	out: np.ndarray,
+	pdf: str = "rademacher",
+	seed: int = 0,
+	offset: int = 0,
+	num_threads: int = 0,
+) -> None:
+	"""Fills the columns of `out` in-place with isotropic probes from the native counter-based generator.
+
+	Column `j` of `out` is set to probe `offset + j` of the Philox generator keyed by `seed`, which depends on nothing but
+	the key and its index. The probes are thus the same for any `num_threads`, and successive calls with advancing offsets
+	fill the same probes as a single call. The native estimators sample their probes from the same generator.
+
+	Parameters:
+		out: float32 or float64 vector or Fortran-contiguous matrix to fill.
+		pdf: Isotropic distribution to sample from. Must be "rademacher", "sphere", or "normal".
+		seed: Non-negative integer key of the generator.
+		offset: Index of the probe written to the first column of `out`.
+		num_threads: Number of threads to fill the columns with; non-positive values use all available.
+	"""
+	assert pdf in _ISO_DISTRIBUTIONS.keys(), f"Invalid distribution '{pdf}' supplied."
+	assert isinstance(out, np.ndarray) and out.dtype.type in {np.float32, np.float64}, "Output must be a float32 or float64 array."
+	_lanczos.isotropic(out, _ISO_DISTRIBUTIONS[pdf], int(seed), 0, int(offset), int(num_threads))
+
+
 class Isotropic:
 	def __init__(
 		self,
@@ -85,6 +85,23 @@ class Covariance(Mean):
 		self.S += (X_centered.T @ X_centered) + (self.n * X.shape[0] / new_n) * X_shift
 		self.n = new_n
 
+	def merge(self, n: int, mu: Union[float, np.ndarray], S: Union[float, np.ndarray]) -> None:
+		"""Merge the statistics of a disjoint set of observations into the estimates.
+
+		Parameters:
+			n: number of observations
+			mu: their sample mean, of shape (dim,)
+			S: their sum of outer products of deviations from `mu`, of shape (dim, dim)
+		"""
+		if n <= 0:
+			return
+		mu, S = np.atleast_1d(mu).astype(np.float64), np.reshape(S, (self.dim, self.dim))
+		delta_mean = mu - self.mu
+		new_n = self.n + n
+		self.mu += (n / new_n) * delta_mean
+		self.S += S + (self.n * n / new_n) * np.outer(delta_mean, delta_mean)
+		self.n = new_n
+
 	covariance = __call__
 
 
@@ -4,6 +4,7 @@ from itertools import islice
 from typing import Callable, Generator, Iterable, Optional, Union
 
 import numpy as np
+from scipy.sparse import csc_array, issparse
 from scipy.sparse.linalg import LinearOperator
 
 from .estimators import (
@@ -12,11 +13,14 @@ from .estimators import (
 	CountCriterion,
 	EstimatorResult,
 	MeanEstimator,
+	arr_summary,
 	convergence_criterion,
 )
+from .lanczos import _lanczos, _phase_stats
 from .linalg import update_trinv
-from .operators import is_valid_operator
-from .random import isotropic
+from .operators import ChebyshevFunction, MatrixFunction, _native_estimator, is_valid_operator
+from .random import isotropic, probes
+from .special import param_callable
 
 
 ## TODO: should return views when possible
@@ -31,6 +35,15 @@ def _chunk(iterable: Iterable, n: int) -> Generator:
 			yield batch
 
 
+def _hutch_criterion(converge: Union[str, ConvergenceCriterion], **kwargs) -> ConvergenceCriterion:
+	"""Parameterizes the convergence criterion of `hutch`, the default being `CountCriterion(200) | ConfidenceCriterion(0.95)`."""
+	if isinstance(converge, str) and converge == "default":
+		cc1 = CountCriterion(count=200)
+		cc2 = ConfidenceCriterion(confidence=0.95, atol=1.0, rtol=0.0)
+		return cc1 | cc2
+	return convergence_criterion(converge, **kwargs)
+
+
 def hutch(
 	A: Union[LinearOperator, np.ndarray],
 	batch: int = 32,
@@ -62,6 +75,19 @@ def hutch(
 		callback: Optional callable to execute after each batch of samples.
 		**kwargs: Additional keyword arguments to parameterize the convergence criterion.
 
+	:::{.callout-note}
+	If `A` is a `MatrixFunction` whose function was specified by name (e.g. `fun="log"`) and `pdf` is a string, each batch
+	of probes is sampled and evaluated by the native quadrature engine in parallel. The number of threads used can be set
+	with the `num_threads` keyword argument (defaults to all available). Setting the `block_size` keyword argument > 1
+	tridiagonalizes probes in blocks which share each application of the operator. Setting `mixed=True` evaluates a
+	single precision operator in mixed precision, accumulating the Lanczos reductions and quadratures in double precision.
+	Unless a `callback` is given, criteria built from the count, tolerance and confidence criteria (e.g. the default) are
+	then tested by the native engine itself after every `batch` probes, which cancels the outstanding probes once met.
+	Chebyshev expansions (`ChebyshevFunction`) are sampled natively in the same way, though their criteria are tested here.
+	Otherwise, probes of named distributions are filled in-place by the native counter-based generator (see `probes`).
+	Either way, the probes depend only on `seed` and their index, and not on the number of threads.
+	:::
+
 	Returns:
 		Estimate the trace of $f(A)$. If `info = True`, additional information about the computation is also returned.
 
@@ -81,41 +107,168 @@ def hutch(
 	"""
 	f_dtype = is_valid_operator(A)
 	N: int = A.shape[0]
+	phases = _phase_stats()
 
 	## Parameterize the various quantities
 	rng = np.random.default_rng(seed)
-	pdf = isotropic(pdf=pdf, seed=rng) if isinstance(pdf, str) else pdf
+	native = isinstance(A, (MatrixFunction, ChebyshevFunction)) and A.native and isinstance(pdf, str)
+	num_threads, block_size = kwargs.pop("num_threads", 0), kwargs.pop("block_size", 1)
+	mixed = kwargs.pop("mixed", None)
 	estimator = MeanEstimator(covariance=True, record=kwargs.pop("record", False))
-	if converge == "default":
-		cc1 = CountCriterion(count=200)
-		cc2 = ConfidenceCriterion(confidence=0.95, atol=1.0, rtol=0.0)
-		converge = cc1 | cc2
-	else:
-		converge = convergence_criterion(converge, **kwargs)
+	converge = _hutch_criterion(converge, **kwargs)
 	# quad_form = (lambda v: A.quad(v)) if hasattr(A, "quad") else (lambda v: (v.T @ (A @ v)).item())
 	# quad_form = (lambda v: A.quad(v)) if hasattr(A, "quad") else (lambda v: np.diag(np.atleast_2d((v.T @ (A @ v)))))
 	quad_form = (lambda v: A.quad(v)) if hasattr(A, "quad") else (lambda v: np.einsum("...i,...i->...", v.T, (A @ v).T))
 
+	## Native matrix functions sample, tridiagonalize, and integrate each batch of probes in parallel
+	fixed_deg = native and isinstance(A, MatrixFunction) and A._deflation is None and A._adaptive is None
+	criteria = converge._native_params() if fixed_deg and callback is None else None
+	if native:
+		sample = lambda nv: A._trace_quad(nv, pdf=pdf, seed=rng, num_threads=num_threads, block_size=block_size, mixed=mixed)
+	elif isinstance(pdf, str):
+		## Named distributions are sampled in-place into a re-used buffer by the native counter-based generator
+		W, key, offset = np.empty((N, batch), dtype=f_dtype, order="F"), int(rng.integers(2**63 - 1)), 0
+
+		def sample(nv: int):
+			nonlocal offset
+			probes(W[:, :nv], pdf=pdf, seed=key, offset=offset, num_threads=num_threads)
+			offset += nv
+			return quad_form(W[:, :nv])
+	else:
+		sample = lambda nv: quad_form(pdf(size=(N, nv)).astype(f_dtype))
+
 	## Catch degenerate case
 	if np.prod(A.shape) == 0:
 		return 0.0 if not full else (0.0, EstimatorResult(estimator, converge))
 
+	## Native criteria are tested by the engine every batch, which stops sampling as soon as they are met
+	if criteria is not None:
+		counts = [p["count"] for p in criteria if p["kind"] == "count"]
+		native_est = _lanczos.MeanEstimator()
+		while not converge(estimator):
+			nv = max(min(counts) - len(estimator), batch) if len(counts) > 0 else 64 * batch
+			samples = A._trace_converge(nv, criteria, native_est, batch, pdf, rng, num_threads, block_size, mixed)
+			for i in range(0, len(samples), batch):
+				estimator.update(samples[i : i + batch])
+			if len(samples) == 0:
+				break
+		if full:
+			result = EstimatorResult(estimator, converge)
+			result.message = converge.message(estimator)
+			result.stats = _phase_stats(phases)
+			return (estimator.estimate, result)
+		return estimator.estimate
+
 	## Commence the Monte-Carlo iterations
 	if full or callback is not None:
 		result = EstimatorResult(estimator, converge)
 		callback = (lambda x: x) if callback is None else callback
 		while not converge(estimator):
-			v = pdf(size=(N, batch)).astype(f_dtype)
-			estimator.update(quad_form(v))
+			estimator.update(sample(batch))
 			callback(result)
 		result.message = converge.message(estimator)
+		result.stats = _phase_stats(phases)
 		return (estimator.estimate, result)
 	else:
 		while not converge(estimator):
-			estimator.update(quad_form(pdf(size=(N, 1)).astype(f_dtype)))
+			estimator.update(sample(batch if native else 1))
 		return estimator.estimate
 
 
+def _merge_stats(stats: Iterable) -> tuple:
+	"""Merges the sufficient statistics (count, mean, sum of squared deviations) of disjoint sets of samples, in order."""
+	n, mu, m2 = 0, 0.0, 0.0
+	for n_i, mu_i, m2_i in stats:
+		if n_i <= 0:
+			continue
+		delta, new_n = mu_i - mu, n + n_i
+		mu += (n_i / new_n) * delta
+		m2 += m2_i + (n * n_i / new_n) * delta * delta
+		n = new_n
+	return n, mu, m2
+
+
+def hutch_mpi(
+	A: Union[MatrixFunction, ChebyshevFunction],
+	comm=None,
+	batch: int = 32,
+	pdf: str = "rademacher",
+	converge: Union[str, ConvergenceCriterion] = "default",
+	seed: Union[int, np.random.Generator, None] = None,
+	full: bool = False,
+	**kwargs,
+) -> Union[float, tuple]:
+	r"""Estimates the trace of $f(A)$ via the Girard-Hutchinson estimator, dividing the probes among the processes of `comm`.
+
+	Each process (rank) samples and evaluates its probes with the native engine of `A`, in parallel over its own threads.
+	The probes are sampled in rounds of `batch` probes per rank: in round $j$, rank $r$ of $p$ evaluates the probes of
+	indices $(jp + r) b, \dots, (jp + r + 1) b - 1$ of the counter-based generator keyed by `seed` (which is broadcast
+	from rank 0), so that the ranks never sample the same probe and the $i$-th probe does not depend on $p$. After each
+	round, the ranks exchange the sufficient statistics (count, mean and sum of squared deviations) of their samples,
+	which every rank merges in rank order into its estimator. All ranks thus hold the same estimate, test `converge` on it,
+	and stop after the same round, without exchanging the samples themselves.
+
+	:::{.callout-note}
+	The communicator defaults to `MPI.COMM_WORLD` of `mpi4py`, which is then required; any object with mpi4py's `Get_rank`,
+	`Get_size`, `bcast` and `allgather` methods may be supplied instead. This function is collective: every rank of `comm`
+	must call it with the same arguments.
+	:::
+
+	Parameters:
+		A: `MatrixFunction` or `ChebyshevFunction` whose function was specified by name.
+		comm: MPI communicator (intra-communicator) to divide the probes among.
+		batch: Number of probes each rank samples per round.
+		pdf: Name of the zero-centered distribution to sample probes from.
+		converge: Convergence criterion to test for estimator convergence, as in `hutch`.
+		seed: Seed to initialize the `rng` entropy source of rank 0.
+		full: Whether to return additional information about the computation.
+		**kwargs: Additional keyword arguments to parameterize the convergence criterion, or the `num_threads`, `block_size`
+			and `mixed` arguments of the native engine.
+
+	Returns:
+		Estimate of the trace of $f(A)$, on every rank. If `full = True`, an `EstimatorResult` is also returned, whose `info`
+		holds the number of ranks and rounds, and whose `stats` are those of the calling rank.
+	"""
+	if not (isinstance(A, (MatrixFunction, ChebyshevFunction)) and A.native and isinstance(pdf, str)):
+		raise ValueError("Distributed estimation requires a native MatrixFunction or ChebyshevFunction and a named `pdf`.")
+	if comm is None:
+		try:
+			from mpi4py import MPI
+		except ImportError as e:
+			raise ImportError("Distributed estimation requires `mpi4py` unless a communicator is supplied.") from e
+		comm = MPI.COMM_WORLD
+	rank, size = comm.Get_rank(), comm.Get_size()
+	phases = _phase_stats()
+	num_threads, block_size = kwargs.pop("num_threads", 0), kwargs.pop("block_size", 1)
+	mixed = kwargs.pop("mixed", None)
+	estimator = MeanEstimator(covariance=True)
+	converge = _hutch_criterion(converge, **kwargs)
+	batch = max(1, int(batch))
+
+	## All ranks sample from the stream of the same key, drawn by the root
+	key = int(np.random.default_rng(seed).integers(2**31)) if rank == 0 else None
+	key = comm.bcast(key, root=0)
+
+	n_rounds = 0
+	while np.prod(A.shape) > 0 and not converge(estimator):
+		offset = (n_rounds * size + rank) * batch
+		samples = A._trace_quad(batch, pdf=pdf, seed=key, num_threads=num_threads, block_size=block_size, mixed=mixed, offset=offset)
+		samples = samples.astype(np.float64)
+		mu = float(np.mean(samples))
+		stats = comm.allgather((len(samples), mu, float(np.sum(np.square(samples - mu)))))
+		estimator.merge(*_merge_stats(stats))
+		n_rounds += 1
+
+	if full:
+		result = EstimatorResult(estimator, converge)
+		result.message = converge.message(estimator)
+		result.nit = n_rounds
+		result.info = dict(ranks=size, rounds=n_rounds)
+		result.stats = _phase_stats(phases)  # of this rank
+		return (estimator.estimate if len(estimator) > 0 else 0.0, result)
+	return estimator.estimate if len(estimator) > 0 else 0.0
+
+
 def hutchpp(
 	A: Union[LinearOperator, np.ndarray],
 	m: Optional[int] = None,
@@ -124,6 +277,7 @@ def hutchpp(
 	pdf: Union[str, Callable] = "rademacher",
 	seed: Union[int, np.random.Generator, None] = None,
 	full: bool = False,
+	num_threads: int = 0,
 ) -> Union[float, dict]:
 	"""Hutch++ estimator.
 
@@ -131,13 +285,23 @@ def hutchpp(
 		A: Matrix or LinearOperator to estimate the trace of.
 		m: number of matvecs to use. If not given, defaults to `n // 3`.
 		batch: currently unused.
+		num_threads: Number of threads used by the native estimator (all available, if non-positive).
+
+	:::{.callout-note}
+	If `A` is a dense or sparse matrix or a `MatrixFunction` whose function was specified by name, and `pdf` is a string,
+	the estimator is evaluated natively: the sketch is formed with the native operator's `matmat` (or in parallel over its
+	columns, for matrix functions), orthogonalized by a Householder QR, and the deflated residual probes are evaluated by
+	the multithreaded quadrature engine.
+	:::
 	"""
 	f_dtype = is_valid_operator(A)
 	N: int = A.shape[0]
+	phases = _phase_stats()
 
 	## Parameterize the random vector generation
 	rng = np.random.default_rng(seed)
-	pdf = isotropic(pdf=pdf, seed=rng)
+	native = _native_estimator(A, "hutchpp", f_dtype) if isinstance(pdf, str) else None
+	pdf = isotropic(pdf=pdf, seed=rng) if native is None else pdf
 
 	## Prepare quadratic form evaluator
 	# quad_form = (lambda v: A.quad(v)) if hasattr(A, "quad") else (lambda v: (v.T @ (A @ v)).item())
@@ -153,23 +317,27 @@ def hutchpp(
 	# maxiter: int = (N // 3) if maxiter == "auto" else int(maxiter)  # residual samples; default rule uses Hutch++ result
 	# assert nb % 3 == 0, "Number of samples must be divisible by 3"
 
-	## Sketch Y / Q - use numpy for now, but consider parallelizing MGS later
-	WB = pdf(size=(N, nb)).astype(f_dtype)
-	Q = np.linalg.qr(A @ WB, mode="reduced")[0]
-
-	## Estimate trace of the low-rank sketch
-	## Full mode may not be space efficient, but is potentially vectorized, so suitable for relatively small output dimen.
-	## Uses at most O(n) memory, but potentially slower
-	## https://stackoverflow.com/questions/18541851/calculate-vt-a-v-for-a-matrix-of-vectors-v
-	# np.einsum("...i,...i->...", V.T, A.dot(V).T)
-	# np.einsum("...i,...i->...", v.T, (A @ v).T) # should one works even for n x 1
-	rng_ests = np.einsum("...i,...i->...", A @ Q, Q) if mode == "full" else np.array([quad_form(q) for q in Q.T])
+	if native is not None:
+		## Both phases are computed natively; the sketch basis is only ever formed in native memory
+		rng_ests, defl_ests = native(nb, nb, pdf, int(rng.integers(2**31)), int(num_threads))
+	else:
+		## Sketch Y / Q - use numpy for now, but consider parallelizing MGS later
+		WB = pdf(size=(N, nb)).astype(f_dtype)
+		Q = np.linalg.qr(A @ WB, mode="reduced")[0]
+
+		## Estimate trace of the low-rank sketch
+		## Full mode may not be space efficient, but is potentially vectorized, so suitable for relatively small output dimen.
+		## Uses at most O(n) memory, but potentially slower
+		## https://stackoverflow.com/questions/18541851/calculate-vt-a-v-for-a-matrix-of-vectors-v
+		# np.einsum("...i,...i->...", V.T, A.dot(V).T)
+		# np.einsum("...i,...i->...", v.T, (A @ v).T) # should one works even for n x 1
+		rng_ests = np.einsum("...i,...i->...", A @ Q, Q) if mode == "full" else np.array([quad_form(q) for q in Q.T])
+
+		## Estimate trace of the residual on the deflated subspaces
+		G = pdf(size=(N, nb)).astype(f_dtype)
+		G -= Q @ (Q.T @ G)
+		defl_ests = np.einsum("...i,...i->...", A @ G, G)  # [(g @ A @ g) for g in G[g_1, g_2, ..., g_nb]]
 	tr_rng = np.sum(rng_ests)
-
-	## Estimate trace of the residual on the deflated subspaces
-	G = pdf(size=(N, nb)).astype(f_dtype)
-	G -= Q @ (Q.T @ G)
-	defl_ests = np.einsum("...i,...i->...", A @ G, G)  # [(g @ A @ g) for g in G[g_1, g_2, ..., g_nb]]
 	tr_defl = (1 / nb) * np.sum(defl_ests)
 
 	if not full:
@@ -179,6 +347,7 @@ def hutchpp(
 		result.estimate = tr_rng + tr_defl
 		result.nit = 2 * nb
 		result.samples = np.concatenate([rng_ests, defl_ests])
+		result.stats = _phase_stats(phases)
 		return result.estimate, result
 
 
@@ -254,6 +423,13 @@ def xtrace(
 		callback: Optional callable to execute after each batch of samples.
 		**kwargs: Additional keyword arguments to parameterize the convergence criterion.
 
+	:::{.callout-note}
+	If `A` is a dense or sparse matrix or a `MatrixFunction` whose function was specified by name, and `pdf` is a string,
+	the sketch and its QR are computed natively (see `hutchpp`), using `num_threads` threads (keyword argument). The sketches
+	are then grown geometrically rather than by `batch` vectors at a time, each being re-computed from the same seed, such
+	that the total number of matvecs is at most twice that of the final sketch.
+	:::
+
 	Returns:
 		Estimate the trace of `A`. If `info = True`, additional information about the computation is also returned.
 	"""
@@ -265,6 +441,8 @@ def xtrace(
 	n = A.shape[0]
 	callback = (lambda result: ...) if not callable(callback) else callback
 	record = kwargs.pop("record", False)
+	num_threads = kwargs.pop("num_threads", 0)
+	native = _native_estimator(A, "xtrace", is_valid_operator(A)) if isinstance(pdf, str) else None
 	estimator = MeanEstimator(record=record)
 
 	## Parameterize the convergence criteria
@@ -284,9 +462,19 @@ def xtrace(
 
 	## Commence the batch-iterations
 	result = EstimatorResult()
+	phases = _phase_stats()
 	rng = np.random.default_rng(seed)
+	if native is not None:
+		## The native sketches of a given seed are nested, so doubling them yields the same samples as extending them
+		native_seed, m = int(rng.integers(2**31)), 0
+		while not converge(estimator) and m < n:
+			m = min(n, m + max(int(batch), m))
+			t_samples = native(m, pdf, native_seed, int(num_threads))
+			estimator = MeanEstimator(record=record)
+			estimator.update(t_samples)
+			callback(result)
 	pdf = isotropic(pdf=pdf, seed=rng) if isinstance(pdf, str) else pdf
-	while not converge(estimator):
+	while native is None and not converge(estimator):
 		## Determine number of new sample vectors to generate
 		ns = min(A.shape[1] - W.shape[1], int(batch))
 
@@ -312,4 +500,127 @@ def xtrace(
 	result.estimator = estimator
 	result.estimate = estimator.estimate
 	result.criterion = converge
+	result.stats = _phase_stats(phases)
 	return (result.estimate, result) if full else result.estimate
+
+
+def trace_path(
+	A: Union[LinearOperator, np.ndarray],
+	ts: np.ndarray,
+	fun: str = "log",
+	B: Union[LinearOperator, np.ndarray, None] = None,
+	nv: int = 100,
+	pdf: str = "rademacher",
+	seed: Union[int, np.random.Generator, None] = None,
+	full: bool = False,
+	num_threads: int = 0,
+	block_size: int = 1,
+	**kwargs: dict,
+) -> Union[np.ndarray, tuple]:
+	r"""Estimates the traces $\mathrm{tr}(f(A + tB))$ along a path of parameters $t$, re-using the Lanczos work across $t$.
+
+	Every trace along the path is estimated by stochastic Lanczos quadrature from the same `nv` probes. If `B` is not given,
+	$B = I$: the Lanczos tridiagonal of $A + tI$ is that of $A$ shifted by $t$, so each probe is tridiagonalized just once,
+	and the nodes of its quadrature rule are shifted for each $t$. Estimating the whole path thus costs about as much as
+	estimating a single trace, e.g. of $\log\det(K + tI)$ over a grid of regularization parameters $t$. Otherwise, `A` and `B`
+	must be dense or sparse matrices. Their products are then fused as $Ax + t(Bx)$, and the probes and workspaces are reused across $t$.
+
+	Parameters:
+		A: real symmetric matrix, linear operator, or `MatrixFunction` whose function was specified by name.
+		ts: parameters $t$ of the path.
+		fun: name of the spectral function to apply, if `A` is not a `MatrixFunction`.
+		B: real symmetric matrix to shift `A` by. Defaults to the identity.
+		nv: number of probe vectors to sample.
+		pdf: isotropic distribution to sample probes from.
+		seed: seed to initialize the `rng` entropy source.
+		full: whether to also return additional information about the computation.
+		num_threads: number of threads to use; non-positive values use all available.
+		block_size: number of probes to tridiagonalize simultaneously per thread.
+		**kwargs: additional keyword arguments to parameterize the `MatrixFunction` with, e.g. `deg` or `orth`.
+
+	Returns:
+		Estimates of the traces for each parameter in `ts`. If `full = True`, an `EstimatorResult` whose `info` holds the
+		(nv, len(ts)) array of `samples` and the standard errors (`stderr`) of the estimates is also returned.
+	"""
+	ts = np.atleast_1d(ts).ravel()
+	M = A if isinstance(A, MatrixFunction) else MatrixFunction(A, fun=fun, **kwargs)
+	assert M.native, "The spectral function must be specified by name."
+	affine = None
+	if B is not None:
+		assert isinstance(A, np.ndarray) or issparse(A), "Paths along general B require `A` to be a dense or sparse matrix."
+		assert B.shape == A.shape, "`A` and `B` must have the same shape."
+		A_csc, B_csc = csc_array(A, dtype=M.dtype), csc_array(B, dtype=M.dtype)
+		affine = getattr(_lanczos, f"AffineOperator_{M.dtype.name}")(A_csc, B_csc)
+	phases = _phase_stats()
+	samples = M._trace_path(ts, nv, pdf=pdf, seed=seed, num_threads=num_threads, block_size=block_size, affine=affine)
+	estimates = np.mean(samples, axis=0)
+	if not full:
+		return estimates
+	stderr = np.std(samples, axis=0, ddof=1) / np.sqrt(samples.shape[0]) if nv > 1 else np.full(len(ts), np.inf)
+	info = EstimatorResult(estimate=estimates, nit=int(nv), info={"samples": samples, "stderr": stderr})
+	info.message = f"Est: {arr_summary(estimates)} (#S:{nv}, #t:{len(ts)})"
+	info.stats = _phase_stats(phases)
+	return estimates, info
+
+
+def spectral_sums(
+	A: Union[LinearOperator, np.ndarray],
+	funs: list,
+	nv: int = 100,
+	pdf: str = "rademacher",
+	seed: Union[int, np.random.Generator, None] = None,
+	full: bool = False,
+	num_threads: int = 0,
+	block_size: int = 1,
+	**kwargs: dict,
+) -> Union[np.ndarray, tuple]:
+	r"""Jointly estimates the spectral sums $\mathrm{tr}(f_1(A)), \dots, \mathrm{tr}(f_m(A))$ from a single Lanczos run per probe.
+
+	The quadrature rule (nodes and weights) of each probe in stochastic Lanczos quadrature does not depend on $f$, so any
+	number of spectral functions can be evaluated on the same rules, at the cost of estimating a single trace. For example,
+	$\log\det(A)$, $\mathrm{tr}(A^{-1})$ and the heat kernel trace $\mathrm{tr}(e^{-A})$ can be estimated together with
+	`funs=["log", "inv", ("exp", {"t": -1.0})]`. As the estimates share their probes, their errors are correlated; their joint
+	covariance is estimated from the samples.
+
+	:::{.callout-note}
+	If every function is given by name, the functions are evaluated by the native quadrature engine in parallel. Otherwise,
+	the engine returns the quadrature rules of all probes, on which the (vectorized) functions are then evaluated in Python.
+	:::
+
+	Parameters:
+		A: real symmetric matrix, linear operator, or `MatrixFunction` (whose function is not used).
+		funs: spectral functions, each either the name of a builtin function, a pair (name, params), or a vectorized callable.
+		nv: number of probe vectors to sample.
+		pdf: isotropic distribution to sample probes from.
+		seed: seed to initialize the `rng` entropy source.
+		full: whether to also return additional information about the computation.
+		num_threads: number of threads to use; non-positive values use all available.
+		block_size: number of probes to tridiagonalize simultaneously per thread.
+		**kwargs: additional keyword arguments to parameterize the `MatrixFunction` with, e.g. `deg` or `orth`.
+
+	Returns:
+		Estimates of the spectral sums of each function in `funs`. If `full = True`, an `EstimatorResult` is also returned,
+		whose (multivariate) estimator holds the samples' covariance, and whose `info` holds the (nv, len(funs)) array of
+		`samples` and the `covariance` of the estimates.
+	"""
+	M = A if isinstance(A, MatrixFunction) else MatrixFunction(A, **kwargs)
+	funs = [(f, {}) if isinstance(f, str) else f for f in funs]
+	assert len(funs) > 0 and all(isinstance(f, tuple) or callable(f) for f in funs), "Functions must be names, pairs, or callables."
+	opts = dict(pdf=pdf, seed=seed, num_threads=num_threads, block_size=block_size)
+	phases = _phase_stats()
+	if all(isinstance(f, tuple) for f in funs):
+		samples = M._trace_multi(funs, nv, **opts)
+	else:
+		nodes, weights = M._trace_rules(nv, **opts)
+		funs = [param_callable(f[0], **f[1]) if isinstance(f, tuple) else f for f in funs]
+		samples = np.column_stack([np.sum(weights * f(nodes), axis=0) for f in funs])
+	estimator = MeanEstimator(dim=samples.shape[1], covariance=True)
+	estimator.update(samples)
+	estimates = np.atleast_1d(estimator.estimate)
+	if not full:
+		return estimates
+	covariance = np.atleast_2d(estimator._cov()) / samples.shape[0]
+	info = EstimatorResult(estimator, estimate=estimates, nit=int(nv), info={"samples": samples, "covariance": covariance})
+	info.message = f"Est: {arr_summary(estimates)} (#S:{nv}, #f:{len(funs)})"
+	info.stats = _phase_stats(phases)
+	return estimates, info
@@ -34,6 +34,34 @@ def test_xdiag():
 	assert m < -0.10, "Error is not decreasing appreciably"
 
 
+def test_diag_native():
+	from primate.operators import MatrixFunction
+	from primate.random import symmetric
+
+	rng = np.random.default_rng(1234)
+	n = 60
+	ew = rng.uniform(size=n, low=0.5, high=2.0)
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+	U = np.linalg.eigh(A)[1]
+
+	## Fixed seeds and thread counts reproduce the same (merged) accumulations
+	## Counts are of probes, as in Python, so the last batch is cut to the probes remaining
+	d1, info = diag(A, converge="count", count=1000, seed=1234, full=True, batch=64, num_threads=3)
+	d2 = diag(A, converge="count", count=1000, seed=1234, batch=64, num_threads=3)
+	assert np.allclose(d1, d2) and info.nit == 1000 and len(info.estimator) == 1000
+	assert info.info["variance"].shape == (n,) and np.all(info.info["variance"] >= 0)
+	assert np.max(np.abs(d1 - A.diagonal())) <= 0.25
+
+	## Matrix functions are applied via the Lanczos method
+	M = MatrixFunction(A, fun="log", deg=20, orth=5)
+	d = diag(M, converge="count", count=20, seed=1234, batch=64, num_threads=2)
+	assert np.max(np.abs(d - np.diag(U @ np.diag(np.log(ew)) @ U.T))) <= 0.25
+
+	## XDiag with a full sketch is accurate up to its leave-one-out correction
+	d = xdiag(M, m=2 * n, seed=1234, num_threads=2)
+	assert np.allclose(d, np.diag(U @ np.diag(np.log(ew)) @ U.T), atol=0.1)
+
+
 # def test_diagonal():
 # 	rng = np.random.default_rng(1234)
 # 	A = rng.normal(size=(50, 50))
@@ -32,3 +32,160 @@ def test_rayleigh():
 
 	rw, rv = rayleigh_ritz(A, 20, v0=v0, return_eigenvectors=True)
 	assert np.allclose(rv.T @ rv, np.eye(len(rw))), "Rayleigh vectors not orthogonal"
+
+
+def test_lanczos_batch():
+	rng = np.random.default_rng(seed=1234)
+	A = symmetric(50, seed=rng)
+	V = rng.uniform(size=(A.shape[1], 6), low=-1, high=1)
+	for orth in [0, 3]:
+		a, b = lanczos(A, v0=V, deg=20, orth=orth)
+		assert a.shape == (6, 20) and b.shape == (6, 19)
+		for j in range(V.shape[1]):
+			aj, bj = lanczos(A, v0=V[:, j], deg=20, orth=orth)
+			assert np.allclose(a[j], aj) and np.allclose(b[j], bj)
+
+
+def test_lanczos_csr():
+	from scipy.sparse import csc_array, csr_array
+
+	rng = np.random.default_rng(seed=1234)
+	A = symmetric(50, seed=rng)
+	A[np.abs(A) < 0.05] = 0.0
+	v = rng.uniform(size=A.shape[1], low=-1, high=1)
+	V = rng.uniform(size=(A.shape[1], 4), low=-1, high=1)
+	a, b = lanczos(A, v0=v, deg=20, orth=3)
+	a_blk, b_blk = lanczos(A, v0=V, deg=20, orth=3)
+	for S in [csr_array(A), csc_array(A)]:
+		aS, bS = lanczos(S, v0=v, deg=20, orth=3)
+		assert np.allclose(a, aS) and np.allclose(b, bS)
+		aS, bS = lanczos(S, v0=V, deg=20, orth=3)
+		assert np.allclose(a_blk, aS) and np.allclose(b_blk, bS)
+
+
+def test_lanczos_upper_storage():
+	from scipy.sparse import csc_array, triu
+
+	rng = np.random.default_rng(seed=1234)
+	A = symmetric(50, seed=rng)
+	A[np.abs(A) < 0.05] = 0.0
+	v = rng.uniform(size=A.shape[1], low=-1, high=1)
+	a, b = lanczos(A, v0=v, deg=20, orth=3)
+	for S in [csc_array(A), triu(csc_array(A), format="csc")]:
+		aS, bS = lanczos(S, v0=v, deg=20, orth=3, storage="upper")
+		assert np.allclose(a, aS) and np.allclose(b, bS)
+
+
+def test_lanczos_mixed():
+	from scipy.sparse import csr_array
+
+	rng = np.random.default_rng(seed=1234)
+	A = symmetric(50, seed=rng)
+	A[np.abs(A) < 0.05] = 0.0
+	v = rng.uniform(size=A.shape[1], low=-1, high=1)
+	a, b = lanczos(A, v0=v, deg=20, orth=3)
+	for S in [A.astype(np.float32), csr_array(A.astype(np.float32))]:
+		aS, bS = lanczos(S, v0=v, deg=20, orth=3, mixed=True)
+		assert aS.dtype == np.float64 and bS.dtype == np.float64
+		assert np.allclose(a, aS, atol=1e-4) and np.allclose(b, bS, atol=1e-4)
+		aS, bS = lanczos(S, v0=np.c_[v, v], deg=20, orth=3, mixed=True)
+		assert aS.dtype == np.float64 and np.allclose(aS[0], a, atol=1e-4) and np.allclose(aS[0], aS[1])
+
+
+def test_lanczos_cgs2():
+	rng = np.random.default_rng(seed=1234)
+	d = 50
+	A = symmetric(d, seed=rng)
+	v0 = rng.uniform(size=A.shape[1])
+	a, b = lanczos(A, v0=v0, deg=d, orth=d, reorth="cgs2")
+	assert np.allclose(eigvalsh_tridiagonal(a, b), np.linalg.eigvalsh(A)), "Eigenvalues not similar"
+
+	## The cyclic window of Lanczos vectors wraps around; both methods project against the same vectors
+	(a1, b1), Q1 = lanczos(A, v0=v0, deg=30, orth=5, return_basis=True)
+	(a2, b2), Q2 = lanczos(A, v0=v0, deg=30, orth=5, return_basis=True, reorth="cgs2")
+	assert np.allclose(a1, a2) and np.allclose(b1, b2) and np.allclose(Q1, Q2)
+	a3, b3 = lanczos(A, v0=np.c_[v0, v0], deg=30, orth=5, reorth="cgs2")
+	assert np.allclose(a3[1], a1) and np.allclose(b3[1], b1)
+
+
+def test_lanczos_partial():
+	rng = np.random.default_rng(seed=1234)
+	n, deg = 150, 100
+	ew = np.append(np.linspace(0, 1, n - 3), [10.0, 11.0, 12.0])
+	A = symmetric(n, ew=ew, seed=rng)
+	v0 = rng.uniform(size=n, low=-1, high=1)
+	(a, b), Q = lanczos(A, v0=v0, deg=deg, orth=deg, return_basis=True, reorth="partial")
+	assert np.max(np.abs(Q.T @ Q - np.eye(deg))) <= 1e-6, "Lanczos vectors should remain semi-orthogonal"
+	rw = eigvalsh_tridiagonal(a, b)
+	assert np.sum(np.isclose(rw, 12.0)) == 1, "Partial re-orthogonalization should prevent ghost eigenvalues"
+	a_full, b_full = lanczos(A, v0=v0, deg=deg, orth=deg)
+	assert np.allclose(rw[-3:], eigvalsh_tridiagonal(a_full, b_full)[-3:])
+
+	## Batched recurrences estimate the loss of orthogonality of each column independently
+	a2, b2 = lanczos(A, v0=np.c_[v0, v0], deg=deg, orth=deg, reorth="partial")
+	assert np.allclose(a2[0], a) and np.allclose(a2[1], a)
+
+
+def test_native_operator():
+	from scipy.sparse import csc_array, csr_array
+	from primate.lanczos import _native_operator
+
+	rng = np.random.default_rng(seed=1234)
+	A = symmetric(50, seed=rng)
+	A[np.abs(A) < 0.05] = 0.0
+	v = rng.uniform(size=A.shape[1], low=-1, high=1)
+	a, b = lanczos(A, v0=v, deg=20, orth=3)
+
+	## Handles can be re-used across calls
+	for B in [A, np.asfortranarray(A), csc_array(A), csr_array(A).tocoo()]:
+		op = _native_operator(B)
+		assert op.shape == A.shape
+		for _ in range(2):
+			alpha, beta = np.zeros(21), np.zeros(21)
+			Q = np.zeros((A.shape[0], 4), order="F")
+			_lanczos.lanczos(op, v.copy(), 20, 1e-8, 3, alpha, beta, Q)
+			assert np.allclose(alpha[:20], a) and np.allclose(beta[1:20], b)
+
+	## CSR and upper-triangular matrices are copied once into a handle, which their routines accept in place of the matrix
+	from scipy.sparse import triu
+
+	for B, storage, suffix in [(csr_array(A), "full", "_csr"), (triu(csc_array(A)), "upper", "_sym")]:
+		op = _native_operator(B, storage=storage)
+		assert op.shape == A.shape and _native_operator(op, storage=storage) is op
+		for _ in range(2):
+			alpha, beta = np.zeros(21), np.zeros(21)
+			Q = np.zeros((A.shape[0], 4), order="F")
+			getattr(_lanczos, "lanczos" + suffix)(op, v.copy(), 20, 1e-8, 3, alpha, beta, Q)
+			assert np.allclose(alpha[:20], a) and np.allclose(beta[1:20], b)
+
+	## Dense handles view the memory of the array, rather than copying it
+	B = np.asfortranarray(A)
+	op = _native_operator(B)
+	B *= 2.0
+	alpha, beta, Q = np.zeros(21), np.zeros(21), np.zeros((A.shape[0], 4), order="F")
+	_lanczos.lanczos(op, v.copy(), 20, 1e-8, 3, alpha, beta, Q)
+	assert np.allclose(alpha[:20], 2 * a)
+
+
+def test_lanczos_linear_operator():
+	from scipy.sparse.linalg import aslinearoperator
+
+	class MatvecOnly:
+		def __init__(self, A):
+			self.A, self.shape, self.dtype = A, A.shape, A.dtype
+
+		def matvec(self, x):
+			return self.A @ x
+
+		def __matmul__(self, x):
+			return self.matvec(x)
+
+	rng = np.random.default_rng(seed=1234)
+	A = symmetric(50, seed=rng)
+	V = rng.uniform(size=(A.shape[1], 4), low=-1, high=1)
+	a, b = lanczos(A, v0=V, deg=20, orth=3)
+	for L in [aslinearoperator(A), MatvecOnly(A)]:
+		aL, bL = lanczos(L, v0=V, deg=20, orth=3)  # uses matmat, if available
+		assert np.allclose(a, aL) and np.allclose(b, bL)
+		aL, bL = lanczos(L, v0=V[:, 0], deg=20, orth=3)
+		assert np.allclose(a[0], aL) and np.allclose(b[0], bL)
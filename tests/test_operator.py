@@ -84,6 +84,62 @@ def test_spectral_positive_definite():
 	# matrix_function(A, fun=np.exp)
 
 
+def test_matrix_function_native():
+	from scipy.sparse import csc_array, csr_array
+
+	rng = np.random.default_rng(1234)
+	n = 50
+	A = symmetric(n, pd=True)
+	V = rng.uniform(size=(n, 5), low=-1, high=1)
+	ew, ev = np.linalg.eigh(A)
+	for fun in ["log", "sqrt", "exp", "softsign"]:
+		f = param_callable(fun)
+		y_true = ev @ np.diag(f(ew)) @ ev.T @ V
+		for op in [A, csr_array(A), csc_array(A), aslinearoperator(A)]:
+			M = MatrixFunction(op, fun=fun, deg=n, orth=n)
+			assert M.native
+			assert np.allclose(M @ V[:, 0], y_true[:, 0])
+			assert np.allclose(M @ V, y_true)
+			assert np.allclose(M.quad(V), np.diag(V.T @ y_true))
+
+	## Symmetric operators may be given by just their upper triangle
+	from scipy.sparse import triu
+
+	M = MatrixFunction(triu(csc_array(A)), fun="log", deg=n, orth=n, storage="upper")
+	assert np.allclose(M @ V, ev @ np.diag(np.log(ew)) @ ev.T @ V)
+
+	## CSR and upper-triangular matrices are held by a native handle, shared by the engine and every trace call
+	assert type(M._A).__name__ == "SymmetricOperator_float64"
+	M = MatrixFunction(csr_array(A), fun="log", deg=n, orth=n)
+	assert type(M._A).__name__ == "CSROperator_float64"
+	t1, t2 = M._trace_quad(20, seed=1234, num_threads=1), M._trace_quad(20, seed=1234, num_threads=1)
+	assert np.allclose(t1, t2) and np.isclose(np.mean(t1), np.sum(np.log(ew)), rtol=0.2)
+
+	## Block re-orthogonalization
+	M = MatrixFunction(A, fun="log", deg=n, orth=n, reorth="cgs2")
+	assert M._engine.reorth == "cgs2"
+	assert np.allclose(M @ V, ev @ np.diag(np.log(ew)) @ ev.T @ V)
+	assert np.isclose(np.mean(M._trace_quad(50, seed=1234, num_threads=1)), np.sum(np.log(ew)), rtol=0.2)
+
+	## The basis of matvecs can be re-computed in a second pass, or memory-mapped
+	y_true = ev @ np.diag(np.log(ew)) @ ev.T @ V
+	for basis in ["none", "mmap"]:
+		M = MatrixFunction(A, fun="log", deg=n, orth=n, basis=basis)
+		assert np.allclose(M @ V, y_true)
+		assert np.allclose(M.quad(V), np.diag(V.T @ y_true))
+
+	## Callables are evaluated via callbacks, and can be swapped after construction
+	M = MatrixFunction(A, fun="log", deg=n, orth=n)
+	M.fun = np.sqrt
+	assert not M.native
+	assert np.allclose(M @ V[:, 0], ev @ np.diag(np.sqrt(ew)) @ ev.T @ V[:, 0])
+
+	## Single precision
+	M = MatrixFunction(A, fun="log", deg=n, orth=n, dtype=np.float32)
+	y_true = ev @ np.diag(np.log(ew)) @ ev.T @ V[:, 0]
+	assert np.allclose(M @ V[:, 0], y_true, atol=1e-3)
+
+
 def test_normalize():
 	rng = np.random.default_rng(1234)
 	n = 100
@@ -93,3 +149,98 @@ def test_normalize():
 	assert is_linear_op(A_scaled)
 	top_ew = eigsh(A_scaled, k=1, return_eigenvectors=False)
 	assert np.isclose(top_ew, 1.0)
+
+
+def test_toeplitz_native():
+	from scipy.linalg import toeplitz
+	from primate.operators import Toeplitz
+	from primate.trace import hutch, xtrace
+
+	rng = np.random.default_rng(1234)
+	for n in [1, 7, 100, 333]:
+		c, r = rng.normal(size=n), rng.normal(size=n)
+		r[0] = c[0]
+		T, X = Toeplitz(c, r), rng.normal(size=(n, 5))
+		assert np.allclose(T @ X[:, 0], toeplitz(c, r) @ X[:, 0])
+		assert np.allclose(T @ X, toeplitz(c, r) @ X)
+		T = Toeplitz(c, r, dtype=np.float32)
+		assert T.matvec(X[:, 0]).dtype == np.float32
+		assert np.allclose(T @ X, toeplitz(c, r) @ X, atol=1e-4)
+
+	## Symmetric positive-definite Toeplitz operators are supported by the native estimators
+	n = 150
+	c = 0.5 ** np.arange(n)
+	c[0] = 4.0
+	T, ew = Toeplitz(c), np.linalg.eigvalsh(toeplitz(c))
+	assert np.isclose(xtrace(T, seed=1234), np.sum(ew), atol=1e-2)
+	M = MatrixFunction(T, fun="log", deg=20)
+	est = hutch(M, converge="count", count=500, seed=1234, num_threads=2)
+	assert np.isclose(est, np.sum(np.log(ew)), rtol=0.02)
+
+
+def test_composite_native():
+	from scipy.linalg import toeplitz
+	from scipy.sparse import csr_array
+	from primate.operators import Composite, Toeplitz, composite
+	from primate.trace import hutch
+
+	rng = np.random.default_rng(1234)
+	n = 80
+	A = symmetric(n, pd=True, seed=rng)
+	S = csr_array(rng.normal(size=(n, n)) * (rng.uniform(size=(n, n)) < 0.05))
+	c = 0.5 ** np.arange(n)
+	T, X = Toeplitz(c), rng.normal(size=(n, 4))
+
+	## Compositions are evaluated lazily, and agree with their dense counterparts
+	C = (2.0 * composite(A) - S.tocsc() + composite(S) @ T).shift(0.5) / 4.0
+	C_dense = (2.0 * A - S.toarray() + S.toarray() @ toeplitz(c) + 0.5 * np.eye(n)) / 4.0
+	assert isinstance(C, Composite)
+	assert np.allclose(C @ X[:, 0], C_dense @ X[:, 0]) and np.allclose(C @ X, C_dense @ X)
+	G = (composite(A) + S).gram()
+	assert np.allclose(G @ X, (A + S.toarray()).T @ (A + S.toarray()) @ X)
+
+	## Operands need not be symmetric or square, whatever their memory order
+	B = np.ascontiguousarray(rng.normal(size=(n // 2, n)))
+	assert composite(B).shape == B.shape and (composite(B) @ composite(A)).shape == B.shape
+	assert np.allclose(composite(B) @ X[:, 0], B @ X[:, 0]) and np.allclose(composite(B) @ X, B @ X)
+	assert np.allclose(composite(B).gram() @ X, B.T @ (B @ X))
+	assert np.allclose((composite(B) @ T) @ X, B @ (toeplitz(c) @ X))
+
+	## Normalized operators stay native, and so do the matrix functions built from them
+	ew = np.linalg.eigvalsh(A)
+	N = normalize_unit(A)
+	assert isinstance(N, Composite)
+	M = MatrixFunction(N, fun="log", deg=20)
+	est = hutch(M, converge="count", count=500, seed=1234, num_threads=2)
+	alpha = np.max(np.abs(ew))
+	assert np.isclose(est, np.sum(np.log((ew + alpha) / (2 * alpha))), rtol=0.05)
+
+
+def test_chebyshev_function():
+	from primate.operators import ChebyshevFunction
+	from primate.trace import hutch, xtrace
+
+	rng = np.random.default_rng(1234)
+	n = 80
+	ew = rng.uniform(size=n, low=0.5, high=2.0)
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+	U = np.linalg.eigh(A)[1]
+	fA = U @ np.diag(np.exp(ew)) @ U.T
+	X = rng.normal(size=(n, 4))
+
+	## Smooth functions converge geometrically in the degree, on given or estimated bounds
+	C = ChebyshevFunction(A, fun="exp", deg=30, bounds=(0.4, 2.1))
+	assert np.allclose(C @ X[:, 0], fA @ X[:, 0]) and np.allclose(C @ X, fA @ X)
+	assert np.allclose(C.quad(X), np.einsum("ij,ij->j", X, fA @ X))
+	C = ChebyshevFunction(A, fun="exp", deg=30)
+	assert C.bounds[0] <= np.min(ew) and C.bounds[1] >= np.max(ew)
+	assert np.allclose(C @ X, fA @ X)
+
+	## Callables are only evaluated to fit the coefficients, which match those of the named function
+	C_fun = ChebyshevFunction(A, fun=np.exp, deg=30, bounds=C.bounds)
+	assert np.allclose(C_fun.coeffs, C.coeffs)
+
+	## Trace estimates are sampled natively, and xtrace of a full sketch is exact up to the expansion
+	est = hutch(C_fun, converge="count", count=400, seed=1234, num_threads=2, block_size=4)
+	assert np.isclose(est, np.sum(np.exp(ew)), rtol=0.05)
+	assert np.isclose(xtrace(C_fun, seed=1234), np.sum(np.exp(ew)), rtol=1e-6)
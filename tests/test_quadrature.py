@@ -74,3 +74,70 @@ def test_fftr():
 	quad_test = np.sum(fttr_nodes * fttr_weights_run)
 	quad_true = np.sum(fttr_weights_true * ew)
 	assert np.isclose(quad_test, quad_true, atol=1e-10)
+
+
+def test_fttr_native():
+	from primate.operators import MatrixFunction
+
+	rng = np.random.default_rng(1234)
+	n = 100
+	A = symmetric(n, seed=rng, pd=True)
+	V = rng.uniform(size=(n, 10), low=-1, high=1)
+	M_gw = MatrixFunction(A, fun="log", deg=40, orth=10, quad="gw")
+	M_fttr = MatrixFunction(A, fun="log", deg=40, orth=10, quad="fttr")
+	assert np.allclose(M_gw.quad(V), M_fttr.quad(V))
+
+	## The native trace engine uses the same weight method as the operator
+	s_gw = M_gw._trace_quad(50, seed=1234, num_threads=1)
+	s_fttr = M_fttr._trace_quad(50, seed=1234, num_threads=1)
+	assert np.allclose(s_gw, s_fttr)
+
+
+def test_spectral_density():
+	from primate.integrate import spectral_density
+	from primate.operators import MatrixFunction
+
+	rng = np.random.default_rng(1234)
+	n = 80
+	ew = rng.uniform(size=n, low=0.0, high=4.0)
+	A = symmetric(n, ew=ew, seed=rng)
+	grid = np.linspace(-1.0, 5.0, 500)
+	h = 0.1
+
+	## The binned density matches smoothing the quadrature rules of the same probes
+	M = MatrixFunction(A, deg=20, orth=5)
+	nodes, weights = M._trace_rules(50, seed=1234, num_threads=2)
+	K = np.exp(-0.5 * ((grid[:, None] - nodes.ravel()) / h) ** 2) / (h * np.sqrt(2 * np.pi))
+	psi_ref = K @ weights.ravel() / (n * 50)
+	psi = spectral_density(M, grid, nv=50, bandwidth=h, seed=1234, num_threads=2)
+	assert psi.shape == grid.shape and np.allclose(psi, psi_ref)
+	assert np.isclose(np.sum(psi) * (grid[1] - grid[0]), 1.0, atol=1e-3)
+
+	## Either kernel approximates the smoothed density of the eigenvalues
+	for kernel in ["gaussian", "lorentzian"]:
+		psi = spectral_density(A, grid, nv=200, kernel=kernel, bandwidth=0.1, seed=1234, deg=40, orth=10)
+		cdf, cdf_true = np.cumsum(psi) * (grid[1] - grid[0]), np.searchsorted(np.sort(ew), grid) / n
+		assert np.max(np.abs(cdf - cdf_true)) < 0.15
+
+
+def test_quadrature_batch():
+	rng = np.random.default_rng(seed=1234)
+	A = symmetric(50, seed=rng, pd=True)
+	V = rng.uniform(size=(A.shape[1], 37), low=-1, high=1)
+	a, b = lanczos(A, deg=20, v0=V)
+	assert a.shape == (37, 20) and b.shape == (37, 19)
+
+	## The native batched solver reproduces the rules of each matrix
+	nodes, weights = quadrature(a, b, quad="gw", num_threads=2)
+	assert nodes.shape == (37, 20) and weights.shape == (37, 20)
+	for i in range(37):
+		theta, tau = quadrature(a[i], b[i], quad="gw")
+		assert np.allclose(nodes[i], theta) and np.allclose(weights[i], tau, atol=1e-12)
+	assert np.allclose(weights.sum(axis=1), 1.0)
+	assert np.all(np.diff(nodes, axis=1) >= 0)
+
+	## Independent of the number of threads, and of truncation to a lower degree
+	nodes1, weights1 = quadrature(a, b, quad="gw", num_threads=1)
+	assert np.allclose(nodes, nodes1) and np.allclose(weights, weights1)
+	nodes10, _ = quadrature(a, b, deg=10, quad="gw")
+	assert nodes10.shape == (37, 10) and np.allclose(nodes10[3], quadrature(a[3], b[3], deg=10, quad="gw")[0])
@@ -73,6 +73,39 @@ def test_Isotropic():
 	# Iso.values
 
 
+def test_probes():
+	from primate.random import probes
+
+	for pdf in ["rademacher", "sphere", "normal"]:
+		S = np.empty((5, 1500), order="F")
+		probes(S, pdf=pdf, seed=1234, num_threads=1)
+		ES = S @ S.T / S.shape[1]
+		assert np.max(np.abs(ES - np.eye(S.shape[0]))) <= 0.15
+		if pdf == "rademacher":
+			assert list(np.unique(S.ravel())) == [-1, +1]
+		elif pdf == "sphere":
+			assert np.allclose(np.linalg.norm(S, axis=0), np.sqrt(S.shape[0]))
+		elif pdf == "normal":
+			assert normaltest(S.ravel()).pvalue >= 0.05
+
+		## Probes depend only on the seed and their index, not on the thread count or the batching
+		S4, SB = np.empty_like(S, order="F"), np.empty_like(S, order="F")
+		probes(S4, pdf=pdf, seed=1234, num_threads=4)
+		for i in range(0, S.shape[1], 7):
+			probes(SB[:, i : i + 7], pdf=pdf, seed=1234, offset=i)
+		assert np.all(S == S4) and np.all(S == SB)
+
+		## Single precision probes match the double precision ones up to rounding
+		S32 = np.empty(S.shape, dtype=np.float32, order="F")
+		probes(S32, pdf=pdf, seed=1234)
+		assert np.allclose(S32, S, atol=1e-6)
+
+	v1, v2 = np.empty(150), np.empty(150)
+	probes(v1, seed=1234)
+	probes(v2, seed=1235)
+	assert not np.allclose(v1, v2)
+
+
 def test_haar():
 	rng = np.random.default_rng(1234)
 	A = haar(25, ew=np.ones(25), seed=rng)
@@ -87,3 +87,361 @@ def test_xtrace2():
 	estimates = []
 	xtrace(A, batch=1, full=True, seed=rng, callback=lambda res: estimates.append(res.estimate))
 	assert np.std(estimates) < 0.60
+
+
+def test_hutch_native():
+	rng = np.random.default_rng(1234)
+	n = 50
+	ew = rng.uniform(size=n, low=1 / n, high=1.0)
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+	M = MatrixFunction(A, fun="log", deg=20, orth=5)
+	assert M.native
+
+	## Reproducible for a fixed seed, regardless of the thread count
+	s1 = M._trace_quad(500, seed=1234, num_threads=1)
+	s2 = M._trace_quad(500, seed=1234, num_threads=1)
+	s3 = M._trace_quad(500, seed=1234, num_threads=3)
+	assert np.allclose(s1, s2) and np.allclose(s1, s3)
+
+	## The native path should agree with the exact trace up to Monte-Carlo error
+	tr_true = np.sum(np.log(ew))
+	assert np.abs(np.mean(s1) - tr_true) <= 4 * np.std(s1) / np.sqrt(len(s1))
+	for pdf in ["rademacher", "normal", "sphere"]:
+		est = hutch(M, pdf=pdf, converge="count", count=1000, seed=rng)
+		assert np.abs(est - tr_true) <= 0.05 * np.abs(tr_true)
+
+	## Callables are not native, and assigning one disables the native path
+	M.fun = np.log
+	assert not M.native
+
+
+def test_hutch_native_block():
+	from scipy.sparse import csr_array
+	from scipy.sparse.linalg import aslinearoperator
+
+	rng = np.random.default_rng(1234)
+	n = 50
+	ew = rng.uniform(size=n, low=1 / n, high=1.0)
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+	for B in [A, csr_array(A), aslinearoperator(A)]:
+		M = MatrixFunction(B, fun="log", deg=20, orth=5)
+		s1 = M._trace_quad(103, seed=1234, num_threads=1, block_size=1)
+		s8 = M._trace_quad(103, seed=1234, num_threads=1, block_size=8)
+		assert np.allclose(s1, s8)
+
+
+def test_hutch_native_early_stop():
+	## Operators with few distinct eigenvalues exhaust their Krylov spaces before deg steps
+	n = 30
+	for ew in [np.full(n, 2.0), np.tile([1.0, 2.0, 3.0], n // 3)]:
+		A = np.diag(ew)
+		tr_true = np.sum(1.0 / ew)
+		for quad in ["gw", "fttr"]:
+			M = MatrixFunction(A, fun="inv", deg=10, quad=quad)
+			for block_size in [1, 4]:
+				s = M._trace_quad(8, pdf="rademacher", seed=1234, num_threads=1, block_size=block_size)
+				assert np.allclose(s, tr_true)
+			v = np.sign(np.random.default_rng(1234).normal(size=n))
+			assert np.isclose(M.quad(v), tr_true)
+			assert np.allclose(M @ v, v / ew)
+			est, degrees = M.adapt(step=2)._trace_adaptive(8, pdf="rademacher", seed=1234, num_threads=1)
+			assert np.allclose(est, tr_true) and np.all(degrees <= 3)
+			M.adapt(0)
+			assert np.isclose(hutch(M, pdf="rademacher", converge="count", count=8, batch=4, seed=1234), tr_true)
+
+
+def test_hutch_native_mixed():
+	rng = np.random.default_rng(1234)
+	n = 50
+	ew = rng.uniform(size=n, low=1 / n, high=1.0)
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+	M64 = MatrixFunction(A, fun="log", deg=20, orth=5)
+	M32 = MatrixFunction(A, fun="log", deg=20, orth=5, dtype=np.float32, mixed=True)
+	s64 = M64._trace_quad(100, seed=1234, num_threads=1)
+	s32 = M32._trace_quad(100, seed=1234, num_threads=1)
+	assert s32.dtype == np.float64 and np.allclose(s64, s32, rtol=1e-3)
+	assert M32._trace_quad(10, seed=1234, num_threads=1, mixed=False).dtype == np.float32
+	est = hutch(M32, seed=1234, num_threads=1, mixed=True)
+	assert np.isclose(est, np.sum(np.log(ew)), rtol=0.1)
+
+
+def test_hutch_native_arena():
+	from primate.lanczos import _lanczos
+	rng = np.random.default_rng(1234)
+	n = 50
+	A = symmetric(n, pd=True, seed=rng)
+	M = MatrixFunction(A, fun="log", deg=20, orth=5, dtype=np.float32)
+
+	## The per-thread workspace is created on the first call, grown to the thread count, and re-used thereafter
+	s1 = M._trace_quad(40, seed=1234, num_threads=1, block_size=4)
+	arena = M._arena(np.float32)
+	assert isinstance(arena, _lanczos.LanczosArena_float32) and len(arena) == 1
+	s2 = M._trace_quad(40, seed=1234, num_threads=1, block_size=4)
+	assert arena is M._arena(np.float32) and np.allclose(s1, s2)
+	M._trace_quad(40, seed=1234, num_threads=2)
+	assert len(arena) == 2
+
+	## Mixed precision estimates use their own workspaces
+	M._trace_quad(10, seed=1234, num_threads=1, mixed=True)
+	assert isinstance(M._arena(np.float64), _lanczos.LanczosArena_float32_float64)
+
+
+def test_hutch_native_converge():
+	from primate.estimators import ConfidenceCriterion, CountCriterion, KneeCriterion, ToleranceCriterion
+	from primate.lanczos import _lanczos
+
+	rng = np.random.default_rng(1234)
+	n = 50
+	ew = rng.uniform(size=n, low=1 / n, high=1.0)
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+	M = MatrixFunction(A, fun="log", deg=20, orth=5)
+
+	## Count, tolerance, and confidence criteria (and their disjunctions) have native equivalents
+	cc = CountCriterion(count=2000) | ConfidenceCriterion(confidence=0.95, atol=1.5, rtol=0.0)
+	assert len(cc._native_params()) == 2 and ToleranceCriterion()._native_params() is not None
+	assert KneeCriterion()._native_params() is None and (cc & cc)._native_params() is None
+
+	## The engine stops as soon as the confidence interval is tight, in multiples of the check interval
+	est, info = hutch(M, converge=cc, batch=16, seed=1234, full=True, num_threads=2)
+	assert info.criterion(info.estimator) and len(info.estimator) < 2000 and len(info.estimator) % 16 == 0
+	assert np.abs(est - np.sum(np.log(ew))) <= 2 * 1.5
+
+	## The merged samples, and thus the estimate, do not depend on the number of threads
+	assert np.isclose(hutch(M, converge=cc, batch=16, seed=1234, num_threads=1), est)
+	assert np.isclose(hutch(M, converge=cc, batch=16, seed=1234, num_threads=3, block_size=4), est)
+
+	## The native estimator carries its state across calls
+	params, native_est = cc._native_params(), _lanczos.MeanEstimator()
+	s1 = M._trace_converge(2000, params, native_est, check_every=16, seed=1234)
+	assert len(native_est) == len(s1) and np.isclose(native_est.mean, np.mean(s1))
+	assert np.isclose(native_est.variance, np.var(s1, ddof=1))
+	assert len(M._trace_converge(2000, params, native_est, check_every=16, seed=1235)) == 0
+
+
+def test_hutchpp_native():
+	from primate.trace import _native_estimator
+	rng = np.random.default_rng(1234)
+	n = 60
+	ew = np.r_[rng.uniform(size=10, low=10, high=100), rng.uniform(size=n - 10, low=0.01, high=0.1)]
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+	assert _native_estimator(A, "hutchpp", A.dtype) is not None
+
+	## Low-rank-plus-noise spectra are captured almost entirely by the sketch
+	est, info = hutchpp(A, m=30, seed=1234, full=True, num_threads=2)
+	assert np.isclose(est, np.sum(ew), rtol=0.01)
+	assert len(info.samples) == 60 and np.sum(info.samples[:30]) <= np.sum(ew)
+	assert np.isclose(hutchpp(A, m=30, seed=1234, num_threads=1), est)
+
+	## Matrix functions sketch with f(A)v and evaluate the deflated residual with the native quadrature engine
+	M = MatrixFunction(A, fun="log", deg=30, orth=5)
+	est = hutchpp(M, m=30, seed=1234, num_threads=2)
+	assert np.isclose(est, np.sum(np.log(ew)), rtol=0.05)
+	assert np.isclose(hutchpp(M, m=30, seed=1234, num_threads=1), est)
+
+
+def test_xtrace_native():
+	from primate.trace import _native_estimator
+	rng = np.random.default_rng(1234)
+	n = 60
+	ew = np.r_[rng.uniform(size=5, low=10, high=100), np.zeros(n - 5)]
+	A = symmetric(n, ew=ew, seed=rng)
+	assert _native_estimator(A, "xtrace", A.dtype) is not None
+
+	## The leave-one-out estimates are exact once the sketch captures the range of A
+	for pdf in ["rademacher", "normal", "sphere"]:
+		est, info = xtrace(A, batch=10, pdf=pdf, seed=1234, full=True, converge="count", count=10)
+		assert np.isclose(est, np.sum(ew)) and info.estimator.n_samples >= 10
+
+	## Matrix functions sketch in parallel over f(A)v, independent of the number of threads
+	M = MatrixFunction(A + np.eye(n), fun="log", deg=30, orth=5)
+	est1 = xtrace(M, batch=20, seed=1234, converge="count", count=20, num_threads=1)
+	est2 = xtrace(M, batch=20, seed=1234, converge="count", count=20, num_threads=3)
+	assert np.isclose(est1, est2) and np.isclose(est1, np.sum(np.log(ew + 1)), rtol=0.05)
+
+
+def test_trace_path():
+	from scipy.sparse import csc_array, identity
+	from primate.trace import trace_path
+
+	rng = np.random.default_rng(1234)
+	n = 60
+	ew = rng.uniform(size=n, low=0.1, high=1.0)
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+	ts = np.geomspace(1e-2, 1e2, 25)
+
+	## Shifting the nodes is exactly the Lanczos method on each of the shifted matrices
+	est, info = trace_path(A, ts, fun="log", nv=200, seed=1234, deg=20, orth=20, full=True, num_threads=2)
+	est_affine = trace_path(A, ts, fun="log", B=identity(n), nv=200, seed=1234, deg=20, orth=20, num_threads=2)
+	assert est.shape == ts.shape and info.info["samples"].shape == (200, len(ts))
+	assert np.allclose(est, est_affine)
+
+	## Both agree with the exact log-determinants up to Monte-Carlo error
+	logdets = np.array([np.sum(np.log(ew + t)) for t in ts])
+	assert np.all(np.abs(est - logdets) <= 4 * info.info["stderr"] + 1e-6)
+
+	## General paths re-use the probes across t
+	C = csc_array(symmetric(n, pd=True, seed=rng))
+	est = trace_path(csc_array(A), ts[:5], fun="log", B=C, nv=200, seed=1234, deg=20, orth=20)
+	logdets = np.array([np.linalg.slogdet(A + t * C.toarray())[1] for t in ts[:5]])
+	assert np.allclose(est, logdets, rtol=0.05)
+
+
+def test_spectral_sums():
+	from primate.trace import spectral_sums
+
+	rng = np.random.default_rng(1234)
+	n = 60
+	ew = rng.uniform(size=n, low=0.5, high=2.0)
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+	exact = np.array([np.sum(np.log(ew)), np.sum(1.0 / ew), np.sum(np.exp(-ew))])
+
+	## Several named functions share the quadrature rules of each probe
+	funs = ["log", "inv", ("exp", {"t": -1.0})]
+	est, info = spectral_sums(A, funs, nv=200, seed=1234, deg=20, orth=20, full=True, num_threads=2)
+	assert est.shape == (3,) and info.info["samples"].shape == (200, 3)
+	assert info.info["covariance"].shape == (3, 3)
+	assert np.all(np.abs(est - exact) <= 4 * np.sqrt(np.diag(info.info["covariance"])) + 1e-6)
+
+	## Each estimate matches the single-function estimator with the same probes
+	M = MatrixFunction(A, fun="log", deg=20, orth=20)
+	assert np.isclose(est[0], np.mean(M._trace_quad(200, seed=1234, num_threads=2)))
+
+	## Callables are evaluated on the same quadrature rules
+	est_fun = spectral_sums(A, [np.log, "inv", lambda x: np.exp(-x)], nv=200, seed=1234, deg=20, orth=20, num_threads=2)
+	assert np.allclose(est, est_fun)
+
+
+def test_hutch_deflated():
+	rng = np.random.default_rng(1234)
+	n = 150
+	ew = np.concatenate([1e3 * np.arange(1, 6), rng.uniform(size=n - 5, low=0.5, high=1.5)])
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+	U = np.linalg.eigh(A)[1]
+	logdet = np.sum(np.log(ew))
+
+	## Deflating the outliers reduces the variance of the samples, and the exact part is computed once per call
+	M = MatrixFunction(A, fun="log", deg=15, orth=5)
+	samples = M._trace_quad(400, seed=1234, num_threads=2)
+	M.deflate(5, seed=1234)
+	assert M._deflation.shape == (n, 5)
+	samples_defl = M._trace_quad(400, seed=1234, num_threads=2)
+	assert np.std(samples_defl) < 0.5 * np.std(samples)
+	assert abs(np.mean(samples_defl) - logdet) < 4 * np.std(samples_defl) / np.sqrt(400)
+
+	## The cached basis is used by hutch, and can be supplied explicitly or removed
+	est = hutch(M, converge="count", count=400, seed=1234, num_threads=2)
+	assert abs(est - logdet) < 1.0
+	M.deflate(Q=U[:, -5:])
+	assert np.isclose(np.mean(M._trace_quad(400, seed=1234)), logdet, atol=1.0)
+	M.deflate()
+	assert M._deflation is None and np.allclose(M._trace_quad(400, seed=1234, num_threads=2), samples)
+
+
+def test_hutch_adaptive():
+	rng = np.random.default_rng(1234)
+	n = 200
+	ew = rng.uniform(size=n, low=1.0, high=2.0)
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+	M = MatrixFunction(A, fun="log", deg=60, orth=5)
+	fixed = M._trace_quad(100, seed=1234, num_threads=2)
+
+	## Resuming the recurrence up to the full degree reproduces the fixed-degree samples
+	est, degrees = M.adapt(step=7, rtol=0.0)._trace_adaptive(100, seed=1234, num_threads=2)
+	assert np.all(degrees == 60) and np.allclose(est, fixed)
+
+	## Well-conditioned spectra converge at a fraction of the maximum degree
+	est, degrees = M.adapt(step=5, rtol=1e-8)._trace_adaptive(100, seed=1234, num_threads=2)
+	assert np.mean(degrees) < 40 and np.allclose(est, fixed, rtol=1e-6)
+	assert np.isclose(hutch(M, converge="count", count=100, seed=1234), np.mean(M._trace_quad(100, seed=1234)))
+	assert np.allclose(M.adapt(0)._trace_quad(100, seed=1234), fixed)
+
+
+def test_hutch_mpi():
+	import threading
+	from primate.estimators import CountCriterion
+	from primate.trace import hutch_mpi
+
+	class ThreadComm:
+		"""Emulates the collectives of an mpi4py communicator, one thread per rank."""
+
+		def __init__(self, rank: int, size: int, shared: dict, barrier: threading.Barrier):
+			self.rank, self.size, self.shared, self.barrier = rank, size, shared, barrier
+
+		def Get_rank(self):
+			return self.rank
+
+		def Get_size(self):
+			return self.size
+
+		def bcast(self, obj, root: int = 0):
+			return self.allgather(obj)[root]
+
+		def allgather(self, obj):
+			self.shared[self.rank] = obj
+			self.barrier.wait()
+			out = [self.shared[r] for r in range(self.size)]
+			self.barrier.wait()
+			return out
+
+	rng = np.random.default_rng(1234)
+	n = 50
+	ew = rng.uniform(size=n, low=1 / n, high=1.0)
+	A = symmetric(n, pd=True, ew=ew, seed=rng)
+
+	def run(size: int, adapt: int = 0, **kwargs) -> list:
+		shared, barrier, results = {}, threading.Barrier(size), [None] * size
+
+		def rank_main(r: int):
+			M = MatrixFunction(A, fun="log", deg=20, orth=5).adapt(step=adapt, rtol=0.0)
+			results[r] = hutch_mpi(M, ThreadComm(r, size, shared, barrier), full=True, num_threads=1, **kwargs)
+
+		threads = [threading.Thread(target=rank_main, args=(r,)) for r in range(size)]
+		for t in threads:
+			t.start()
+		for t in threads:
+			t.join()
+		return results
+
+	## The ranks divide the probes of a single stream, and all stop at the same round with the same estimate
+	results = run(3, batch=16, converge=CountCriterion(count=96), seed=1234)
+	assert all(np.isclose(est, results[0][0]) for est, _ in results)
+	assert all(info.info == dict(ranks=3, rounds=2) and len(info.estimator) == 96 for _, info in results)
+	key = int(np.random.default_rng(1234).integers(2**31))
+	samples = MatrixFunction(A, fun="log", deg=20, orth=5)._trace_quad(96, seed=key)
+	assert np.isclose(results[0][0], np.mean(samples))
+	assert np.isclose(results[0][1].estimator._cov(), np.var(samples, ddof=1))
+
+	## The merged estimate does not depend on the number of ranks
+	single = run(1, batch=48, converge=CountCriterion(count=96), seed=1234)
+	assert np.isclose(single[0][0], results[0][0])
+	est, _ = run(2, batch=8, converge="confidence", atol=2.0, seed=1234)[1]
+	assert np.abs(est - np.sum(np.log(ew))) <= 2 * 2.0
+
+	## Adapted operators evaluate the same probes on every rank
+	adapted = run(3, adapt=7, batch=16, converge=CountCriterion(count=96), seed=1234)
+	assert all(np.isclose(est, results[0][0]) for est, _ in adapted)
+
+
+def test_phase_stats():
+	from primate.lanczos import _lanczos, _phase_stats
+
+	rng = np.random.default_rng(1234)
+	n = 50
+	A = symmetric(n, pd=True, ew=rng.uniform(size=n, low=1 / n, high=1.0), seed=rng)
+	M = MatrixFunction(A, fun="log", deg=20, orth=5)
+	est, info = hutch(M, converge="count", count=64, batch=16, seed=1234, full=True, num_threads=2)
+	if not _lanczos.instrumented:
+		assert info.stats == {} and _phase_stats() == {}
+		return
+
+	## Each probe is sampled once, takes deg matvecs, and yields one eigensolve and quadrature rule
+	stats = info.stats
+	assert stats["rng"]["count"] == 64 and stats["eigen"]["count"] == 64 and stats["quad"]["count"] == 64
+	assert stats["matvec"]["count"] == 64 * 20 and stats["reorth"]["count"] > 0
+	assert all(stats[p]["time"] >= 0.0 for p in ("matvec", "reorth", "eigen", "quad", "rng"))
+	assert stats["threads"] >= 1
+
+	## Snapshots taken across calls only count the phases of the calls in between
+	before = _phase_stats()
+	M._trace_quad(10, seed=1234, num_threads=1)
+	assert _phase_stats(before)["matvec"]["count"] == 10 * 20